@@ -32,7 +32,7 @@
  * compatible, thus CINDEX_VERSION_MAJOR is expected to remain stable.
  */
 #define CINDEX_VERSION_MAJOR 0
-#define CINDEX_VERSION_MINOR 35
+#define CINDEX_VERSION_MINOR 37
 
 #define CINDEX_VERSION_ENCODE(major, minor) ( \
       ((major) * 10000)                       \
@@ -1228,7 +1228,31 @@ enum CXTranslationUnit_Flags {
    * purposes of an IDE, this is undesirable behavior and as much information
    * as possible should be reported. Use this flag to enable this behavior.
    */
-  CXTranslationUnit_KeepGoing = 0x200
+  CXTranslationUnit_KeepGoing = 0x200,
+
+  /**
+   * \brief Used to indicate that the precompiled preamble should be split
+   * into a chain of precompiled headers.
+   *
+   * The first link of the chain covers the system headers included at the
+   * start of the preamble, and each of the other headers it includes gets its
+   * own link. When an edit changes the preamble, only the links from the one
+   * containing the edit onward are rebuilt, rather than the whole preamble.
+   * This flag only has an effect together with
+   * \c CXTranslationUnit_PrecompiledPreamble.
+   */
+  CXTranslationUnit_ChainedPreamble = 0x400,
+
+  /**
+   * \brief Used to indicate that the precompiled preamble should be kept in
+   * memory rather than in temporary files.
+   *
+   * This avoids writing the preamble out and reading it back on machines
+   * with slow disks, at the cost of holding it in memory for as long as the
+   * translation unit lives. This flag only has an effect together with
+   * \c CXTranslationUnit_PrecompiledPreamble.
+   */
+  CXTranslationUnit_PreambleInMemory = 0x800
 };
 
 /**
@@ -0,0 +1,79 @@
+//===--- clang/Basic/CharScan.h - Scanning Runs of Characters ---*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Vectorized scans over source buffers, used by the lexer and the
+/// source manager to skip long runs of uninteresting characters.
+///
+/// Each scan has a portable implementation and, on x86, SSE2 and AVX2
+/// implementations. The widest implementation that both the build and the
+/// host CPU support is chosen the first time a scan is used.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_BASIC_CHARSCAN_H
+#define LLVM_CLANG_BASIC_CHARSCAN_H
+
+#include "clang/Basic/LLVM.h"
+
+namespace clang {
+namespace charscan {
+
+/// \brief The instruction set used by a set of scan kernels.
+enum class ScanLevel {
+  Scalar,
+  SSE2,
+  AVX2
+};
+
+/// \brief A set of scan kernels. Each kernel looks at the characters in
+/// [Ptr, End) and returns a pointer to the first one it stops at, or End if
+/// there is none. The kernels never read at or beyond End.
+struct ScanKernels {
+  /// Find the first '\\n' or '\\r'.
+  const char *(*FindNewline)(const char *Ptr, const char *End);
+  /// Find the first occurrence of C.
+  const char *(*FindChar)(const char *Ptr, const char *End, char C);
+  /// Find the first character that is not [a-zA-Z0-9_].
+  const char *(*SkipIdentifierBody)(const char *Ptr, const char *End);
+  /// Find the first character that is not ' ', '\\t', '\\f' or '\\v'.
+  const char *(*SkipHorizontalWhitespace)(const char *Ptr, const char *End);
+};
+
+/// \brief The widest scan level supported by both this build and the host.
+ScanLevel getHostScanLevel();
+
+/// \brief The kernels for level \p L, which must not be wider than
+/// getHostScanLevel(). Mostly useful for testing.
+const ScanKernels &getScanKernels(ScanLevel L);
+
+/// \brief The kernels for getHostScanLevel().
+const ScanKernels &getHostScanKernels();
+
+inline const char *findNewline(const char *Ptr, const char *End) {
+  return getHostScanKernels().FindNewline(Ptr, End);
+}
+
+inline const char *findChar(const char *Ptr, const char *End, char C) {
+  return getHostScanKernels().FindChar(Ptr, End, C);
+}
+
+inline const char *skipIdentifierBody(const char *Ptr, const char *End) {
+  return getHostScanKernels().SkipIdentifierBody(Ptr, End);
+}
+
+inline const char *skipHorizontalWhitespace(const char *Ptr,
+                                            const char *End) {
+  return getHostScanKernels().SkipHorizontalWhitespace(Ptr, End);
+}
+
+} // end namespace charscan
+} // end namespace clang
+
+#endif
@@ -219,6 +219,11 @@ public:
   const FileEntry *getFile(StringRef Filename, bool OpenFile = false,
                            bool CacheFailure = true);
 
+  /// \brief Returns the entry for \p Filename if it was already found by
+  /// getFile() or added by getVirtualFile(), without going to the file
+  /// system.
+  const FileEntry *getCachedFile(StringRef Filename) const;
+
   /// \brief Returns the current file system options
   FileSystemOptions &getFileSystemOpts() { return FileSystemOpts; }
   const FileSystemOptions &getFileSystemOpts() const { return FileSystemOpts; }
@@ -236,11 +241,17 @@ public:
 
   /// \brief Open the specified file as a MemoryBuffer, returning a new
   /// MemoryBuffer if successful, otherwise returning null.
+  ///
+  /// Files that are not volatile are memory mapped when they are large
+  /// enough. Callers that do not need the buffer to be null terminated
+  /// should say so, since a file whose size is a multiple of the page size
+  /// has to be read into memory to terminate it.
   llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>
   getBufferForFile(const FileEntry *Entry, bool isVolatile = false,
-                   bool ShouldCloseOpenFile = true);
+                   bool ShouldCloseOpenFile = true,
+                   bool RequiresNullTerminator = true);
   llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>
-  getBufferForFile(StringRef Filename);
+  getBufferForFile(StringRef Filename, bool RequiresNullTerminator = true);
 
   /// \brief Get the 'stat' information for the given \p Path.
   ///
@@ -25,6 +25,10 @@ public:
   /// \brief If set, paths are resolved as if the working directory was
   /// set to the value of WorkingDir.
   std::string WorkingDir;
+
+  /// \brief If set, the file in which failed file lookups are remembered
+  /// across compilations. See PersistentStatCache.
+  std::string StatCachePath;
 };
 
 } // end namespace clang
@@ -0,0 +1,128 @@
+//===--- OnDiskCacheFile.h - Files shared between compilations --*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines helpers for the cache files that are shared by many
+/// compiler invocations.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_BASIC_ONDISKCACHEFILE_H
+#define LLVM_CLANG_BASIC_ONDISKCACHEFILE_H
+
+#include "clang/Basic/LLVM.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/OnDiskHashTable.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+
+namespace clang {
+
+/// \brief Replace the contents of \p Path with \p Contents.
+///
+/// The contents are written to a temporary file next to \p Path, which is
+/// then renamed into place, so that other processes see either the old file
+/// or the new one, but never a partial file.
+///
+/// \returns true if an error occurred.
+bool writeFileAtomically(StringRef Path, StringRef Contents);
+
+namespace detail {
+/// \brief The size of the header of an on-disk cache table file.
+const unsigned OnDiskCacheHeaderSize = 12;
+
+/// \brief Returns the offset of the hash table in \p Buffer, or 0 if it is
+/// not an on-disk cache table file with the given magic and version.
+uint32_t getOnDiskCacheTableOffset(const llvm::MemoryBuffer &Buffer,
+                                   StringRef Magic, uint32_t Version);
+} // end namespace detail
+
+/// \brief An on-disk hash table kept in a cache file.
+///
+/// The file is a small header followed by the hash table:
+///
+///   char[4]           magic
+///   uint32            version
+///   uint32            offset of the hash table's buckets
+///   ...               the entries of the hash table, then its buckets
+///
+/// All integers are little endian. The file is memory mapped for as long as
+/// the table is alive.
+template <typename Info>
+class OnDiskCacheTable : public llvm::OnDiskIterableChainedHashTable<Info> {
+  typedef llvm::OnDiskIterableChainedHashTable<Info> Base;
+
+  std::unique_ptr<llvm::MemoryBuffer> Buffer;
+
+  static const unsigned char *getBase(const llvm::MemoryBuffer &Buffer) {
+    return reinterpret_cast<const unsigned char *>(Buffer.getBufferStart());
+  }
+
+  static uint32_t readWord(const llvm::MemoryBuffer &Buffer, uint32_t Offset) {
+    return llvm::support::endian::read32le(getBase(Buffer) + Offset);
+  }
+
+  OnDiskCacheTable(std::unique_ptr<llvm::MemoryBuffer> Buffer,
+                   uint32_t TableOffset)
+      : Base(readWord(*Buffer, TableOffset), readWord(*Buffer, TableOffset + 4),
+             getBase(*Buffer) + TableOffset + 8,
+             getBase(*Buffer) + detail::OnDiskCacheHeaderSize,
+             getBase(*Buffer)),
+        Buffer(std::move(Buffer)) {}
+
+public:
+  /// \brief Read the cache file at \p Path.
+  ///
+  /// \returns the table, or null if the file is missing or is not a cache
+  /// file with the given magic and version.
+  static std::unique_ptr<OnDiskCacheTable> load(StringRef Path,
+                                                StringRef Magic,
+                                                uint32_t Version) {
+    auto BufferOrErr = llvm::MemoryBuffer::getFile(
+        Path, /*FileSize=*/-1, /*RequiresNullTerminator=*/false);
+    if (!BufferOrErr)
+      return nullptr;
+    uint32_t TableOffset =
+        detail::getOnDiskCacheTableOffset(**BufferOrErr, Magic, Version);
+    if (!TableOffset)
+      return nullptr;
+    return std::unique_ptr<OnDiskCacheTable>(
+        new OnDiskCacheTable(std::move(*BufferOrErr), TableOffset));
+  }
+
+  /// \brief Write the table built by \p Generator to the cache file at
+  /// \p Path, replacing it atomically.
+  ///
+  /// \returns true if an error occurred.
+  static bool save(StringRef Path, StringRef Magic, uint32_t Version,
+                   llvm::OnDiskChainedHashTableGenerator<Info> &Generator,
+                   Info &InfoObj) {
+    using namespace llvm::support;
+    assert(Magic.size() == 4 && "magic must be 4 bytes");
+
+    SmallString<4096> Contents;
+    {
+      llvm::raw_svector_ostream Out(Contents);
+      Out << Magic;
+      endian::Writer<little> LE(Out);
+      LE.write<uint32_t>(Version);
+      LE.write<uint32_t>(0); // Table offset, filled in below.
+      uint32_t TableOffset = Generator.Emit(Out, InfoObj);
+      endian::write32le(&Contents[8], TableOffset);
+    }
+    return writeFileAtomically(Path, Contents);
+  }
+};
+
+} // end namespace clang
+
+#endif
@@ -0,0 +1,111 @@
+//===--- PersistentStatCache.h - On-disk cache of 'stat' misses -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines the PersistentStatCache class, a stat cache that remembers
+/// failed lookups across compiler invocations.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_BASIC_PERSISTENTSTATCACHE_H
+#define LLVM_CLANG_BASIC_PERSISTENTSTATCACHE_H
+
+#include "clang/Basic/FileSystemStatCache.h"
+#include "clang/Basic/OnDiskCacheFile.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include <memory>
+#include <ctime>
+
+namespace clang {
+
+/// \brief A stat cache, kept in a file that is shared by many compiler
+/// invocations, that remembers which paths do not exist.
+///
+/// Most of the stat calls made while looking up headers are for files that
+/// are not there, in each of the search directories that come before the
+/// one that has the header. This cache records those misses, together with
+/// the modification time of the directory that was searched, so that later
+/// invocations can answer them with one stat of each directory. Adding a
+/// file to a directory changes its modification time, which invalidates all
+/// the misses recorded for that directory.
+///
+/// Lookups that succeed are always forwarded to the next cache in the
+/// chain, since a file can change without its directory changing. So are
+/// lookups of names that the directory does have, such as dangling symbolic
+/// links, since their targets can appear without the directory changing.
+/// Only absolute paths are cached.
+///
+/// This is a cache of misses only. It does not remember where a header was
+/// found; header search still walks its search path, and only the misses in
+/// the directories before the one that has the header are saved.
+///
+/// The cache file is memory mapped and only read while the cache is in use.
+/// New misses are merged with the file's current contents and written back
+/// atomically by save(), so that concurrent invocations never see a partial
+/// file; when they race, some new entries can be lost, but never corrupted.
+class PersistentStatCache : public FileSystemStatCache {
+public:
+  /// \brief Open the cache stored in \p CachePath. A missing or unreadable
+  /// file is treated as an empty cache.
+  explicit PersistentStatCache(StringRef CachePath);
+  ~PersistentStatCache() override;
+
+  LookupResult getStat(const char *Path, FileData &Data, bool isFile,
+                       std::unique_ptr<vfs::File> *F,
+                       vfs::FileSystem &FS) override;
+
+  /// \brief Write the misses seen since the cache was opened back to the
+  /// cache file, if there are any. This is called by the destructor.
+  ///
+  /// \returns true if an error occurred.
+  bool save();
+
+  /// \brief The number of lookups answered from the cache file.
+  unsigned getNumHits() const { return NumHits; }
+
+private:
+  class StatMissTrait;
+  typedef OnDiskCacheTable<StatMissTrait> Table;
+
+  /// \brief Read the cache file at \p Path, returning its table of misses,
+  /// or null if the file is missing or is not a valid cache file.
+  static std::unique_ptr<Table> loadTable(StringRef Path);
+
+  /// \brief Returns the modification time of \p Dir, or 0 if it is not a
+  /// directory whose misses can be cached.
+  time_t getDirectoryModTime(StringRef Dir, vfs::FileSystem &FS);
+
+  /// \brief Returns true if \p Dir has an entry named \p Name, or if it
+  /// cannot be listed.
+  bool mayHaveEntry(StringRef Dir, StringRef Name, vfs::FileSystem &FS);
+
+  std::string CachePath;
+  std::unique_ptr<Table> Misses;
+
+  /// \brief The modification times of the directories looked at so far.
+  llvm::StringMap<time_t> DirModTimes;
+
+  /// \brief The names in each directory that had new misses, or null for
+  /// those that could not be listed.
+  llvm::StringMap<std::unique_ptr<llvm::StringSet<>>> DirEntries;
+
+  /// \brief The misses that are not in the cache file yet, keyed by kind and
+  /// path, with the modification time of their directory.
+  llvm::StringMap<time_t> NewMisses;
+
+  /// \brief Whether a miss in the cache file was found to be out of date.
+  bool HasStaleEntries;
+
+  unsigned NumHits;
+};
+
+} // end namespace clang
+
+#endif
@@ -49,6 +49,7 @@
 #include "llvm/Support/DataTypes.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include <cassert>
+#include <cstring>
 #include <map>
 #include <memory>
 #include <vector>
@@ -78,6 +79,65 @@ namespace SrcMgr {
     C_User, C_System, C_ExternCSystem
   };
 
+  /// \brief The offsets at which the lines of a buffer start.
+  ///
+  /// The table is filled in lazily, scanning the buffer a chunk at a time, so
+  /// that finding the line of an offset only scans the buffer up to that
+  /// offset rather than the whole file. The line offsets of each chunk are
+  /// allocated from the SourceManager's BumpPtrAllocator, and an index of the
+  /// chunks, sorted by offset, is binary searched to find the right one.
+  class LineOffsetCache {
+    struct Chunk {
+      /// \brief The 0-based index of the first line that starts in this
+      /// chunk.
+      unsigned FirstLine;
+      /// \brief The number of lines that start in this chunk.
+      unsigned NumLines;
+      /// \brief The offsets at which those lines start.
+      const unsigned *Offsets;
+    };
+
+    /// \brief The chunks that have at least one line start, in order.
+    std::vector<Chunk> Chunks;
+
+    /// \brief The number of lines found so far.
+    unsigned NumLines;
+
+    /// \brief The offset up to which the buffer has been scanned.
+    unsigned ScannedEnd;
+
+    /// \brief Whether the whole buffer has been scanned.
+    bool Complete;
+
+    /// \brief Scan the next chunk of \p Buffer.
+    void scanChunk(StringRef Buffer, llvm::BumpPtrAllocator &Alloc);
+
+  public:
+    /// \brief The number of bytes of the buffer scanned at a time.
+    enum { ChunkSize = 64 * 1024 };
+
+    LineOffsetCache() : NumLines(0), ScannedEnd(0), Complete(false) {}
+
+    /// \brief Return true if any of the buffer has been scanned.
+    bool isComputed() const { return !Chunks.empty(); }
+
+    /// \brief Return the 1-based number of the line of \p Buffer that
+    /// contains \p Offset, scanning as much of the buffer as needed.
+    unsigned getLineNumber(StringRef Buffer, unsigned Offset,
+                           llvm::BumpPtrAllocator &Alloc);
+
+    /// \brief Find the offset at which the 1-based line \p Line of \p Buffer
+    /// starts, scanning as much of the buffer as needed.
+    ///
+    /// \returns false if the buffer does not have that many lines.
+    bool getLineOffset(StringRef Buffer, unsigned Line, unsigned &Offset,
+                       llvm::BumpPtrAllocator &Alloc);
+
+    /// \brief Like getLineOffset, but only looks at the part of the buffer
+    /// that has already been scanned.
+    bool getScannedLineOffset(unsigned Line, unsigned &Offset) const;
+  };
+
   /// \brief One instance of this struct is kept for every file loaded or used.
   ///
   /// This object owns the MemoryBuffer object.
@@ -111,16 +171,11 @@ namespace SrcMgr {
     /// with the contents of another file.
     const FileEntry *ContentsEntry;
 
-    /// \brief A bump pointer allocated array of offsets for each source line.
+    /// \brief The offsets of the source lines.
     ///
-    /// This is lazily computed.  This is owned by the SourceManager
+    /// This is lazily computed.  The offsets are owned by the SourceManager
     /// BumpPointerAllocator object.
-    unsigned *SourceLineCache;
-
-    /// \brief The number of lines in this ContentCache.
-    ///
-    /// This is only valid if SourceLineCache is non-null.
-    unsigned NumLines;
+    LineOffsetCache SourceLineCache;
 
     /// \brief Indicates whether the buffer itself was provided to override
     /// the actual file contents.
@@ -142,8 +197,7 @@ namespace SrcMgr {
 
     ContentCache(const FileEntry *Ent, const FileEntry *contentEnt)
       : Buffer(nullptr, false), OrigEntry(Ent), ContentsEntry(contentEnt),
-        SourceLineCache(nullptr), NumLines(0), BufferOverridden(false),
-        IsSystemFile(false), IsTransient(false) {}
+        BufferOverridden(false), IsSystemFile(false), IsTransient(false) {}
     
     ~ContentCache();
     
@@ -151,16 +205,14 @@ namespace SrcMgr {
     /// a non-NULL Buffer or SourceLineCache.  Ownership of allocated memory
     /// is not transferred, so this is a logical error.
     ContentCache(const ContentCache &RHS)
-      : Buffer(nullptr, false), SourceLineCache(nullptr),
-        BufferOverridden(false), IsSystemFile(false), IsTransient(false) {
+      : Buffer(nullptr, false), BufferOverridden(false), IsSystemFile(false),
+        IsTransient(false) {
       OrigEntry = RHS.OrigEntry;
       ContentsEntry = RHS.ContentsEntry;
 
       assert(RHS.Buffer.getPointer() == nullptr &&
-             RHS.SourceLineCache == nullptr &&
+             !RHS.SourceLineCache.isComputed() &&
              "Passed ContentCache object cannot own a buffer.");
-
-      NumLines = RHS.NumLines;
     }
 
     /// \brief Returns the memory buffer for the associated content.
@@ -253,7 +305,19 @@ namespace SrcMgr {
     /// \brief Contains the ContentCache* and the bits indicating the
     /// characteristic of the file and whether it has \#line info, all
     /// bitmangled together.
-    uintptr_t Data;
+    ///
+    /// This is kept as bytes rather than as a uintptr_t so that FileInfo, and
+    /// therefore SLocEntry, only needs the alignment of an unsigned. That
+    /// makes each SLocEntry 20 bytes instead of 24 on 64-bit hosts, which
+    /// matters because macro-heavy code creates one for every expansion.
+    char Data[sizeof(uintptr_t)];
+
+    uintptr_t getData() const {
+      uintptr_t D;
+      memcpy(&D, Data, sizeof(D));
+      return D;
+    }
+    void setData(uintptr_t D) { memcpy(Data, &D, sizeof(D)); }
 
     friend class clang::SourceManager;
     friend class clang::ASTWriter;
@@ -265,10 +329,10 @@ namespace SrcMgr {
       FileInfo X;
       X.IncludeLoc = IL.getRawEncoding();
       X.NumCreatedFIDs = 0;
-      X.Data = (uintptr_t)Con;
-      assert((X.Data & 7) == 0 &&"ContentCache pointer insufficiently aligned");
+      uintptr_t D = (uintptr_t)Con;
+      assert((D & 7) == 0 && "ContentCache pointer insufficiently aligned");
       assert((unsigned)FileCharacter < 4 && "invalid file character");
-      X.Data |= (unsigned)FileCharacter;
+      X.setData(D | (unsigned)FileCharacter);
       return X;
     }
 
@@ -276,21 +340,21 @@ namespace SrcMgr {
       return SourceLocation::getFromRawEncoding(IncludeLoc);
     }
     const ContentCache* getContentCache() const {
-      return reinterpret_cast<const ContentCache*>(Data & ~uintptr_t(7));
+      return reinterpret_cast<const ContentCache*>(getData() & ~uintptr_t(7));
     }
 
     /// \brief Return whether this is a system header or not.
     CharacteristicKind getFileCharacteristic() const {
-      return (CharacteristicKind)(Data & 3);
+      return (CharacteristicKind)(getData() & 3);
     }
 
     /// \brief Return true if this FileID has \#line directives in it.
-    bool hasLineDirectives() const { return (Data & 4) != 0; }
+    bool hasLineDirectives() const { return (getData() & 4) != 0; }
 
     /// \brief Set the flag that indicates that this FileID has
     /// line table entries associated with it.
     void setHasLineDirectives() {
-      Data |= 4;
+      setData(getData() | 4);
     }
   };
 
@@ -432,6 +496,10 @@ namespace SrcMgr {
       return E;
     }
   };
+
+  static_assert(llvm::AlignOf<SLocEntry>::Alignment ==
+                    llvm::AlignOf<unsigned>::Alignment,
+                "SLocEntry should not need more than 4-byte alignment");
 }  // end SrcMgr namespace.
 
 /// \brief External source of source location entries.
@@ -625,6 +693,10 @@ class SourceManager : public RefCountedBase<SourceManager> {
   /// starts at 2^31.
   static const unsigned MaxLoadedOffset = 1U << 31U;
 
+  /// \brief Whether running out of the source location address space has
+  /// been reported.
+  bool SLocSpaceExhausted;
+
   /// \brief A bitmap that indicates whether the entries of LoadedSLocEntryTable
   /// have already been loaded from the external source.
   ///
@@ -649,7 +721,6 @@ class SourceManager : public RefCountedBase<SourceManager> {
   /// method which is used to speedup getLineNumber calls to nearby locations.
   mutable FileID LastLineNoFileIDQuery;
   mutable SrcMgr::ContentCache *LastLineNoContentCache;
-  mutable unsigned LastLineNoFilePos;
   mutable unsigned LastLineNoResult;
 
   /// \brief The file ID for the main source file of the translation unit.
@@ -773,7 +844,9 @@ public:
   /// \brief Create a new FileID that represents the specified file
   /// being \#included from the specified IncludePosition.
   ///
-  /// This translates NULL into standard input.
+  /// This translates NULL into standard input. Returns an invalid FileID,
+  /// after emitting a fatal error, if the file does not fit in the source
+  /// location address space.
   FileID createFileID(const FileEntry *SourceFile, SourceLocation IncludePos,
                       SrcMgr::CharacteristicKind FileCharacter,
                       int LoadedID = 0, unsigned LoadedOffset = 0) {
@@ -787,7 +860,8 @@ public:
   /// \brief Create a new FileID that represents the specified memory buffer.
   ///
   /// This does no caching of the buffer and takes ownership of the
-  /// MemoryBuffer, so only pass a MemoryBuffer to this once.
+  /// MemoryBuffer, so only pass a MemoryBuffer to this once. Returns an
+  /// invalid FileID if the buffer does not fit, like the overload above.
   FileID createFileID(std::unique_ptr<llvm::MemoryBuffer> Buffer,
                       SrcMgr::CharacteristicKind FileCharacter = SrcMgr::C_User,
                       int LoadedID = 0, unsigned LoadedOffset = 0,
@@ -816,6 +890,9 @@ public:
   /// \brief Return a new SourceLocation that encodes the fact
   /// that a token from SpellingLoc should actually be referenced from
   /// ExpansionLoc.
+  ///
+  /// Returns an invalid SourceLocation, after emitting a fatal error, if the
+  /// source location address space is full.
   SourceLocation createExpansionLoc(SourceLocation Loc,
                                     SourceLocation ExpansionLocStart,
                                     SourceLocation ExpansionLocEnd,
@@ -1613,6 +1690,11 @@ private:
                                         int LoadedID = 0,
                                         unsigned LoadedOffset = 0);
 
+  /// \brief Report that the local source location address space is full,
+  /// with a summary of what it was used for, unless that was already
+  /// reported.
+  void reportSLocSpaceExhausted(SourceLocation Loc);
+
   /// \brief Return true if the specified FileID contains the
   /// specified SourceLocation offset.  This is a very hot method.
   inline bool isOffsetInFileID(FileID FID, unsigned SLocOffset) const {
@@ -302,6 +302,12 @@ public:
   /// exists in the file system with different contents.
   bool addFileNoOwn(const Twine &Path, time_t ModificationTime,
                     llvm::MemoryBuffer *Buffer);
+  /// Remove the file at \p Path from the VFS, releasing its buffer if the VFS
+  /// owns it. Files opened from it must not be used afterwards. Directories
+  /// are kept, even once they are empty.
+  /// \return true if the file was removed, false if there is no file at
+  /// \p Path.
+  bool removeFile(const Twine &Path);
   std::string toString() const;
   /// Return true if this file system normalizes . and .. in paths.
   bool useNormalizedPaths() const { return UseNormalizedPaths; }
@@ -259,12 +259,69 @@ private:
   /// a line after skipping the preamble.
   bool PreambleEndsAtStartOfLine;
 
-  /// \brief Keeps track of the files that were used when computing the 
-  /// preamble, with both their buffer size and their modification time.
+  /// \brief A layer of the precompiled preamble.
   ///
-  /// If any of the files have changed from one compile to the next,
-  /// the preamble must be thrown away.
-  llvm::StringMap<PreambleFileHash> FilesInPreamble;
+  /// Each layer is a precompiled header of the preamble up to the layer's
+  /// end, chained onto the layer below it, so that a change to the preamble
+  /// only requires rebuilding the layers from the one the change is in up.
+  /// Unless \c ChainedPreamble is set, the preamble has a single layer.
+  struct PreambleLayer {
+    /// \brief The offset in the main file at which the layer ends.
+    unsigned End;
+
+    /// \brief Whether the layer ends at the start of a new line.
+    bool EndsAtStartOfLine;
+
+    /// \brief The precompiled header of the layer, on disk or in
+    /// \c PreambleFS.
+    std::string PCHFile;
+
+    /// \brief Keeps track of the files that were used when building the
+    /// layer, with both their buffer size and their modification time.
+    ///
+    /// If any of the files have changed from one compile to the next,
+    /// the layer and the layers above it must be thrown away.
+    llvm::StringMap<PreambleFileHash> Files;
+
+    /// \brief The diagnostics produced when building the layer.
+    SmallVector<StandaloneDiagnostic, 4> Diagnostics;
+
+    /// \brief The number of warnings produced when building the layer.
+    unsigned NumWarnings;
+
+    /// \brief The serialization ID numbers of the top-level declarations
+    /// parsed within the layer.
+    std::vector<serialization::DeclID> TopLevelDecls;
+
+    /// \brief A string hash of the top-level declaration and macro
+    /// definition names parsed within the layer.
+    unsigned TopLevelHashValue;
+  };
+
+  /// \brief The layers of the precompiled preamble, from the bottom up.
+  SmallVector<PreambleLayer, 4> PreambleLayers;
+
+  /// \brief The loaded file IDs of the main file as it was seen by each
+  /// layer of the precompiled preamble used by the AST, from the bottom up.
+  SmallVector<FileID, 4> PreambleLayerFileIDs;
+
+  /// \brief When non-NULL, the file system holding the precompiled headers
+  /// of the preamble layers, which are then never written to disk.
+  IntrusiveRefCntPtr<vfs::InMemoryFileSystem> PreambleFS;
+
+  /// \brief The precompiled headers in \c PreambleFS of the layers that were
+  /// thrown away.
+  ///
+  /// The AST may still be reading from them, so they are only removed when
+  /// it is torn down.
+  std::vector<std::string> DiscardedPreambleFiles;
+
+  /// \brief The precompiled header of the top preamble layer, which chains
+  /// to the layers below it, or an empty string if there is none.
+  StringRef getPreambleFile() const {
+    return PreambleLayers.empty() ? StringRef()
+                                  : StringRef(PreambleLayers.back().PCHFile);
+  }
 
   /// \brief When non-NULL, this is the buffer used to store the contents of
   /// the main file when it has been padded for use with the precompiled
@@ -298,6 +355,9 @@ private:
   /// \brief True if non-system source files should be treated as volatile
   /// (likely to change while trying to use them).
   bool UserFilesAreVolatile : 1;
+
+  /// \brief Whether the precompiled preamble is split into several layers.
+  bool ChainedPreamble : 1;
  
   /// \brief The language options used when we load an AST file.
   LangOptions ASTFileLangOpts;
@@ -443,6 +503,13 @@ private:
       std::shared_ptr<PCHContainerOperations> PCHContainerOps,
       const CompilerInvocation &PreambleInvocationIn, bool AllowRebuild = true,
       unsigned MaxLines = 0);
+  bool buildPreambleLayer(
+      std::shared_ptr<PCHContainerOperations> PCHContainerOps,
+      const CompilerInvocation &PreambleInvocationIn, StringRef PreambleText,
+      bool EndsAtStartOfLine);
+  void discardPreambleLayers(unsigned FirstLayer);
+  IntrusiveRefCntPtr<vfs::FileSystem>
+  overlayPreambleFS(IntrusiveRefCntPtr<vfs::FileSystem> VFS);
   void RealizeTopLevelDeclsFromPreamble();
 
   /// \brief Transfers ownership of the objects (like SourceManager) from
@@ -621,6 +688,13 @@ public:
   SourceLocation getStartOfMainFileID();
   SourceLocation getEndOfPreambleFileID();
 
+  /// \brief The file IDs of the main file in the layers of the precompiled
+  /// preamble, from the bottom up.
+  ///
+  /// Each layer only holds the preprocessed entities from the end of the
+  /// layer below it to its own end.
+  ArrayRef<FileID> getPreambleFileIDs() const { return PreambleLayerFileIDs; }
+
   /// \see mapLocationFromPreamble.
   SourceRange mapRangeFromPreamble(SourceRange R) {
     return SourceRange(mapLocationFromPreamble(R.getBegin()),
@@ -825,6 +899,12 @@ public:
   ///
   /// \param ResourceFilesPath - The path to the compiler resource files.
   ///
+  /// \param ChainedPreamble - Whether to split the precompiled preamble into
+  /// layers that are rebuilt separately when the preamble changes.
+  ///
+  /// \param StorePreambleInMemory - Whether to keep the precompiled preamble
+  /// in memory rather than in temporary files.
+  ///
   /// \param ModuleFormat - If provided, uses the specific module format.
   ///
   /// \param ErrAST - If non-null and parsing failed without any AST to return
@@ -846,6 +926,7 @@ public:
       bool IncludeBriefCommentsInCodeCompletion = false,
       bool AllowPCHWithCompilerErrors = false, bool SkipFunctionBodies = false,
       bool UserFilesAreVolatile = false, bool ForSerialization = false,
+      bool ChainedPreamble = false, bool StorePreambleInMemory = false,
       llvm::Optional<StringRef> ModuleFormat = llvm::None,
       std::unique_ptr<ASTUnit> *ErrAST = nullptr);
 
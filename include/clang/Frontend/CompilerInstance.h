@@ -45,6 +45,7 @@ class FileEntry;
 class FileManager;
 class FrontendAction;
 class Module;
+class PersistentStatCache;
 class Preprocessor;
 class Sema;
 class SourceManager;
@@ -87,6 +88,12 @@ class CompilerInstance : public ModuleLoader {
   /// The file manager.
   IntrusiveRefCntPtr<FileManager> FileMgr;
 
+  /// The persistent stat cache that createFileManager() installed in the
+  /// file manager, if any. Implicit module builds share the file manager of
+  /// the importer, but only the instance that installed this cache saves and
+  /// removes it.
+  PersistentStatCache *OwnedStatCache;
+
   /// The source manager.
   IntrusiveRefCntPtr<SourceManager> SourceMgr;
 
@@ -393,6 +400,7 @@ public:
   void resetAndLeakFileManager() {
     BuryPointer(FileMgr.get());
     FileMgr.resetWithoutRelease();
+    OwnedStatCache = nullptr;
   }
 
   /// \brief Replace the current file manager and virtual file system.
@@ -652,7 +660,8 @@ public:
       const PCHContainerReader &PCHContainerRdr,
       ArrayRef<IntrusiveRefCntPtr<ModuleFileExtension>> Extensions,
       void *DeserializationListener, bool OwnDeserializationListener,
-      bool Preamble, bool UseGlobalModuleIndex);
+      bool Preamble, bool UseGlobalModuleIndex,
+      bool CollectModuleLoadProfile = false);
 
   /// Create a code completion consumer using the invocation; note that this
   /// will cause the source manager to truncate the input source file at the
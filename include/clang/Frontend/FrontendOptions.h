@@ -266,6 +266,10 @@ public:
   /// (in the format produced by -fdump-record-layouts).
   std::string OverrideRecordLayoutsFile;
 
+  /// \brief If non-empty, the file to write the module load profile, which
+  /// records what was read from each AST file, to.
+  std::string ModuleLoadProfileFile;
+
   /// \brief Auxiliary triple for CUDA compilation.
   std::string AuxTriple;
 
@@ -32,6 +32,7 @@ class FileEntry;
 class FileManager;
 class HeaderSearchOptions;
 class IdentifierInfo;
+class IncludeGuardCache;
 class Preprocessor;
 
 /// \brief The preprocessor keeps track of this information for each
@@ -227,6 +228,12 @@ class HeaderSearch {
   /// \brief Uniqued set of framework names, which is used to track which 
   /// headers were included as framework headers.
   llvm::StringSet<llvm::BumpPtrAllocator> FrameworkNames;
+
+  /// \brief The lower-cased names of the entries of each search directory
+  /// that has been looked in, when header search uses directory listings.
+  /// Null if the directory could not be read.
+  llvm::DenseMap<const DirectoryEntry *, std::unique_ptr<llvm::StringSet<>>>
+      DirectoryListings;
   
   /// \brief Entity used to resolve the identifier IDs of controlling
   /// macros into IdentifierInfo pointers, and keep the identifire up to date,
@@ -240,6 +247,11 @@ class HeaderSearch {
   unsigned NumIncluded;
   unsigned NumMultiIncludeFileOptzn;
   unsigned NumFrameworkLookups, NumSubFrameworkLookups;
+  unsigned NumDirectoryListingSkips;
+  unsigned NumIncludeGuardCacheSkips;
+
+  /// \brief The include guards remembered across translation units, if any.
+  std::unique_ptr<IncludeGuardCache> GuardCache;
 
   // HeaderSearch doesn't support default or copy construction.
   HeaderSearch(const HeaderSearch&) = delete;
@@ -448,6 +460,15 @@ public:
     getFileInfo(File).ControllingMacro = ControllingMacro;
   }
 
+  /// \brief Remember for later translation units that \p File is guarded by
+  /// \p ControllingMacro, if there is an include guard cache.
+  void recordIncludeGuard(const FileEntry *File,
+                          const IdentifierInfo *ControllingMacro);
+
+  /// \brief Write the include guards found by this translation unit back to
+  /// the include guard cache, if there is one.
+  void saveIncludeGuards();
+
   /// \brief Return true if this is the first time encountering this header.
   bool FirstTimeLexingFile(const FileEntry *File) {
     return getFileInfo(File).NumIncludes == 1;
@@ -580,6 +601,11 @@ private:
       const FileEntry *File, StringRef FrameworkDir, Module *RequestingModule,
       ModuleMap::KnownHeader *SuggestedModule, bool IsSystemFramework);
 
+  /// \brief Determine whether the directory \p Dir may contain the relative
+  /// path \p Filename, from the listing of \p Dir. Always true unless header
+  /// search uses directory listings.
+  bool directoryMayContain(const DirectoryEntry *Dir, StringRef Filename);
+
   /// \brief Look up the file with the specified name and determine its owning
   /// module.
   const FileEntry *
@@ -172,11 +172,33 @@ public:
   /// \brief Whether to validate system input files when a module is loaded.
   unsigned ModulesValidateSystemHeaders : 1;
 
+  /// \brief Whether AST files record a hash of the contents of their input
+  /// files, and whether an input file whose modification time changed is
+  /// still accepted when its contents hash to the recorded value.
+  unsigned ValidateASTInputFilesContent : 1;
+
+  /// \brief Whether AST files compress the lexical and visible tables of
+  /// declaration contexts.
+  unsigned CompressASTFiles : 1;
+
+  /// \brief Whether modules in the module cache keep the file contents they
+  /// embed in a store shared by all of them, rather than in each module.
+  /// Ignored when DisableModuleHash is set.
+  unsigned ModulesShareFileContents : 1;
+
   /// Whether the module includes debug information (-gmodules).
   unsigned UseDebugInfo : 1;
 
   unsigned ModulesValidateDiagnosticOptions : 1;
 
+  /// \brief The file in which the include guards of headers are remembered
+  /// across translation units, if any.
+  std::string IncludeGuardCachePath;
+
+  /// Whether to read the listing of each search directory once, and only
+  /// look for headers whose names it contains.
+  unsigned UseDirectoryListings : 1;
+
   HeaderSearchOptions(StringRef _Sysroot = "/")
       : Sysroot(_Sysroot), ModuleFormat("raw"), DisableModuleHash(0),
         ImplicitModuleMaps(0), ModuleMapFileHomeIsCwd(0),
@@ -186,7 +208,10 @@ public:
         UseStandardCXXIncludes(true), UseLibcxx(false), Verbose(false),
         ModulesValidateOncePerBuildSession(false),
         ModulesValidateSystemHeaders(false),
-        UseDebugInfo(false), ModulesValidateDiagnosticOptions(true) {}
+        ValidateASTInputFilesContent(false), CompressASTFiles(false),
+        ModulesShareFileContents(false),
+        UseDebugInfo(false), ModulesValidateDiagnosticOptions(true),
+        UseDirectoryListings(false) {}
 
   /// AddPath - Add the \p Path path to the specified \p Group list.
   void AddPath(StringRef Path, frontend::IncludeDirGroup Group,
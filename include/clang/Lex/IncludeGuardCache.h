@@ -0,0 +1,91 @@
+//===--- IncludeGuardCache.h - Include guards across TUs --------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines the IncludeGuardCache class, which remembers the include
+/// guards of headers across translation units.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_LEX_INCLUDEGUARDCACHE_H
+#define LLVM_CLANG_LEX_INCLUDEGUARDCACHE_H
+
+#include "clang/Basic/LLVM.h"
+#include "clang/Basic/OnDiskCacheFile.h"
+#include "llvm/ADT/StringMap.h"
+#include <memory>
+
+namespace clang {
+
+class FileEntry;
+
+/// \brief The include guards of headers, kept in a file that is shared by
+/// many translation units.
+///
+/// The multiple-include optimization only knows a header's guard macro once
+/// the header has been lexed in the current translation unit. This cache
+/// remembers the guards found by earlier translation units, keyed by the
+/// header's path and validated by its size and modification time, so that a
+/// header whose guard macro is already defined can be skipped without being
+/// read, even the first time it is included.
+///
+/// Headers that use \#pragma once rather than a guard macro are not
+/// recorded. Nothing outside such a header says whether it has been entered,
+/// so the first \#include of it in each translation unit must enter it
+/// anyway, and later ones are already skipped without opening it.
+///
+/// The cache file is memory mapped while the cache is in use. New guards are
+/// merged with the file's current contents and written back atomically by
+/// save(), so that concurrent compilations never see a partial file.
+class IncludeGuardCache {
+public:
+  /// \brief Open the cache stored in \p CachePath. A missing or unreadable
+  /// file is treated as an empty cache.
+  explicit IncludeGuardCache(StringRef CachePath);
+  ~IncludeGuardCache();
+
+  /// \brief Returns the guard macro of \p File, or an empty string if it is
+  /// not known.
+  StringRef getGuard(const FileEntry *File);
+
+  /// \brief Remember that \p File is guarded by the macro \p Guard.
+  void setGuard(const FileEntry *File, StringRef Guard);
+
+  /// \brief Write the guards found since the cache was opened back to the
+  /// cache file, if there are any. This is called by the destructor.
+  ///
+  /// \returns true if an error occurred.
+  bool save();
+
+private:
+  class IncludeGuardTrait;
+  typedef OnDiskCacheTable<IncludeGuardTrait> Table;
+
+  /// \brief Read the cache file at \p Path, returning its table of guards,
+  /// or null if the file is missing or is not a valid cache file.
+  static std::unique_ptr<Table> loadTable(StringRef Path);
+
+  std::string CachePath;
+  std::unique_ptr<Table> Guards;
+
+  /// \brief A guard that is not in the cache file yet, or that replaces an
+  /// out-of-date one.
+  struct NewGuard {
+    uint64_t ModTime;
+    uint64_t Size;
+    std::string Guard;
+  };
+
+  /// \brief The guards to write back, keyed by path.
+  llvm::StringMap<NewGuard> NewGuards;
+};
+
+} // end namespace clang
+
+#endif
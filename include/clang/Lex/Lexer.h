@@ -207,6 +207,15 @@ public:
   /// uninterpreted string.  This switches the lexer out of directive mode.
   void ReadToEndOfLine(SmallVectorImpl<char> *Result = nullptr);
 
+  /// SkipExcludedText - While skipping an excluded conditional block in raw
+  /// mode, advance over text that cannot start a directive without lexing
+  /// it.  This stops at the first character of a line that could start a
+  /// directive, and at anything the lexer has to see in order to find the
+  /// start of the next line correctly: comments, string and character
+  /// literals, escaped newlines other than a plain backslash-newline,
+  /// possible trigraphs and null characters.
+  void SkipExcludedText();
+
 
   /// Diag - Forwarding function for diagnostics.  This translate a source
   /// position in the current buffer into a SourceLocation object for rendering.
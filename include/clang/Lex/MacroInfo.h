@@ -84,6 +84,12 @@ class MacroInfo {
   /// \brief Whether this macro contains the sequence ", ## __VA_ARGS__"
   bool HasCommaPasting : 1;
 
+  /// \brief Whether the replacement list contains a '##' or a comment token.
+  ///
+  /// The tokens of an object-like macro without either are returned as they
+  /// are, with only their locations changed.
+  bool HasPasteOrComment : 1;
+
   //===--------------------------------------------------------------------===//
   // State that changes as the macro is used.
 
@@ -214,6 +220,10 @@ public:
   bool hasCommaPasting() const { return HasCommaPasting; }
   void setHasCommaPasting() { HasCommaPasting = true; }
 
+  /// \brief Return true if the replacement list contains a '##' or a
+  /// comment token.
+  bool hasPasteOrComment() const { return HasPasteOrComment; }
+
   /// \brief Return false if this macro is defined in the main file and has
   /// not yet been used.
   bool isUsed() const { return IsUsed; }
@@ -246,6 +256,8 @@ public:
     assert(
         !IsDefinitionLengthCached &&
         "Changing replacement tokens after definition length got calculated");
+    if (Tok.isOneOf(tok::hashhash, tok::comment))
+      HasPasteOrComment = true;
     ReplacementTokens.push_back(Tok);
   }
 
@@ -99,6 +99,13 @@ class TokenLexer {
   /// should not be subject to further macro expansion.
   bool DisableMacroExpansion : 1;
 
+  /// IsSimpleExpansion - This is true when expanding an object-like macro
+  /// without '##' or comments in its definition.  Every token then comes
+  /// straight from the definition, so Lex only has to move its location into
+  /// the expansion; it never pastes tokens or checks where a location came
+  /// from.
+  bool IsSimpleExpansion : 1;
+
   TokenLexer(const TokenLexer &) = delete;
   void operator=(const TokenLexer &) = delete;
 public:
@@ -36,7 +36,7 @@ namespace clang {
     /// Version 4 of AST files also requires that the version control branch and
     /// revision match exactly, since there is no backward compatibility of
     /// AST files at this time.
-    const unsigned VERSION_MAJOR = 6;
+    const unsigned VERSION_MAJOR = 7;
 
     /// \brief AST file minor version number supported by this version of
     /// Clang.
@@ -293,6 +293,10 @@ namespace clang {
 
       /// \brief Record code for the module build directory.
       MODULE_DIRECTORY,
+
+      /// \brief Record code for the hashes of the file contents that this
+      /// AST file keeps in the store of shared file contents.
+      SHARED_FILE_CONTENTS,
     };
 
     /// \brief Record types that occur within the options block inside
@@ -335,7 +339,11 @@ namespace clang {
     /// inside the control block.
     enum InputFileRecordTypes {
       /// \brief An input file.
-      INPUT_FILE = 1
+      INPUT_FILE = 1,
+
+      /// \brief The hash of the contents of the input file that precedes
+      /// it, written with -fvalidate-ast-input-files-content.
+      INPUT_FILE_HASH
     };
 
     /// \brief Record types that occur within the AST block itself.
@@ -601,7 +609,11 @@ namespace clang {
       SM_SLOC_BUFFER_BLOB_COMPRESSED = 4,
       /// \brief Describes a source location entry (SLocEntry) for a
       /// macro expansion.
-      SM_SLOC_EXPANSION_ENTRY = 5
+      SM_SLOC_EXPANSION_ENTRY = 5,
+      /// \brief Describes a buffer entry whose data is kept, compressed, in
+      /// the store of file contents shared by the modules in the module
+      /// cache. The blob is the hash of the data, under which it is stored.
+      SM_SLOC_BUFFER_BLOB_SHARED = 6
     };
 
     /// \brief Record types used within a preprocessor block.
@@ -1179,6 +1191,14 @@ namespace clang {
       DECL_PRAGMA_DETECT_MISMATCH,
       /// \brief An OMPDeclareReductionDecl record.
       DECL_OMP_DECLARE_REDUCTION,
+      /// \brief A DECL_CONTEXT_LEXICAL record whose blob is compressed with
+      /// zlib. The record stores the size of the uncompressed blob. It is
+      /// decompressed when the context is first walked.
+      DECL_CONTEXT_LEXICAL_COMPRESSED,
+      /// \brief A DECL_CONTEXT_VISIBLE record whose blob is compressed with
+      /// zlib. The record stores the size of the uncompressed blob. It is
+      /// decompressed when the context is first looked into.
+      DECL_CONTEXT_VISIBLE_COMPRESSED,
     };
 
     /// \brief Record codes for each kind of statement or expression.
@@ -40,6 +40,7 @@
 #include "llvm/ADT/TinyPtrVector.h"
 #include "llvm/Support/DataTypes.h"
 #include "llvm/Support/Timer.h"
+#include <chrono>
 #include <deque>
 #include <memory>
 #include <string>
@@ -416,6 +417,21 @@ private:
   /// \brief A timer used to track the time spent deserializing.
   std::unique_ptr<llvm::Timer> ReadTimer;
 
+  /// \brief Whether to collect the module load profile of each module file.
+  bool CollectModuleLoadProfile;
+
+  /// \brief The module file that the time spent reading is charged to in the
+  /// module load profile, if any.
+  ModuleFile *ProfiledModule;
+
+  /// \brief When the time spent reading started being charged to
+  /// \c ProfiledModule.
+  std::chrono::steady_clock::time_point ProfiledModuleStartTime;
+
+  /// \brief A description of the lookup being performed, which the
+  /// declarations read are attributed to in the module load profile.
+  std::string CurrentLookup;
+
   /// \brief The location where the module file will be considered as
   /// imported from. For non-module AST types it should be invalid.
   SourceLocation CurrentImportLoc;
@@ -519,6 +535,19 @@ private:
   llvm::DenseMap<const DeclContext*, std::pair<ModuleFile*, LexicalContents>>
       LexicalDecls;
 
+  /// \brief Lexical contents that were stored compressed, and have not been
+  /// needed yet.
+  struct CompressedLexicalContents {
+    ModuleFile *Mod;
+    StringRef Blob;
+    uint64_t UncompressedSize;
+  };
+
+  /// \brief Map from a DeclContext to its compressed lexical contents. They
+  /// move to \c LexicalDecls the first time the context is walked.
+  llvm::DenseMap<const DeclContext *, CompressedLexicalContents>
+      CompressedLexicalDecls;
+
   /// \brief Map from the TU to its lexical contents from each module file.
   std::vector<std::pair<ModuleFile*, LexicalContents>> TULexicalDecls;
 
@@ -533,6 +562,10 @@ private:
   struct PendingVisibleUpdate {
     ModuleFile *Mod;
     const unsigned char *Data;
+    /// \brief If the table was stored compressed, the compressed table and
+    /// its size once decompressed. \c Data is null until it is decompressed.
+    StringRef Compressed;
+    uint64_t UncompressedSize;
   };
   typedef SmallVector<PendingVisibleUpdate, 1> DeclContextVisibleUpdates;
 
@@ -541,6 +574,12 @@ private:
   llvm::DenseMap<serialization::DeclID, DeclContextVisibleUpdates>
       PendingVisibleUpdates;
 
+  /// \brief Lookup tables of loaded declaration contexts that wait behind a
+  /// compressed table, in the order they were read. They are added to
+  /// \c Lookups the first time the context is looked into.
+  llvm::DenseMap<const DeclContext *, DeclContextVisibleUpdates>
+      PendingCompressedLookupTables;
+
   /// \brief The set of C++ or Objective-C classes that have forward 
   /// declarations that have not yet been linked to their definitions.
   llvm::SmallPtrSet<Decl *, 4> PendingDefinitions;
@@ -565,6 +604,12 @@ private:
   bool ReadVisibleDeclContextStorage(ModuleFile &M,
                                      llvm::BitstreamCursor &Cursor,
                                      uint64_t Offset, serialization::DeclID ID);
+  /// \brief Decompress the lexical contents of \p DC, if they are still
+  /// compressed.
+  void loadCompressedLexicalDecls(const DeclContext *DC);
+  /// \brief Decompress the lookup tables of \p DC that are still compressed,
+  /// and add them to its lookup tables along with those queued behind them.
+  void loadCompressedLookupTables(const DeclContext *DC);
 
   /// \brief A vector containing identifiers that have already been
   /// loaded.
@@ -1076,6 +1121,63 @@ private:
     ~ProcessingUpdatesRAIIObj() { Reader.ProcessingUpdateRecords = PrevState; }
   };
 
+  /// \brief RAII object that charges the time spent in its scope to a module
+  /// file in the module load profile, excluding the time spent in nested
+  /// scopes for other module files.
+  class ProfiledModuleRAIIObj {
+    ASTReader &Reader;
+    ModuleFile *PrevModule;
+
+    ProfiledModuleRAIIObj(const ProfiledModuleRAIIObj &) = delete;
+    void operator=(const ProfiledModuleRAIIObj &) = delete;
+
+  public:
+    ProfiledModuleRAIIObj(ASTReader &reader, ModuleFile &M)
+      : Reader(reader), PrevModule(Reader.ProfiledModule) {
+      // Only look at the clock when switching to another module file, not
+      // for every declaration or type read from the same one.
+      if (Reader.CollectModuleLoadProfile && &M != PrevModule)
+        Reader.switchProfiledModule(&M);
+    }
+
+    ~ProfiledModuleRAIIObj() {
+      if (Reader.CollectModuleLoadProfile &&
+          Reader.ProfiledModule != PrevModule)
+        Reader.switchProfiledModule(PrevModule);
+    }
+  };
+
+  /// \brief RAII object that attributes the declarations read in its scope
+  /// to a lookup in the module load profile.
+  class ProfiledLookupRAIIObj {
+    ASTReader &Reader;
+    std::string PrevLookup;
+
+    ProfiledLookupRAIIObj(const ProfiledLookupRAIIObj &) = delete;
+    void operator=(const ProfiledLookupRAIIObj &) = delete;
+
+  public:
+    /// \param Describe Returns the description of the lookup. It is only
+    /// called when a module load profile is being collected.
+    ProfiledLookupRAIIObj(ASTReader &reader,
+                          llvm::function_ref<std::string()> Describe)
+      : Reader(reader) {
+      if (Reader.CollectModuleLoadProfile) {
+        PrevLookup = std::move(Reader.CurrentLookup);
+        Reader.CurrentLookup = Describe();
+      }
+    }
+
+    ~ProfiledLookupRAIIObj() {
+      if (Reader.CollectModuleLoadProfile)
+        Reader.CurrentLookup = std::move(PrevLookup);
+    }
+  };
+
+  /// \brief Charge the time spent reading since the last switch to the
+  /// module file being profiled, then start charging it to \p M.
+  void switchProfiledModule(ModuleFile *M);
+
   /// \brief Suggested contents of the predefines buffer, after this
   /// PCH file has been processed.
   ///
@@ -1095,11 +1197,35 @@ private:
     time_t StoredTime;
     bool Overridden;
     bool Transient;
+    /// \brief The hash of the file's contents, or 0 if it is not known.
+    uint64_t ContentHash;
   };
 
   /// \brief Reads the stored information about an input file.
   InputFileInfo readInputFileInfo(ModuleFile &F, unsigned ID);
 
+  /// \brief The hashes of the contents of the input files whose modification
+  /// time no longer matches the one stored in an AST file, so that each of
+  /// them is read and hashed at most once, whichever AST files refer to it.
+  llvm::DenseMap<const FileEntry *, uint64_t> InputFileContentHashes;
+
+  /// \brief The file contents read from the stores shared by the modules in
+  /// a module cache, keyed by path. Each is decompressed once, however many
+  /// modules embed it.
+  llvm::StringMap<std::unique_ptr<llvm::MemoryBuffer>> SharedFileContents;
+
+  /// \brief Returns the file contents stored under \p Hash in the store
+  /// shared by \p F and the other modules in its module cache, or null if
+  /// they are missing, damaged, or are not \p Size bytes long.
+  const llvm::MemoryBuffer *getSharedFileContents(ModuleFile &F,
+                                                  StringRef Hash,
+                                                  uint64_t Size);
+
+  /// \brief Returns the hash of the current contents of \p File, as
+  /// recorded in AST files by -fvalidate-ast-input-files-content, or 0 if
+  /// it cannot be read.
+  uint64_t getInputFileContentHash(const FileEntry *File);
+
   /// \brief Retrieve the file entry and 'overridden' bit for an input
   /// file in the given module file.
   serialization::InputFile getInputFile(ModuleFile &F, unsigned ID,
@@ -1141,7 +1267,7 @@ public:
 
   /// \brief Get the loaded lookup tables for \p Primary, if any.
   const serialization::reader::DeclContextLookupTable *
-  getLoadedLookupTables(DeclContext *Primary) const;
+  getLoadedLookupTables(DeclContext *Primary);
 
 private:
   struct ImportedModule {
@@ -1798,6 +1924,21 @@ public:
   /// \brief Dump information about the AST reader to standard error.
   void dump();
 
+  /// \brief Collect a profile of what is read from each module file, to be
+  /// written by writeModuleLoadProfile(). This must be called before any AST
+  /// file is read.
+  void setCollectModuleLoadProfile(bool Collect) {
+    CollectModuleLoadProfile = Collect;
+  }
+
+  /// \brief Write the module load profile to \p OS, as JSON.
+  ///
+  /// The profile lists the module files in the order they were loaded, with
+  /// the time spent reading each of them, the number of declarations, types
+  /// and statements read from them and the size of those records, and the
+  /// lookups that caused their declarations to be read.
+  void writeModuleLoadProfile(raw_ostream &OS);
+
   /// Return the amount of memory used by memory buffers, breaking down
   /// by heap-backed versus mmap'ed memory.
   void getMemoryBufferSizes(MemoryBufferSizes &sizes) const override;
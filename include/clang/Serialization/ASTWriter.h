@@ -25,6 +25,7 @@
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Bitcode/BitstreamWriter.h"
 #include <queue>
@@ -293,6 +294,24 @@ private:
   /// table, indexed by the Selector ID (-1).
   std::vector<uint32_t> SelectorOffsets;
 
+  /// \brief The contents of a buffer that is written out with the source
+  /// manager block, its compressed form, and the hash under which it is kept
+  /// in the store of shared file contents, if it is.
+  struct SLocBufferBlob {
+    StringRef Contents;
+    SmallString<0> Compressed;
+    bool IsCompressed;
+    SmallString<32> SharedHash;
+
+    void compress();
+    void share(StringRef StoreDir);
+  };
+
+  /// \brief The buffers written out with the source manager block, in order.
+  /// They are prepared before the control block, which lists the ones that
+  /// are kept in the store of shared file contents.
+  std::vector<SLocBufferBlob> SLocBufferBlobs;
+
   /// \brief Mapping from macro definitions (as they occur in the preprocessing
   /// record) to the macro IDs.
   llvm::DenseMap<const MacroDefinitionRecord *,
@@ -425,6 +444,9 @@ private:
                              StringRef isysroot, const std::string &OutputFile);
   void WriteInputFiles(SourceManager &SourceMgr, HeaderSearchOptions &HSOpts,
                        bool Modules);
+  void PrepareSourceManagerBlobs(SourceManager &SourceMgr,
+                                 const Preprocessor &PP,
+                                 StringRef OutputFile);
   void WriteSourceManagerBlock(SourceManager &SourceMgr,
                                const Preprocessor &PP);
   void WritePreprocessor(const Preprocessor &PP, bool IsModule);
@@ -447,6 +469,9 @@ private:
                                llvm::SmallVectorImpl<char> &LookupTable);
   uint64_t WriteDeclContextLexicalBlock(ASTContext &Context, DeclContext *DC);
   uint64_t WriteDeclContextVisibleBlock(ASTContext &Context, DeclContext *DC);
+  void EmitDeclContextBlob(unsigned Code, unsigned Abbrev,
+                           unsigned CompressedCode, unsigned CompressedAbbrev,
+                           StringRef Blob);
   void WriteTypeDeclOffsets();
   void WriteFileDeclIDsMap();
   void WriteComments();
@@ -469,6 +494,8 @@ private:
   unsigned DeclParmVarAbbrev;
   unsigned DeclContextLexicalAbbrev;
   unsigned DeclContextVisibleLookupAbbrev;
+  unsigned DeclContextLexicalCompressedAbbrev;
+  unsigned DeclContextVisibleLookupCompressedAbbrev;
   unsigned UpdateVisibleAbbrev;
   unsigned DeclRecordAbbrev;
   unsigned DeclTypedefAbbrev;
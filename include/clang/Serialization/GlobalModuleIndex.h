@@ -37,6 +37,7 @@ class FileManager;
 class IdentifierIterator;
 class PCHContainerOperations;
 class PCHContainerReader;
+class Selector;
 
 namespace serialization {
   class ModuleFile;
@@ -90,6 +91,11 @@ class GlobalModuleIndex {
     /// \brief The module IDs on which this module directly depends.
     /// FIXME: We don't really need a vector here.
     llvm::SmallVector<unsigned, 4> Dependencies;
+
+    /// \brief A Bloom filter over the hashes of the selectors in this
+    /// module file's method pool, pointing into the index file. Empty if the
+    /// module file has no method pool.
+    StringRef SelectorFilter;
   };
 
   /// \brief A mapping from module IDs to information about each module.
@@ -115,6 +121,13 @@ class GlobalModuleIndex {
   /// \brief The number of identifier lookup hits, where we recognize the
   /// identifier.
   unsigned NumIdentifierLookupHits;
+
+  /// \brief The number of selector lookups we performed.
+  unsigned NumSelectorLookups;
+
+  /// \brief The number of module files that the selector filters could not
+  /// rule out, over all selector lookups.
+  unsigned NumSelectorLookupModuleHits;
   
   /// \brief Internal constructor. Use \c readIndex() to read an index.
   explicit GlobalModuleIndex(std::unique_ptr<llvm::MemoryBuffer> Buffer,
@@ -179,6 +192,22 @@ public:
   /// \returns true if the identifier is known to the index, false otherwise.
   bool lookupIdentifier(StringRef Name, HitSet &Hits);
 
+  /// \brief Look for all of the module files that might have methods with
+  /// the given selector in their method pool.
+  ///
+  /// This consults a Bloom filter per module file, so \p Hits can contain
+  /// module files that do not know about the selector after all, but never
+  /// misses one that does.
+  ///
+  /// \param Sel The selector to look for.
+  ///
+  /// \param Hits Will be populated with the set of module files that might
+  /// have information about this selector.
+  ///
+  /// \returns true if the index has information about selectors, false
+  /// otherwise.
+  bool lookupSelector(Selector Sel, HitSet &Hits);
+
   /// \brief Note that the given module file has been loaded.
   ///
   /// \returns false if the global module index has information about this
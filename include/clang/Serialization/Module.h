@@ -21,8 +21,11 @@
 #include "clang/Serialization/ContinuousRangeMap.h"
 #include "clang/Serialization/ModuleFileExtension.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Bitcode/BitstreamReader.h"
 #include "llvm/Support/Endian.h"
+#include <deque>
 #include <memory>
 #include <string>
 
@@ -91,6 +94,31 @@ public:
 
 typedef unsigned ASTFileSignature;
 
+/// \brief What was read from a module file, collected when the AST reader was
+/// asked for a module load profile.
+struct ModuleFileProfile {
+  ModuleFileProfile()
+    : ReadTime(0), NumDeclsRead(0), NumTypesRead(0), NumStatementsRead(0),
+      NumBitsRead(0) {}
+
+  /// \brief The wall-clock time, in seconds, spent loading this module file
+  /// and reading records from it, not counting the time spent reading other
+  /// module files in the meantime.
+  double ReadTime;
+
+  unsigned NumDeclsRead;
+  unsigned NumTypesRead;
+  unsigned NumStatementsRead;
+
+  /// \brief The number of bits of declaration, type and statement records
+  /// read from this module file.
+  uint64_t NumBitsRead;
+
+  /// \brief The number of declarations read while performing each lookup,
+  /// keyed by a description of the lookup.
+  llvm::StringMap<unsigned> DeclsReadByLookup;
+};
+
 /// \brief Information about a module that has been loaded by the ASTReader.
 ///
 /// Each instance of the Module class corresponds to a single AST file, which
@@ -167,6 +195,11 @@ public:
   /// this AST file.
   std::unique_ptr<llvm::MemoryBuffer> Buffer;
 
+  /// \brief The blobs of this AST file that were stored compressed and have
+  /// been decompressed so far, one for each declaration context table that
+  /// has been walked or looked into.
+  std::deque<SmallString<0>> DecompressedBlobs;
+
   /// \brief The size of this file, in bits.
   uint64_t SizeInBits;
 
@@ -442,6 +475,10 @@ public:
   /// \brief List of modules which this module depends on
   llvm::SetVector<ModuleFile *> Imports;
 
+  /// \brief What has been read from this module, if the AST reader collects
+  /// a module load profile.
+  ModuleFileProfile Profile;
+
   /// \brief Determine whether this module was directly imported at
   /// any point during translation.
   bool isDirectlyImported() const { return DirectlyImported; }
@@ -0,0 +1,269 @@
+//===--- CharScan.cpp - Scanning Runs of Characters -----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the scan kernels declared in CharScan.h, and picks
+// the widest set of them that the host supports.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Basic/CharScan.h"
+#include "clang/Basic/CharInfo.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MathExtras.h"
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// The AVX2 kernels are compiled with a target attribute, so that the rest of
+// the build doesn't need to assume AVX2, and are only used when the CPU
+// supports it.
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__)) &&        \
+    (LLVM_GNUC_PREREQ(4, 9, 0) ||                                              \
+     (defined(__clang__) && (__clang_major__ > 3 || __clang_minor__ >= 8)))
+#define CLANG_CHARSCAN_AVX2 1
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+using namespace clang;
+using namespace clang::charscan;
+
+//===----------------------------------------------------------------------===//
+// Portable kernels
+//===----------------------------------------------------------------------===//
+
+static const char *scalarFindNewline(const char *Ptr, const char *End) {
+  while (Ptr != End && *Ptr != '\n' && *Ptr != '\r')
+    ++Ptr;
+  return Ptr;
+}
+
+static const char *scalarFindChar(const char *Ptr, const char *End, char C) {
+  const void *Found = memchr(Ptr, C, End - Ptr);
+  return Found ? static_cast<const char *>(Found) : End;
+}
+
+static const char *scalarSkipIdentifierBody(const char *Ptr,
+                                            const char *End) {
+  while (Ptr != End && isIdentifierBody(*Ptr))
+    ++Ptr;
+  return Ptr;
+}
+
+static const char *scalarSkipHorizontalWhitespace(const char *Ptr,
+                                                  const char *End) {
+  while (Ptr != End && isHorizontalWhitespace(*Ptr))
+    ++Ptr;
+  return Ptr;
+}
+
+//===----------------------------------------------------------------------===//
+// SSE2 kernels, 16 bytes at a time
+//===----------------------------------------------------------------------===//
+
+#ifdef __SSE2__
+// Unsigned comparisons of bytes, (V - Lo) < N, done as signed comparisons on
+// values biased by 0x80, since SSE2 and AVX2 only have the latter.
+#define BIASED(C) static_cast<char>(0x80 + (C))
+
+static inline __m128i sse2InRange(__m128i V, char Lo, char N) {
+  return _mm_cmplt_epi8(_mm_sub_epi8(V, _mm_set1_epi8(BIASED(Lo))),
+                        _mm_set1_epi8(BIASED(N)));
+}
+
+static inline unsigned sse2NewlineMask(__m128i V) {
+  return _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(V, _mm_set1_epi8('\n')),
+                                        _mm_cmpeq_epi8(V, _mm_set1_epi8('\r'))));
+}
+
+static inline unsigned sse2NonIdentifierMask(__m128i V) {
+  __m128i Lower = _mm_or_si128(V, _mm_set1_epi8(0x20));
+  __m128i Body = _mm_or_si128(
+      _mm_or_si128(sse2InRange(Lower, 'a', 26), sse2InRange(V, '0', 10)),
+      _mm_cmpeq_epi8(V, _mm_set1_epi8('_')));
+  return ~_mm_movemask_epi8(Body) & 0xFFFF;
+}
+
+static inline unsigned sse2NonWhitespaceMask(__m128i V) {
+  __m128i WS = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(V, _mm_set1_epi8(' ')),
+                   _mm_cmpeq_epi8(V, _mm_set1_epi8('\t'))),
+      _mm_or_si128(_mm_cmpeq_epi8(V, _mm_set1_epi8('\f')),
+                   _mm_cmpeq_epi8(V, _mm_set1_epi8('\v'))));
+  return ~_mm_movemask_epi8(WS) & 0xFFFF;
+}
+
+static inline __m128i sse2Load(const char *Ptr) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(Ptr));
+}
+
+static const char *sse2FindNewline(const char *Ptr, const char *End) {
+  for (; End - Ptr >= 16; Ptr += 16)
+    if (unsigned Mask = sse2NewlineMask(sse2Load(Ptr)))
+      return Ptr + llvm::countTrailingZeros(Mask);
+  return scalarFindNewline(Ptr, End);
+}
+
+static const char *sse2FindChar(const char *Ptr, const char *End, char C) {
+  __m128i Cs = _mm_set1_epi8(C);
+  for (; End - Ptr >= 16; Ptr += 16)
+    if (unsigned Mask = _mm_movemask_epi8(_mm_cmpeq_epi8(sse2Load(Ptr), Cs)))
+      return Ptr + llvm::countTrailingZeros(Mask);
+  return scalarFindChar(Ptr, End, C);
+}
+
+static const char *sse2SkipIdentifierBody(const char *Ptr, const char *End) {
+  for (; End - Ptr >= 16; Ptr += 16)
+    if (unsigned Mask = sse2NonIdentifierMask(sse2Load(Ptr)))
+      return Ptr + llvm::countTrailingZeros(Mask);
+  return scalarSkipIdentifierBody(Ptr, End);
+}
+
+static const char *sse2SkipHorizontalWhitespace(const char *Ptr,
+                                                const char *End) {
+  for (; End - Ptr >= 16; Ptr += 16)
+    if (unsigned Mask = sse2NonWhitespaceMask(sse2Load(Ptr)))
+      return Ptr + llvm::countTrailingZeros(Mask);
+  return scalarSkipHorizontalWhitespace(Ptr, End);
+}
+#endif
+
+//===----------------------------------------------------------------------===//
+// AVX2 kernels, 32 bytes at a time
+//===----------------------------------------------------------------------===//
+
+#ifdef CLANG_CHARSCAN_AVX2
+AVX2_TARGET static inline __m256i avx2InRange(__m256i V, char Lo, char N) {
+  return _mm256_cmpgt_epi8(_mm256_set1_epi8(BIASED(N)),
+                           _mm256_sub_epi8(V, _mm256_set1_epi8(BIASED(Lo))));
+}
+
+AVX2_TARGET static inline uint32_t avx2NewlineMask(__m256i V) {
+  return _mm256_movemask_epi8(
+      _mm256_or_si256(_mm256_cmpeq_epi8(V, _mm256_set1_epi8('\n')),
+                      _mm256_cmpeq_epi8(V, _mm256_set1_epi8('\r'))));
+}
+
+AVX2_TARGET static inline uint32_t avx2NonIdentifierMask(__m256i V) {
+  __m256i Lower = _mm256_or_si256(V, _mm256_set1_epi8(0x20));
+  __m256i Body = _mm256_or_si256(
+      _mm256_or_si256(avx2InRange(Lower, 'a', 26), avx2InRange(V, '0', 10)),
+      _mm256_cmpeq_epi8(V, _mm256_set1_epi8('_')));
+  return ~static_cast<uint32_t>(_mm256_movemask_epi8(Body));
+}
+
+AVX2_TARGET static inline uint32_t avx2NonWhitespaceMask(__m256i V) {
+  __m256i WS = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(V, _mm256_set1_epi8(' ')),
+                      _mm256_cmpeq_epi8(V, _mm256_set1_epi8('\t'))),
+      _mm256_or_si256(_mm256_cmpeq_epi8(V, _mm256_set1_epi8('\f')),
+                      _mm256_cmpeq_epi8(V, _mm256_set1_epi8('\v'))));
+  return ~static_cast<uint32_t>(_mm256_movemask_epi8(WS));
+}
+
+AVX2_TARGET static inline __m256i avx2Load(const char *Ptr) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(Ptr));
+}
+
+AVX2_TARGET static const char *avx2FindNewline(const char *Ptr,
+                                               const char *End) {
+  for (; End - Ptr >= 32; Ptr += 32)
+    if (uint32_t Mask = avx2NewlineMask(avx2Load(Ptr)))
+      return Ptr + llvm::countTrailingZeros(Mask);
+  return sse2FindNewline(Ptr, End);
+}
+
+AVX2_TARGET static const char *avx2FindChar(const char *Ptr, const char *End,
+                                            char C) {
+  __m256i Cs = _mm256_set1_epi8(C);
+  for (; End - Ptr >= 32; Ptr += 32)
+    if (uint32_t Mask =
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(avx2Load(Ptr), Cs)))
+      return Ptr + llvm::countTrailingZeros(Mask);
+  return sse2FindChar(Ptr, End, C);
+}
+
+AVX2_TARGET static const char *avx2SkipIdentifierBody(const char *Ptr,
+                                                      const char *End) {
+  for (; End - Ptr >= 32; Ptr += 32)
+    if (uint32_t Mask = avx2NonIdentifierMask(avx2Load(Ptr)))
+      return Ptr + llvm::countTrailingZeros(Mask);
+  return sse2SkipIdentifierBody(Ptr, End);
+}
+
+AVX2_TARGET static const char *avx2SkipHorizontalWhitespace(const char *Ptr,
+                                                            const char *End) {
+  for (; End - Ptr >= 32; Ptr += 32)
+    if (uint32_t Mask = avx2NonWhitespaceMask(avx2Load(Ptr)))
+      return Ptr + llvm::countTrailingZeros(Mask);
+  return sse2SkipHorizontalWhitespace(Ptr, End);
+}
+#endif
+
+//===----------------------------------------------------------------------===//
+// Dispatch
+//===----------------------------------------------------------------------===//
+
+ScanLevel clang::charscan::getHostScanLevel() {
+#ifdef CLANG_CHARSCAN_AVX2
+  if (__builtin_cpu_supports("avx2"))
+    return ScanLevel::AVX2;
+#endif
+#ifdef __SSE2__
+  return ScanLevel::SSE2;
+#else
+  return ScanLevel::Scalar;
+#endif
+}
+
+const ScanKernels &clang::charscan::getScanKernels(ScanLevel L) {
+  static const ScanKernels Scalar = {
+    scalarFindNewline, scalarFindChar, scalarSkipIdentifierBody,
+    scalarSkipHorizontalWhitespace
+  };
+#ifdef __SSE2__
+  static const ScanKernels SSE2 = {
+    sse2FindNewline, sse2FindChar, sse2SkipIdentifierBody,
+    sse2SkipHorizontalWhitespace
+  };
+#endif
+#ifdef CLANG_CHARSCAN_AVX2
+  static const ScanKernels AVX2 = {
+    avx2FindNewline, avx2FindChar, avx2SkipIdentifierBody,
+    avx2SkipHorizontalWhitespace
+  };
+#endif
+
+  assert(L <= getHostScanLevel() && "Scan level not supported by the host");
+  switch (L) {
+  case ScanLevel::Scalar:
+    return Scalar;
+  case ScanLevel::SSE2:
+#ifdef __SSE2__
+    return SSE2;
+#else
+    break;
+#endif
+  case ScanLevel::AVX2:
+#ifdef CLANG_CHARSCAN_AVX2
+    return AVX2;
+#else
+    break;
+#endif
+  }
+  llvm_unreachable("Scan level not supported by this build");
+}
+
+const ScanKernels &clang::charscan::getHostScanKernels() {
+  static const ScanKernels &Kernels = getScanKernels(getHostScanLevel());
+  return Kernels;
+}
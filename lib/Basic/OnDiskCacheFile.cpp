@@ -0,0 +1,68 @@
+//===--- OnDiskCacheFile.cpp - Files shared between compilations ----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the helpers for cache files shared between compiler
+// invocations.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Basic/OnDiskCacheFile.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include <cstring>
+
+using namespace clang;
+
+bool clang::writeFileAtomically(StringRef Path, StringRef Contents) {
+  SmallString<128> TmpPath;
+  int TmpFD;
+  if (llvm::sys::fs::createUniqueFile(Path + "-%%%%%%%%", TmpFD, TmpPath))
+    return true;
+  {
+    llvm::raw_fd_ostream Out(TmpFD, /*shouldClose=*/true);
+    Out << Contents;
+    Out.close();
+    if (Out.has_error()) {
+      Out.clear_error();
+      llvm::sys::fs::remove(TmpPath);
+      return true;
+    }
+  }
+  if (llvm::sys::fs::rename(TmpPath, Path)) {
+    llvm::sys::fs::remove(TmpPath);
+    return true;
+  }
+  return false;
+}
+
+uint32_t detail::getOnDiskCacheTableOffset(const llvm::MemoryBuffer &Buffer,
+                                           StringRef Magic, uint32_t Version) {
+  using namespace llvm::support;
+
+  const unsigned char *Base =
+      reinterpret_cast<const unsigned char *>(Buffer.getBufferStart());
+  size_t Size = Buffer.getBufferSize();
+  if (Size < OnDiskCacheHeaderSize ||
+      memcmp(Base, Magic.data(), Magic.size()) != 0)
+    return 0;
+  if (endian::read32le(Base + 4) != Version)
+    return 0;
+
+  // The table starts with the number of buckets and entries, followed by
+  // the buckets themselves. The number of buckets must be a power of two.
+  uint32_t TableOffset = endian::read32le(Base + 8);
+  if (TableOffset < OnDiskCacheHeaderSize || TableOffset % 4 != 0 ||
+      TableOffset + 8ULL > Size)
+    return 0;
+  uint32_t NumBuckets = endian::read32le(Base + TableOffset);
+  if (NumBuckets == 0 || (NumBuckets & (NumBuckets - 1)) != 0 ||
+      TableOffset + 8 + NumBuckets * 4ULL > Size)
+    return 0;
+  return TableOffset;
+}
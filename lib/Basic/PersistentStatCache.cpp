@@ -0,0 +1,209 @@
+//===--- PersistentStatCache.cpp - On-disk cache of 'stat' misses ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the PersistentStatCache class.
+//
+// The cache file holds an OnDiskCacheTable, with magic 'CSTC'. Each entry
+// maps a key, 'f' or 'd' (for file and directory lookups) followed by an
+// absolute path, to the modification time of the path's parent directory
+// when the lookup failed. All integers are little endian.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Basic/PersistentStatCache.h"
+#include "clang/Basic/VirtualFileSystem.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Path.h"
+
+using namespace clang;
+
+/// \brief The magic number at the start of the cache file.
+static const char CacheMagic[] = "CSTC";
+
+/// \brief The version of the cache file format.
+static const uint32_t CurrentVersion = 1;
+
+/// \brief Directories changed less than this many seconds ago are not
+/// trusted, since a file added within the same second as the last change
+/// might not change their modification time.
+static const time_t MinDirectoryAge = 2;
+
+/// \brief Trait used to read and write the misses in the cache file.
+class PersistentStatCache::StatMissTrait {
+public:
+  typedef StringRef key_type;
+  typedef StringRef key_type_ref;
+  typedef StringRef external_key_type;
+  typedef StringRef internal_key_type;
+  typedef uint64_t data_type;
+  typedef uint64_t data_type_ref;
+  typedef unsigned hash_value_type;
+  typedef unsigned offset_type;
+
+  static hash_value_type ComputeHash(StringRef Key) {
+    return llvm::HashString(Key);
+  }
+
+  static bool EqualKey(StringRef A, StringRef B) { return A == B; }
+
+  static StringRef GetInternalKey(StringRef Key) { return Key; }
+  static StringRef GetExternalKey(StringRef Key) { return Key; }
+
+  static std::pair<unsigned, unsigned>
+  EmitKeyDataLength(raw_ostream &Out, StringRef Key, uint64_t) {
+    using namespace llvm::support;
+    endian::Writer<little>(Out).write<uint16_t>(Key.size());
+    return std::make_pair(Key.size(), 8);
+  }
+
+  static void EmitKey(raw_ostream &Out, StringRef Key, unsigned) {
+    Out << Key;
+  }
+
+  static void EmitData(raw_ostream &Out, StringRef, uint64_t ModTime,
+                       unsigned) {
+    using namespace llvm::support;
+    endian::Writer<little>(Out).write<uint64_t>(ModTime);
+  }
+
+  static std::pair<unsigned, unsigned>
+  ReadKeyDataLength(const unsigned char *&D) {
+    using namespace llvm::support;
+    unsigned KeyLen = endian::readNext<uint16_t, little, unaligned>(D);
+    return std::make_pair(KeyLen, 8);
+  }
+
+  static StringRef ReadKey(const unsigned char *D, unsigned N) {
+    return StringRef(reinterpret_cast<const char *>(D), N);
+  }
+
+  static uint64_t ReadData(StringRef, const unsigned char *D, unsigned) {
+    using namespace llvm::support;
+    return endian::readNext<uint64_t, little, unaligned>(D);
+  }
+};
+
+std::unique_ptr<PersistentStatCache::Table>
+PersistentStatCache::loadTable(StringRef Path) {
+  return Table::load(Path, CacheMagic, CurrentVersion);
+}
+
+PersistentStatCache::PersistentStatCache(StringRef CachePath)
+    : CachePath(CachePath), HasStaleEntries(false), NumHits(0) {
+  Misses = loadTable(CachePath);
+}
+
+PersistentStatCache::~PersistentStatCache() { save(); }
+
+time_t PersistentStatCache::getDirectoryModTime(StringRef Dir,
+                                                vfs::FileSystem &FS) {
+  auto Known = DirModTimes.find(Dir);
+  if (Known != DirModTimes.end())
+    return Known->second;
+
+  time_t ModTime = 0;
+  llvm::ErrorOr<vfs::Status> Status = FS.status(Dir);
+  if (Status && Status->isDirectory()) {
+    ModTime = Status->getLastModificationTime().toEpochTime();
+    if (ModTime + MinDirectoryAge > time(nullptr))
+      ModTime = 0;
+  }
+  DirModTimes[Dir] = ModTime;
+  return ModTime;
+}
+
+bool PersistentStatCache::mayHaveEntry(StringRef Dir, StringRef Name,
+                                       vfs::FileSystem &FS) {
+  auto Known = DirEntries.find(Dir);
+  if (Known == DirEntries.end()) {
+    auto Names = llvm::make_unique<llvm::StringSet<>>();
+    std::error_code EC;
+    for (vfs::directory_iterator I = FS.dir_begin(Dir, EC), E;
+         !EC && I != E; I.increment(EC))
+      Names->insert(llvm::sys::path::filename(I->getName()));
+    if (EC)
+      Names.reset();
+    Known = DirEntries.insert(std::make_pair(Dir, std::move(Names))).first;
+  }
+  return !Known->second || Known->second->count(Name);
+}
+
+PersistentStatCache::LookupResult
+PersistentStatCache::getStat(const char *Path, FileData &Data, bool isFile,
+                             std::unique_ptr<vfs::File> *F,
+                             vfs::FileSystem &FS) {
+  // Relative paths mean something else in each invocation.
+  if (!llvm::sys::path::is_absolute(Path))
+    return statChained(Path, Data, isFile, F, FS);
+
+  SmallString<256> Key;
+  Key += isFile ? 'f' : 'd';
+  Key += Path;
+  if (Key.size() > UINT16_MAX)
+    return statChained(Path, Data, isFile, F, FS);
+  StringRef Dir = llvm::sys::path::parent_path(Path);
+
+  if (Misses) {
+    Table::iterator I = Misses->find(Key);
+    if (I != Misses->end()) {
+      time_t ModTime = getDirectoryModTime(Dir, FS);
+      if (ModTime != 0 && (uint64_t)ModTime == *I) {
+        ++NumHits;
+        return CacheMissing;
+      }
+      HasStaleEntries = true;
+    }
+  }
+
+  // A name that the directory has but that cannot be found, such as a
+  // dangling symbolic link, can start working without the directory
+  // changing, so only cache the misses of names that are not there at all.
+  LookupResult Result = statChained(Path, Data, isFile, F, FS);
+  if (Result == CacheMissing)
+    if (time_t ModTime = getDirectoryModTime(Dir, FS))
+      if (!mayHaveEntry(Dir, llvm::sys::path::filename(Path), FS))
+        NewMisses[Key] = ModTime;
+  return Result;
+}
+
+bool PersistentStatCache::save() {
+  if (NewMisses.empty() && !HasStaleEntries)
+    return false;
+
+  // Merge with the current contents of the cache file, rather than with the
+  // ones this cache was opened with, so that the misses written by other
+  // invocations in the meantime are kept. Drop the entries of directories
+  // that have changed since their misses were recorded.
+  llvm::StringMap<time_t> Merged;
+  if (std::unique_ptr<Table> Current = loadTable(CachePath)) {
+    Table::key_iterator K = Current->key_begin();
+    for (Table::data_iterator D = Current->data_begin(),
+                              DEnd = Current->data_end();
+         D != DEnd; ++D, ++K) {
+      StringRef Dir = llvm::sys::path::parent_path((*K).substr(1));
+      auto Known = DirModTimes.find(Dir);
+      if (Known != DirModTimes.end() && (uint64_t)Known->second != *D)
+        continue;
+      Merged[*K] = *D;
+    }
+  }
+  for (const auto &Miss : NewMisses)
+    Merged[Miss.getKey()] = Miss.getValue();
+  NewMisses.clear();
+  HasStaleEntries = false;
+
+  llvm::OnDiskChainedHashTableGenerator<StatMissTrait> Generator;
+  StatMissTrait Trait;
+  for (const auto &Miss : Merged)
+    Generator.insert(Miss.getKey(), Miss.getValue(), Trait);
+
+  return Table::save(CachePath, CacheMagic, CurrentVersion, Generator, Trait);
+}
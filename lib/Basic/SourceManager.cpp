@@ -12,6 +12,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "clang/Basic/SourceManager.h"
+#include "clang/Basic/CharScan.h"
 #include "clang/Basic/Diagnostic.h"
 #include "clang/Basic/FileManager.h"
 #include "clang/Basic/SourceManagerInternals.h"
@@ -405,6 +406,7 @@ void SourceManager::clearIDTables() {
   // Use up FileID #0 as an invalid expansion.
   NextLocalOffset = 0;
   CurrentLoadedOffset = MaxLoadedOffset;
+  SLocSpaceExhausted = false;
   createExpansionLoc(SourceLocation(),SourceLocation(),SourceLocation(), 1);
 }
 
@@ -569,13 +571,15 @@ FileID SourceManager::createFileID(const ContentCache *File,
     SLocEntryLoaded[Index] = true;
     return FileID::get(LoadedID);
   }
+  unsigned FileSize = File->getSize();
+  if (!(NextLocalOffset + FileSize + 1 > NextLocalOffset &&
+        NextLocalOffset + FileSize + 1 <= CurrentLoadedOffset)) {
+    reportSLocSpaceExhausted(IncludePos);
+    return FileID();
+  }
   LocalSLocEntryTable.push_back(SLocEntry::get(NextLocalOffset,
                                                FileInfo::get(IncludePos, File,
                                                              FileCharacter)));
-  unsigned FileSize = File->getSize();
-  assert(NextLocalOffset + FileSize + 1 > NextLocalOffset &&
-         NextLocalOffset + FileSize + 1 <= CurrentLoadedOffset &&
-         "Ran out of source locations!");
   // We do a +1 here because we want a SourceLocation that means "the end of the
   // file", e.g. for the "no newline at the end of the file" diagnostic.
   NextLocalOffset += FileSize + 1;
@@ -621,15 +625,47 @@ SourceManager::createExpansionLocImpl(const ExpansionInfo &Info,
     SLocEntryLoaded[Index] = true;
     return SourceLocation::getMacroLoc(LoadedOffset);
   }
+  if (!(NextLocalOffset + TokLength + 1 > NextLocalOffset &&
+        NextLocalOffset + TokLength + 1 <= CurrentLoadedOffset)) {
+    reportSLocSpaceExhausted(Info.getExpansionLocStart());
+    return SourceLocation();
+  }
   LocalSLocEntryTable.push_back(SLocEntry::get(NextLocalOffset, Info));
-  assert(NextLocalOffset + TokLength + 1 > NextLocalOffset &&
-         NextLocalOffset + TokLength + 1 <= CurrentLoadedOffset &&
-         "Ran out of source locations!");
   // See createFileID for that +1.
   NextLocalOffset += TokLength + 1;
   return SourceLocation::getMacroLoc(NextLocalOffset - (TokLength + 1));
 }
 
+void SourceManager::reportSLocSpaceExhausted(SourceLocation Loc) {
+  // The error is fatal, so there is no point in repeating it for each of the
+  // files and expansions that come after.
+  if (SLocSpaceExhausted)
+    return;
+  SLocSpaceExhausted = true;
+
+  // Work out how much of the address space went to files and how much to
+  // macro expansions, since the fix is different for each.
+  uint64_t FileBytes = 0, ExpansionBytes = 0;
+  unsigned NumFiles = 0, NumExpansions = 0;
+  for (unsigned I = 0, N = LocalSLocEntryTable.size(); I != N; ++I) {
+    const SrcMgr::SLocEntry &Entry = LocalSLocEntryTable[I];
+    unsigned End = I + 1 == N ? NextLocalOffset
+                              : LocalSLocEntryTable[I + 1].getOffset();
+    if (Entry.isExpansion()) {
+      ExpansionBytes += End - Entry.getOffset();
+      ++NumExpansions;
+    } else {
+      FileBytes += End - Entry.getOffset();
+      ++NumFiles;
+    }
+  }
+
+  Diag.Report(Loc, diag::err_sloc_space_too_large);
+  Diag.Report(diag::note_sloc_space_usage)
+      << std::to_string(FileBytes) << NumFiles
+      << std::to_string(ExpansionBytes) << NumExpansions;
+}
+
 llvm::MemoryBuffer *SourceManager::getMemoryBufferForFile(const FileEntry *File,
                                                           bool *Invalid) {
   const SrcMgr::ContentCache *IR = getOrCreateContentCache(File);
@@ -1140,13 +1176,12 @@ unsigned SourceManager::getColumnNumber(FileID FID, unsigned FilePos,
 
   // See if we just calculated the line number for this FilePos and can use
   // that to lookup the start of the line instead of searching for it.
-  if (LastLineNoFileIDQuery == FID &&
-      LastLineNoContentCache->SourceLineCache != nullptr &&
-      LastLineNoResult < LastLineNoContentCache->NumLines) {
-    unsigned *SourceLineCache = LastLineNoContentCache->SourceLineCache;
-    unsigned LineStart = SourceLineCache[LastLineNoResult - 1];
-    unsigned LineEnd = SourceLineCache[LastLineNoResult];
-    if (FilePos >= LineStart && FilePos < LineEnd)
+  if (LastLineNoFileIDQuery == FID) {
+    const LineOffsetCache &Lines = LastLineNoContentCache->SourceLineCache;
+    unsigned LineStart, LineEnd;
+    if (Lines.getScannedLineOffset(LastLineNoResult, LineStart) &&
+        Lines.getScannedLineOffset(LastLineNoResult + 1, LineEnd) &&
+        FilePos >= LineStart && FilePos < LineEnd)
       return FilePos - LineStart + 1;
   }
 
@@ -1188,103 +1223,101 @@ unsigned SourceManager::getPresumedColumnNumber(SourceLocation Loc,
   return PLoc.getColumn();
 }
 
-#ifdef __SSE2__
-#include <emmintrin.h>
-#endif
-
-static LLVM_ATTRIBUTE_NOINLINE void
-ComputeLineNumbers(DiagnosticsEngine &Diag, ContentCache *FI,
-                   llvm::BumpPtrAllocator &Alloc,
-                   const SourceManager &SM, bool &Invalid);
-static void ComputeLineNumbers(DiagnosticsEngine &Diag, ContentCache *FI,
-                               llvm::BumpPtrAllocator &Alloc,
-                               const SourceManager &SM, bool &Invalid) {
-  // Note that calling 'getBuffer()' may lazily page in the file.
-  MemoryBuffer *Buffer = FI->getBuffer(Diag, SM, SourceLocation(), &Invalid);
-  if (Invalid)
-    return;
+void LineOffsetCache::scanChunk(StringRef Buffer,
+                                llvm::BumpPtrAllocator &Alloc) {
+  assert(!Complete && "Scanning past the end of the buffer");
 
-  // Find the file offsets of all of the *physical* source lines.  This does
-  // not look at trigraphs, escaped newlines, or anything else tricky.
+  // Find the file offsets of the *physical* source lines that start in this
+  // chunk.  This does not look at trigraphs, escaped newlines, or anything
+  // else tricky.
   SmallVector<unsigned, 256> LineOffsets;
 
   // Line #1 starts at char 0.
-  LineOffsets.push_back(0);
+  if (ScannedEnd == 0)
+    LineOffsets.push_back(0);
 
-  const unsigned char *Buf = (const unsigned char *)Buffer->getBufferStart();
-  const unsigned char *End = (const unsigned char *)Buffer->getBufferEnd();
-  unsigned Offs = 0;
+  const char *Start = Buffer.data();
+  const char *BufEnd = Buffer.end();
+  const char *Buf = Start + ScannedEnd;
+  const char *End = BufEnd - Buf > ChunkSize ? Buf + ChunkSize : BufEnd;
   while (1) {
-    // Skip over the contents of the line.
-    const unsigned char *NextBuf = (const unsigned char *)Buf;
-
-#ifdef __SSE2__
-    // Try to skip to the next newline using SSE instructions. This is very
-    // performance sensitive for programs with lots of diagnostics and in -E
-    // mode.
-    __m128i CRs = _mm_set1_epi8('\r');
-    __m128i LFs = _mm_set1_epi8('\n');
-
-    // First fix up the alignment to 16 bytes.
-    while (((uintptr_t)NextBuf & 0xF) != 0) {
-      if (*NextBuf == '\n' || *NextBuf == '\r' || *NextBuf == '\0')
-        goto FoundSpecialChar;
-      ++NextBuf;
-    }
-
-    // Scan 16 byte chunks for '\r' and '\n'. Ignore '\0'.
-    while (NextBuf+16 <= End) {
-      const __m128i Chunk = *(const __m128i*)NextBuf;
-      __m128i Cmp = _mm_or_si128(_mm_cmpeq_epi8(Chunk, CRs),
-                                 _mm_cmpeq_epi8(Chunk, LFs));
-      unsigned Mask = _mm_movemask_epi8(Cmp);
-
-      // If we found a newline, adjust the pointer and jump to the handling code.
-      if (Mask != 0) {
-        NextBuf += llvm::countTrailingZeros(Mask);
-        goto FoundSpecialChar;
-      }
-      NextBuf += 16;
-    }
-#endif
-
-    while (*NextBuf != '\n' && *NextBuf != '\r' && *NextBuf != '\0')
-      ++NextBuf;
-
-#ifdef __SSE2__
-FoundSpecialChar:
-#endif
-    Offs += NextBuf-Buf;
-    Buf = NextBuf;
-
-    if (Buf[0] == '\n' || Buf[0] == '\r') {
-      // If this is \n\r or \r\n, skip both characters.
-      if ((Buf[1] == '\n' || Buf[1] == '\r') && Buf[0] != Buf[1]) {
-        ++Offs;
-        ++Buf;
-      }
-      ++Offs;
-      ++Buf;
-      LineOffsets.push_back(Offs);
-    } else {
-      // Otherwise, this is a null.  If end of file, exit.
-      if (Buf == End) break;
-      // Otherwise, skip the null.
-      ++Offs;
+    // Skip over the contents of the line. This is very performance sensitive
+    // for programs with lots of diagnostics and in -E mode, so use the
+    // vectorized scan. Embedded nulls are part of the line.
+    Buf = charscan::findNewline(Buf, End);
+
+    // If end of chunk, exit.
+    if (Buf == End) break;
+
+    // If this is \n\r or \r\n, skip both characters, even if the second one
+    // is in the next chunk.
+    if (Buf + 1 != BufEnd && (Buf[1] == '\n' || Buf[1] == '\r') &&
+        Buf[0] != Buf[1])
       ++Buf;
-    }
+    ++Buf;
+    LineOffsets.push_back(Buf - Start);
+    if (Buf > End)
+      End = Buf;
   }
 
-  // Copy the offsets into the FileInfo structure.
-  FI->NumLines = LineOffsets.size();
-  FI->SourceLineCache = Alloc.Allocate<unsigned>(LineOffsets.size());
-  std::copy(LineOffsets.begin(), LineOffsets.end(), FI->SourceLineCache);
+  ScannedEnd = End - Start;
+  Complete = End == BufEnd;
+  if (LineOffsets.empty())
+    return;
+
+  unsigned *Offsets = Alloc.Allocate<unsigned>(LineOffsets.size());
+  std::copy(LineOffsets.begin(), LineOffsets.end(), Offsets);
+  Chunk C = { NumLines, static_cast<unsigned>(LineOffsets.size()), Offsets };
+  Chunks.push_back(C);
+  NumLines += LineOffsets.size();
+}
+
+unsigned LineOffsetCache::getLineNumber(StringRef Buffer, unsigned Offset,
+                                        llvm::BumpPtrAllocator &Alloc) {
+  // Every line that starts at or before Offset has been found once the buffer
+  // has been scanned past it.
+  while (!Complete && ScannedEnd <= Offset)
+    scanChunk(Buffer, Alloc);
+
+  // Find the last chunk with a line that starts at or before Offset, then
+  // count the lines that start at or before Offset. The first chunk always
+  // starts with line #1 at offset 0.
+  std::vector<Chunk>::const_iterator C = std::upper_bound(
+      Chunks.begin(), Chunks.end(), Offset,
+      [](unsigned Offset, const Chunk &C) { return Offset < C.Offsets[0]; });
+  assert(C != Chunks.begin() && "No chunk contains the first line");
+  --C;
+  const unsigned *Pos =
+      std::upper_bound(C->Offsets, C->Offsets + C->NumLines, Offset);
+  return C->FirstLine + (Pos - C->Offsets);
+}
+
+bool LineOffsetCache::getLineOffset(StringRef Buffer, unsigned Line,
+                                    unsigned &Offset,
+                                    llvm::BumpPtrAllocator &Alloc) {
+  while (!Complete && NumLines < Line)
+    scanChunk(Buffer, Alloc);
+  return getScannedLineOffset(Line, Offset);
+}
+
+bool LineOffsetCache::getScannedLineOffset(unsigned Line,
+                                           unsigned &Offset) const {
+  if (Line == 0 || Line > NumLines)
+    return false;
+
+  unsigned Index = Line - 1;
+  std::vector<Chunk>::const_iterator C = std::upper_bound(
+      Chunks.begin(), Chunks.end(), Index,
+      [](unsigned Index, const Chunk &C) { return Index < C.FirstLine; });
+  --C;
+  Offset = C->Offsets[Index - C->FirstLine];
+  return true;
 }
 
 /// getLineNumber - Given a SourceLocation, return the spelling line number
 /// for the position indicated.  This requires building and caching a table of
-/// line offsets for the MemoryBuffer, so this is not cheap: use only when
-/// about to emit a diagnostic.
+/// line offsets for the MemoryBuffer up to that position, so this is not
+/// cheap: use only when about to emit a diagnostic.
 unsigned SourceManager::getLineNumber(FileID FID, unsigned FilePos, 
                                       bool *Invalid) const {
   if (FID.isInvalid()) {
@@ -1294,9 +1327,21 @@ unsigned SourceManager::getLineNumber(FileID FID, unsigned FilePos,
   }
 
   ContentCache *Content;
-  if (LastLineNoFileIDQuery == FID)
+  if (LastLineNoFileIDQuery == FID) {
     Content = LastLineNoContentCache;
-  else {
+
+    // The query is likely to be on the same line as the previous one.
+    unsigned LineStart, LineEnd;
+    if (Content->SourceLineCache.getScannedLineOffset(LastLineNoResult,
+                                                      LineStart) &&
+        Content->SourceLineCache.getScannedLineOffset(LastLineNoResult + 1,
+                                                      LineEnd) &&
+        FilePos >= LineStart && FilePos < LineEnd) {
+      if (Invalid)
+        *Invalid = false;
+      return LastLineNoResult;
+    }
+  } else {
     bool MyInvalid = false;
     const SLocEntry &Entry = getSLocEntry(FID, &MyInvalid);
     if (MyInvalid || !Entry.isFile()) {
@@ -1308,73 +1353,20 @@ unsigned SourceManager::getLineNumber(FileID FID, unsigned FilePos,
     Content = const_cast<ContentCache*>(Entry.getFile().getContentCache());
   }
   
-  // If this is the first use of line information for this buffer, compute the
-  /// SourceLineCache for it on demand.
-  if (!Content->SourceLineCache) {
-    bool MyInvalid = false;
-    ComputeLineNumbers(Diag, Content, ContentCacheAlloc, *this, MyInvalid);
-    if (Invalid)
-      *Invalid = MyInvalid;
-    if (MyInvalid)
-      return 1;
-  } else if (Invalid)
-    *Invalid = false;
-
-  // Okay, we know we have a line number table.  Do a binary search to find the
-  // line number that this character position lands on.
-  unsigned *SourceLineCache = Content->SourceLineCache;
-  unsigned *SourceLineCacheStart = SourceLineCache;
-  unsigned *SourceLineCacheEnd = SourceLineCache + Content->NumLines;
-
-  unsigned QueriedFilePos = FilePos+1;
-
-  // FIXME: I would like to be convinced that this code is worth being as
-  // complicated as it is, binary search isn't that slow.
-  //
-  // If it is worth being optimized, then in my opinion it could be more
-  // performant, simpler, and more obviously correct by just "galloping" outward
-  // from the queried file position. In fact, this could be incorporated into a
-  // generic algorithm such as lower_bound_with_hint.
-  //
-  // If someone gives me a test case where this matters, and I will do it! - DWD
-
-  // If the previous query was to the same file, we know both the file pos from
-  // that query and the line number returned.  This allows us to narrow the
-  // search space from the entire file to something near the match.
-  if (LastLineNoFileIDQuery == FID) {
-    if (QueriedFilePos >= LastLineNoFilePos) {
-      // FIXME: Potential overflow?
-      SourceLineCache = SourceLineCache+LastLineNoResult-1;
-
-      // The query is likely to be nearby the previous one.  Here we check to
-      // see if it is within 5, 10 or 20 lines.  It can be far away in cases
-      // where big comment blocks and vertical whitespace eat up lines but
-      // contribute no tokens.
-      if (SourceLineCache+5 < SourceLineCacheEnd) {
-        if (SourceLineCache[5] > QueriedFilePos)
-          SourceLineCacheEnd = SourceLineCache+5;
-        else if (SourceLineCache+10 < SourceLineCacheEnd) {
-          if (SourceLineCache[10] > QueriedFilePos)
-            SourceLineCacheEnd = SourceLineCache+10;
-          else if (SourceLineCache+20 < SourceLineCacheEnd) {
-            if (SourceLineCache[20] > QueriedFilePos)
-              SourceLineCacheEnd = SourceLineCache+20;
-          }
-        }
-      }
-    } else {
-      if (LastLineNoResult < Content->NumLines)
-        SourceLineCacheEnd = SourceLineCache+LastLineNoResult+1;
-    }
-  }
+  // Note that calling 'getBuffer()' may lazily page in the file.
+  bool MyInvalid = false;
+  llvm::MemoryBuffer *Buffer =
+      Content->getBuffer(Diag, *this, SourceLocation(), &MyInvalid);
+  if (Invalid)
+    *Invalid = MyInvalid;
+  if (MyInvalid)
+    return 1;
 
-  unsigned *Pos
-    = std::lower_bound(SourceLineCache, SourceLineCacheEnd, QueriedFilePos);
-  unsigned LineNo = Pos-SourceLineCacheStart;
+  unsigned LineNo = Content->SourceLineCache.getLineNumber(
+      Buffer->getBuffer(), FilePos, ContentCacheAlloc);
 
   LastLineNoFileIDQuery = FID;
   LastLineNoContentCache = Content;
-  LastLineNoFilePos = QueriedFilePos;
   LastLineNoResult = LineNo;
   return LineNo;
 }
@@ -1746,24 +1738,21 @@ SourceLocation SourceManager::translateLineCol(FileID FID,
   if (!Content)
     return SourceLocation();
 
-  // If this is the first use of line information for this buffer, compute the
-  // SourceLineCache for it on demand.
-  if (!Content->SourceLineCache) {
-    bool MyInvalid = false;
-    ComputeLineNumbers(Diag, Content, ContentCacheAlloc, *this, MyInvalid);
-    if (MyInvalid)
-      return SourceLocation();
-  }
+  bool MyInvalid = false;
+  llvm::MemoryBuffer *Buffer =
+      Content->getBuffer(Diag, *this, SourceLocation(), &MyInvalid);
+  if (MyInvalid)
+    return SourceLocation();
 
-  if (Line > Content->NumLines) {
-    unsigned Size = Content->getBuffer(Diag, *this)->getBufferSize();
+  unsigned FilePos;
+  if (!Content->SourceLineCache.getLineOffset(Buffer->getBuffer(), Line,
+                                              FilePos, ContentCacheAlloc)) {
+    unsigned Size = Buffer->getBufferSize();
     if (Size > 0)
       --Size;
     return FileLoc.getLocWithOffset(Size);
   }
 
-  llvm::MemoryBuffer *Buffer = Content->getBuffer(Diag, *this);
-  unsigned FilePos = Content->SourceLineCache[Line - 1];
   const char *Buf = Buffer->getBufferStart() + FilePos;
   unsigned BufLength = Buffer->getBufferSize() - FilePos;
   if (BufLength == 0)
@@ -2143,7 +2132,7 @@ void SourceManager::PrintStats() const {
   unsigned NumLineNumsComputed = 0;
   unsigned NumFileBytesMapped = 0;
   for (fileinfo_iterator I = fileinfo_begin(), E = fileinfo_end(); I != E; ++I){
-    NumLineNumsComputed += I->second->SourceLineCache != nullptr;
+    NumLineNumsComputed += I->second->SourceLineCache.isComputed();
     NumFileBytesMapped  += I->second->getSizeBytesMapped();
   }
   unsigned NumMacroArgsComputed = MacroArgsCacheMap.size();
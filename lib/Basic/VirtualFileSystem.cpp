@@ -473,6 +473,7 @@ public:
     return Entries.insert(make_pair(Name, std::move(Child)))
         .first->second.get();
   }
+  void removeChild(StringRef Name) { Entries.erase(Name); }
 
   typedef decltype(Entries)::const_iterator const_iterator;
   const_iterator begin() const { return Entries.begin(); }
@@ -615,6 +616,29 @@ lookupInMemoryNode(const InMemoryFileSystem &FS, detail::InMemoryDirectory *Dir,
   }
 }
 
+bool InMemoryFileSystem::removeFile(const Twine &P) {
+  SmallString<128> Path;
+  P.toVector(Path);
+
+  // Fix up relative paths. This just prepends the current working directory.
+  std::error_code EC = makeAbsolute(Path);
+  assert(!EC);
+  (void)EC;
+
+  if (useNormalizedPaths())
+    llvm::sys::path::remove_dots(Path, /*remove_dot_dot=*/true);
+
+  auto Node = lookupInMemoryNode(*this, Root.get(), Path);
+  if (!Node || !isa<detail::InMemoryFile>(*Node))
+    return false;
+
+  auto Dir = lookupInMemoryNode(*this, Root.get(),
+                                llvm::sys::path::parent_path(Path));
+  cast<detail::InMemoryDirectory>(*Dir)->removeChild(
+      llvm::sys::path::filename(Path));
+  return true;
+}
+
 llvm::ErrorOr<Status> InMemoryFileSystem::status(const Twine &Path) {
   auto Node = lookupInMemoryNode(*this, Root.get(), Path);
   if (Node)
@@ -4798,6 +4798,9 @@ void Clang::ConstructJob(Compilation &C, const JobAction &JA,
   CmdArgs.push_back(D.ResourceDir.c_str());
 
   Args.AddLastArg(CmdArgs, options::OPT_working_directory);
+  Args.AddLastArg(CmdArgs, options::OPT_fstat_cache_path);
+  Args.AddLastArg(CmdArgs, options::OPT_fheader_search_listings);
+  Args.AddLastArg(CmdArgs, options::OPT_finclude_guard_cache_path);
 
   bool ARCMTEnabled = false;
   if (!Args.hasArg(options::OPT_fno_objc_arc, options::OPT_fobjc_arc)) {
@@ -5541,6 +5544,9 @@ void Clang::ConstructJob(Compilation &C, const JobAction &JA,
   }
 
   Args.AddLastArg(CmdArgs, options::OPT_fmodules_validate_system_headers);
+  Args.AddLastArg(CmdArgs, options::OPT_fvalidate_ast_input_files_content);
+  Args.AddLastArg(CmdArgs, options::OPT_fcompress_ast_files);
+  Args.AddLastArg(CmdArgs, options::OPT_fmodules_share_file_contents);
   Args.AddLastArg(CmdArgs, options::OPT_fmodules_disable_diagnostic_validation);
 
   // -faccess-control is default.
@@ -34,6 +34,7 @@
 #include "clang/Serialization/ASTReader.h"
 #include "clang/Serialization/ASTWriter.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/Support/CrashRecoveryContext.h"
@@ -80,8 +81,9 @@ namespace {
   };
   
   struct OnDiskData {
-    /// \brief The file in which the precompiled preamble is stored.
-    std::string PreambleFile;
+    /// \brief The files in which the layers of the precompiled preamble are
+    /// stored, from the bottom up.
+    std::vector<std::string> PreambleFiles;
 
     /// \brief Temporary files that should be removed when the ASTUnit is
     /// destroyed.
@@ -90,10 +92,10 @@ namespace {
     /// \brief Erase temporary files.
     void CleanTemporaryFiles();
 
-    /// \brief Erase the preamble file.
-    void CleanPreambleFile();
+    /// \brief Erase the files of the preamble layers from \p FirstLayer up.
+    void CleanPreambleFiles(unsigned FirstLayer = 0);
 
-    /// \brief Erase temporary files and the preamble file.
+    /// \brief Erase temporary files and the preamble files.
     void Cleanup();
   };
 }
@@ -138,8 +140,8 @@ static OnDiskData &getOnDiskData(const ASTUnit *AU) {
   return *D;
 }
 
-static void erasePreambleFile(const ASTUnit *AU) {
-  getOnDiskData(AU).CleanPreambleFile();
+static void erasePreambleFiles(const ASTUnit *AU, unsigned FirstLayer = 0) {
+  getOnDiskData(AU).CleanPreambleFiles(FirstLayer);
 }
 
 static void removeOnDiskEntry(const ASTUnit *AU) {
@@ -154,12 +156,8 @@ static void removeOnDiskEntry(const ASTUnit *AU) {
   }
 }
 
-static void setPreambleFile(const ASTUnit *AU, StringRef preambleFile) {
-  getOnDiskData(AU).PreambleFile = preambleFile;
-}
-
-static const std::string &getPreambleFile(const ASTUnit *AU) {
-  return getOnDiskData(AU).PreambleFile;  
+static void addPreambleFile(const ASTUnit *AU, StringRef preambleFile) {
+  getOnDiskData(AU).PreambleFiles.push_back(preambleFile);
 }
 
 void OnDiskData::CleanTemporaryFiles() {
@@ -168,16 +166,16 @@ void OnDiskData::CleanTemporaryFiles() {
   TemporaryFiles.clear();
 }
 
-void OnDiskData::CleanPreambleFile() {
-  if (!PreambleFile.empty()) {
-    llvm::sys::fs::remove(PreambleFile);
-    PreambleFile.clear();
-  }
+void OnDiskData::CleanPreambleFiles(unsigned FirstLayer) {
+  for (unsigned I = FirstLayer, N = PreambleFiles.size(); I < N; ++I)
+    llvm::sys::fs::remove(PreambleFiles[I]);
+  if (FirstLayer < PreambleFiles.size())
+    PreambleFiles.resize(FirstLayer);
 }
 
 void OnDiskData::Cleanup() {
   CleanTemporaryFiles();
-  CleanPreambleFile();
+  CleanPreambleFiles();
 }
 
 struct ASTUnit::ASTWriterData {
@@ -222,6 +220,7 @@ ASTUnit::ASTUnit(bool _MainFileIsAST)
     NumWarningsInPreamble(0),
     ShouldCacheCodeCompletionResults(false),
     IncludeBriefCommentsInCodeCompletion(false), UserFilesAreVolatile(false),
+    ChainedPreamble(false),
     CompletionCacheTopLevelHashValue(0),
     PreambleTopLevelHashValue(0),
     CurrentTopLevelHashValue(0),
@@ -898,15 +897,29 @@ public:
 class PrecompilePreambleAction : public ASTFrontendAction {
   ASTUnit &Unit;
   bool HasEmittedPreamblePCH;
+  bool StoreInMemory;
+  std::string OutputFile;
+  std::unique_ptr<llvm::MemoryBuffer> InMemoryPCH;
 
 public:
-  explicit PrecompilePreambleAction(ASTUnit &Unit)
-      : Unit(Unit), HasEmittedPreamblePCH(false) {}
+  PrecompilePreambleAction(ASTUnit &Unit, bool StoreInMemory)
+      : Unit(Unit), HasEmittedPreamblePCH(false),
+        StoreInMemory(StoreInMemory) {}
 
   std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &CI,
                                                  StringRef InFile) override;
   bool hasEmittedPreamblePCH() const { return HasEmittedPreamblePCH; }
   void setHasEmittedPreamblePCH() { HasEmittedPreamblePCH = true; }
+
+  /// \brief Keep the precompiled preamble in memory, rather than in the
+  /// output file.
+  void setInMemoryPCH(ArrayRef<char> PCH) {
+    InMemoryPCH = llvm::MemoryBuffer::getMemBufferCopy(
+        StringRef(PCH.data(), PCH.size()), OutputFile);
+  }
+  std::unique_ptr<llvm::MemoryBuffer> takeInMemoryPCH() {
+    return std::move(InMemoryPCH);
+  }
   bool shouldEraseOutputFiles() override { return !hasEmittedPreamblePCH(); }
 
   bool hasCodeCompletionSupport() const override { return false; }
@@ -950,10 +963,14 @@ public:
   void HandleTranslationUnit(ASTContext &Ctx) override {
     PCHGenerator::HandleTranslationUnit(Ctx);
     if (hasEmittedPCH()) {
-      // Write the generated bitstream to "Out".
-      *Out << getPCH();
-      // Make sure it hits disk now.
-      Out->flush();
+      if (Out) {
+        // Write the generated bitstream to "Out".
+        *Out << getPCH();
+        // Make sure it hits disk now.
+        Out->flush();
+      } else {
+        Action->setInMemoryPCH(getPCH());
+      }
       // Free the buffer.
       llvm::SmallVector<char, 0> Empty;
       getPCH() = std::move(Empty);
@@ -980,12 +997,18 @@ std::unique_ptr<ASTConsumer>
 PrecompilePreambleAction::CreateASTConsumer(CompilerInstance &CI,
                                             StringRef InFile) {
   std::string Sysroot;
-  std::string OutputFile;
-  std::unique_ptr<raw_ostream> OS =
-      GeneratePCHAction::ComputeASTConsumerArguments(CI, InFile, Sysroot,
-                                                     OutputFile);
-  if (!OS)
-    return nullptr;
+  std::unique_ptr<raw_ostream> OS;
+  if (StoreInMemory) {
+    // The consumer hands the precompiled header back to us instead of
+    // writing it out.
+    Sysroot = CI.getHeaderSearchOpts().Sysroot;
+    OutputFile = CI.getFrontendOpts().OutputFile;
+  } else {
+    OS = GeneratePCHAction::ComputeASTConsumerArguments(CI, InFile, Sysroot,
+                                                        OutputFile);
+    if (!OS)
+      return nullptr;
+  }
 
   if (!CI.getFrontendOpts().RelocatablePCH)
     Sysroot.clear();
@@ -1079,6 +1102,9 @@ bool ASTUnit::Parse(std::shared_ptr<PCHContainerOperations> PCHContainerOps,
   LangOpts = Clang->getInvocation().LangOpts;
   FileSystemOpts = Clang->getFileSystemOpts();
   if (!FileMgr) {
+    if (PreambleFS)
+      Clang->setVirtualFileSystem(
+          overlayPreambleFS(vfs::getRealFileSystem()));
     Clang->createFileManager();
     FileMgr = &Clang->getFileManager();
   }
@@ -1088,6 +1114,13 @@ bool ASTUnit::Parse(std::shared_ptr<PCHContainerOperations> PCHContainerOps,
   Ctx = nullptr;
   PP = nullptr;
   Reader = nullptr;
+  PreambleLayerFileIDs.clear();
+
+  // Now that the previous AST is gone, release the preamble layers it may
+  // have used that were thrown away since.
+  for (const std::string &File : DiscardedPreambleFiles)
+    PreambleFS->removeFile(File);
+  DiscardedPreambleFiles.clear();
 
   // Clear out old caches and data.
   TopLevelDecls.clear();
@@ -1114,7 +1147,7 @@ bool ASTUnit::Parse(std::shared_ptr<PCHContainerOperations> PCHContainerOps,
     PreprocessorOpts.PrecompiledPreambleBytes.first = Preamble.size();
     PreprocessorOpts.PrecompiledPreambleBytes.second
                                                     = PreambleEndsAtStartOfLine;
-    PreprocessorOpts.ImplicitPCHInclude = getPreambleFile(this);
+    PreprocessorOpts.ImplicitPCHInclude = getPreambleFile();
     PreprocessorOpts.DisablePCHValidation = true;
     
     // The stored diagnostic has the old source manager in it; update
@@ -1166,17 +1199,31 @@ error:
   return true;
 }
 
-/// \brief Simple function to retrieve a path for a preamble precompiled header.
-static std::string GetPreamblePCHPath() {
+/// \brief Simple function to retrieve a path for the precompiled header of
+/// the given preamble layer. Unless \p InMemory is set, the file is created.
+static std::string GetPreamblePCHPath(unsigned Layer, bool InMemory) {
   // FIXME: This is a hack so that we can override the preamble file during
   // crash-recovery testing, which is the only case where the preamble files
   // are not necessarily cleaned up.
   const char *TmpFile = ::getenv("CINDEXTEST_PREAMBLE_FILE");
-  if (TmpFile)
-    return TmpFile;
+  if (TmpFile) {
+    std::string Path =
+        Layer ? (Twine(TmpFile) + "." + Twine(Layer)).str() : TmpFile;
+    // A file kept in memory is only removed some time after the layer it
+    // belongs to is discarded, so the layer built in its place needs
+    // another name.
+    if (InMemory) {
+      static std::atomic<unsigned> Generation(0);
+      Path += "-" + llvm::utostr(++Generation);
+    }
+    return Path;
+  }
 
   SmallString<128> Path;
-  llvm::sys::fs::createTemporaryFile("preamble", "pch", Path);
+  if (InMemory)
+    llvm::sys::fs::getPotentiallyUniqueTempFileName("preamble", "pch", Path);
+  else
+    llvm::sys::fs::createTemporaryFile("preamble", "pch", Path);
 
   return Path.str();
 }
@@ -1316,6 +1363,148 @@ makeStandaloneDiagnostic(const LangOptions &LangOpts,
   return OutDiag;
 }
 
+/// \brief The maximum number of layers in a chained precompiled preamble.
+static const unsigned MaxPreambleLayers = 8;
+
+/// \brief Compute where the layers of a chained precompiled preamble end,
+/// not counting the end of the preamble itself.
+///
+/// The first layer holds the headers included with angle brackets at the
+/// start of the preamble, which rarely change. After that, each included
+/// header starts a new layer. Layers only end at the start of a line outside
+/// of any conditional directive, and outside of the regions delimited by
+/// pragmas whose state isn't saved in a precompiled header:
+/// \#pragma push_macro/pop_macro, \#pragma pack and
+/// \#pragma clang assume_nonnull begin/end.
+static void computePreambleLayerEnds(StringRef Preamble,
+                                     const LangOptions &LangOpts,
+                                     SmallVectorImpl<unsigned> &Ends) {
+  // Lex from a fake location so that token offsets can be recovered from
+  // their locations, like Lexer::ComputePreamble does.
+  const unsigned StartOffset = 1;
+  SourceLocation FileLoc = SourceLocation::getFromRawEncoding(StartOffset);
+  Lexer TheLexer(FileLoc, LangOpts, Preamble.begin(), Preamble.begin(),
+                 Preamble.end());
+
+  // The offsets at which a layer can end, each with whether the header
+  // included just before it was included with angle brackets.
+  SmallVector<std::pair<unsigned, bool>, 16> Candidates;
+  unsigned IfDepth = 0;
+  unsigned PushMacroDepth = 0;
+  unsigned PackDepth = 0;
+  bool PackChanged = false;
+  bool InAssumeNonNull = false;
+  bool AfterInclude = false;
+  bool AfterAngledInclude = false;
+  Token Tok;
+
+  // Lex the next token of the current directive, if it has one.
+  auto LexDirectiveToken = [&]() {
+    TheLexer.LexFromRawLexer(Tok);
+    return Tok.isNot(tok::eof) && !Tok.isAtStartOfLine();
+  };
+  auto IsRawIdentifier = [&](StringRef Name) {
+    return Tok.is(tok::raw_identifier) && Tok.getRawIdentifier() == Name;
+  };
+
+  TheLexer.LexFromRawLexer(Tok);
+  while (Tok.isNot(tok::eof)) {
+    if (!Tok.isAtStartOfLine()) {
+      TheLexer.LexFromRawLexer(Tok);
+      continue;
+    }
+
+    if (AfterInclude) {
+      // End a layer at the start of the line following the include, unless
+      // something other than whitespace comes before its first token.
+      unsigned Offset = Tok.getLocation().getRawEncoding() - StartOffset;
+      unsigned LineStart = Preamble.rfind('\n', Offset) + 1;
+      if (Preamble.slice(LineStart, Offset).find_first_not_of(" \t\f\v\r") ==
+          StringRef::npos)
+        Candidates.push_back(std::make_pair(LineStart, AfterAngledInclude));
+      AfterInclude = false;
+    }
+
+    if (Tok.isNot(tok::hash)) {
+      TheLexer.LexFromRawLexer(Tok);
+      continue;
+    }
+
+    TheLexer.LexFromRawLexer(Tok);
+    if (Tok.isAtStartOfLine() || Tok.isNot(tok::raw_identifier))
+      continue;
+
+    StringRef Directive = Tok.getRawIdentifier();
+    if (Directive == "if" || Directive == "ifdef" || Directive == "ifndef") {
+      ++IfDepth;
+    } else if (Directive == "endif") {
+      if (IfDepth)
+        --IfDepth;
+    } else if (Directive == "pragma") {
+      if (!LexDirectiveToken())
+        continue;
+      if (IsRawIdentifier("push_macro")) {
+        ++PushMacroDepth;
+      } else if (IsRawIdentifier("pop_macro")) {
+        if (PushMacroDepth)
+          --PushMacroDepth;
+      } else if (IsRawIdentifier("pack")) {
+        if (!LexDirectiveToken())
+          continue;
+        if (Tok.is(tok::l_paren)) {
+          if (!LexDirectiveToken())
+            continue;
+          if (Tok.is(tok::r_paren))
+            PackChanged = false;
+          else if (Tok.is(tok::numeric_constant))
+            PackChanged = true;
+          else if (IsRawIdentifier("push"))
+            ++PackDepth;
+          else if (IsRawIdentifier("pop") && PackDepth)
+            --PackDepth;
+        }
+      } else if (IsRawIdentifier("clang")) {
+        if (!LexDirectiveToken())
+          continue;
+        if (IsRawIdentifier("assume_nonnull")) {
+          if (!LexDirectiveToken())
+            continue;
+          if (IsRawIdentifier("begin"))
+            InAssumeNonNull = true;
+          else if (IsRawIdentifier("end"))
+            InAssumeNonNull = false;
+        }
+      }
+    } else if (IfDepth == 0 && PushMacroDepth == 0 && PackDepth == 0 &&
+               !PackChanged && !InAssumeNonNull &&
+               (Directive == "include" || Directive == "import" ||
+                Directive == "include_next")) {
+      TheLexer.LexFromRawLexer(Tok);
+      if (Tok.isAtStartOfLine())
+        continue;
+      AfterInclude = true;
+      AfterAngledInclude = Tok.is(tok::less);
+    }
+    TheLexer.LexFromRawLexer(Tok);
+  }
+
+  unsigned NumAngled = 0;
+  while (NumAngled != Candidates.size() && Candidates[NumAngled].second)
+    ++NumAngled;
+  if (NumAngled)
+    Ends.push_back(Candidates[NumAngled - 1].first);
+  for (unsigned I = NumAngled, N = Candidates.size(); I != N; ++I)
+    Ends.push_back(Candidates[I].first);
+
+  // With too many layers, merge the ones that directly follow the first
+  // layer: new includes tend to be added at the end of the preamble.
+  const unsigned MaxEnds = MaxPreambleLayers - 1;
+  if (Ends.size() > MaxEnds) {
+    unsigned NumKept = NumAngled ? 1 : 0;
+    Ends.erase(Ends.begin() + NumKept, Ends.end() - (MaxEnds - NumKept));
+  }
+}
+
 /// \brief Attempt to build or re-use a precompiled preamble when (re-)parsing
 /// the source file.
 ///
@@ -1324,7 +1513,8 @@ makeStandaloneDiagnostic(const LangOptions &LangOpts,
 /// precompiled header so that the precompiled preamble can be used to reduce
 /// reparsing time. If a precompiled preamble has already been constructed,
 /// this routine will determine if it is still valid and, if so, avoid 
-/// rebuilding the precompiled preamble.
+/// rebuilding the precompiled preamble. When the preamble is chained, only
+/// the layers that are no longer valid are rebuilt.
 ///
 /// \param AllowRebuild When true (the default), this routine is
 /// allowed to rebuild the precompiled preamble if it is found to be
@@ -1354,64 +1544,78 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
     // We couldn't find a preamble in the main source. Clear out the current
     // preamble, if we have one. It's obviously no good any more.
     Preamble.clear();
-    erasePreambleFile(this);
+    discardPreambleLayers(0);
 
     // The next time we actually see a preamble, precompile it.
     PreambleRebuildCounter = 1;
     return nullptr;
   }
-  
-  if (!Preamble.empty()) {
-    // We've previously computed a preamble. Check whether we have the same
-    // preamble now that we did before, and that there's enough space in
-    // the main-file buffer within the precompiled preamble to fit the
-    // new main file.
-    if (Preamble.size() == NewPreamble.Size &&
-        PreambleEndsAtStartOfLine == NewPreamble.PreambleEndsAtStartOfLine &&
-        memcmp(Preamble.getBufferStart(), NewPreamble.Buffer->getBufferStart(),
-               NewPreamble.Size) == 0) {
-      // The preamble has not changed. We may be able to re-use the precompiled
-      // preamble.
-
-      // Check that none of the files used by the preamble have changed.
-      bool AnyFileChanged = false;
-          
-      // First, make a record of those files that have been overridden via
-      // remapping or unsaved_files.
-      std::map<llvm::sys::fs::UniqueID, PreambleFileHash> OverriddenFiles;
-      for (const auto &R : PreprocessorOpts.RemappedFiles) {
-        if (AnyFileChanged)
-          break;
 
-        vfs::Status Status;
-        if (FileMgr->getNoncachedStatValue(R.second, Status)) {
-          // If we can't stat the file we're remapping to, assume that something
-          // horrible happened.
-          AnyFileChanged = true;
-          break;
-        }
+  // Decide where the layers of the new preamble end.
+  StringRef NewPreambleText =
+      NewPreamble.Buffer->getBuffer().slice(0, NewPreamble.Size);
+  SmallVector<unsigned, 8> NewLayerEnds;
+  if (ChainedPreamble)
+    computePreambleLayerEnds(NewPreambleText,
+                             *PreambleInvocation->getLangOpts(), NewLayerEnds);
+  NewLayerEnds.push_back(NewPreamble.Size);
 
-        OverriddenFiles[Status.getUniqueID()] = PreambleFileHash::createForFile(
-            Status.getSize(), Status.getLastModificationTime().toEpochTime());
+  if (!Preamble.empty()) {
+    // We've previously computed a preamble. Check how many of its layers
+    // are the same in the new preamble, and that none of the files used by
+    // those layers have changed.
+    bool AnyFileChanged = false;
+          
+    // First, make a record of those files that have been overridden via
+    // remapping or unsaved_files.
+    std::map<llvm::sys::fs::UniqueID, PreambleFileHash> OverriddenFiles;
+    for (const auto &R : PreprocessorOpts.RemappedFiles) {
+      if (AnyFileChanged)
+        break;
+
+      vfs::Status Status;
+      if (FileMgr->getNoncachedStatValue(R.second, Status)) {
+        // If we can't stat the file we're remapping to, assume that something
+        // horrible happened.
+        AnyFileChanged = true;
+        break;
       }
 
-      for (const auto &RB : PreprocessorOpts.RemappedFileBuffers) {
-        if (AnyFileChanged)
-          break;
+      OverriddenFiles[Status.getUniqueID()] = PreambleFileHash::createForFile(
+          Status.getSize(), Status.getLastModificationTime().toEpochTime());
+    }
 
-        vfs::Status Status;
-        if (FileMgr->getNoncachedStatValue(RB.first, Status)) {
-          AnyFileChanged = true;
-          break;
-        }
+    for (const auto &RB : PreprocessorOpts.RemappedFileBuffers) {
+      if (AnyFileChanged)
+        break;
 
-        OverriddenFiles[Status.getUniqueID()] =
-            PreambleFileHash::createForMemoryBuffer(RB.second);
+      vfs::Status Status;
+      if (FileMgr->getNoncachedStatValue(RB.first, Status)) {
+        AnyFileChanged = true;
+        break;
       }
-       
-      // Check whether anything has changed.
-      for (llvm::StringMap<PreambleFileHash>::iterator
-             F = FilesInPreamble.begin(), FEnd = FilesInPreamble.end();
+
+      OverriddenFiles[Status.getUniqueID()] =
+          PreambleFileHash::createForMemoryBuffer(RB.second);
+    }
+
+    unsigned NumValidLayers = 0;
+    while (!AnyFileChanged && NumValidLayers != PreambleLayers.size() &&
+           NumValidLayers != NewLayerEnds.size()) {
+      const PreambleLayer &Layer = PreambleLayers[NumValidLayers];
+      unsigned Begin =
+          NumValidLayers ? PreambleLayers[NumValidLayers - 1].End : 0;
+      bool EndsAtStartOfLine = NumValidLayers + 1 != NewLayerEnds.size() ||
+                               NewPreamble.PreambleEndsAtStartOfLine;
+      if (Layer.End != NewLayerEnds[NumValidLayers] ||
+          Layer.EndsAtStartOfLine != EndsAtStartOfLine ||
+          memcmp(Preamble.getBufferStart() + Begin,
+                 NewPreambleText.data() + Begin, Layer.End - Begin) != 0)
+        break;
+
+      // Check whether anything the layer uses has changed.
+      for (llvm::StringMap<PreambleFileHash>::const_iterator
+             F = Layer.Files.begin(), FEnd = Layer.Files.end();
            !AnyFileChanged && F != FEnd; 
            ++F) {
         vfs::Status Status;
@@ -1437,20 +1641,24 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
                 uint64_t(F->second.ModTime))
           AnyFileChanged = true;
       }
-          
-      if (!AnyFileChanged) {
-        // Okay! We can re-use the precompiled preamble.
-
-        // Set the state of the diagnostic object to mimic its state
-        // after parsing the preamble.
-        getDiagnostics().Reset();
-        ProcessWarningOptions(getDiagnostics(), 
-                              PreambleInvocation->getDiagnosticOpts());
-        getDiagnostics().setNumWarnings(NumWarningsInPreamble);
-
-        return llvm::MemoryBuffer::getMemBufferCopy(
-            NewPreamble.Buffer->getBuffer(), FrontendOpts.Inputs[0].getFile());
-      }
+
+      if (!AnyFileChanged)
+        ++NumValidLayers;
+    }
+
+    if (NumValidLayers == PreambleLayers.size() &&
+        NumValidLayers == NewLayerEnds.size()) {
+      // Okay! We can re-use the precompiled preamble.
+
+      // Set the state of the diagnostic object to mimic its state
+      // after parsing the preamble.
+      getDiagnostics().Reset();
+      ProcessWarningOptions(getDiagnostics(), 
+                            PreambleInvocation->getDiagnosticOpts());
+      getDiagnostics().setNumWarnings(NumWarningsInPreamble);
+
+      return llvm::MemoryBuffer::getMemBufferCopy(
+          NewPreamble.Buffer->getBuffer(), FrontendOpts.Inputs[0].getFile());
     }
 
     // If we aren't allowed to rebuild the precompiled preamble, just
@@ -1458,10 +1666,11 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
     if (!AllowRebuild)
       return nullptr;
 
-    // We can't reuse the previously-computed preamble. Build a new one.
+    // We can't reuse all of the previously-computed preamble. Keep the
+    // layers that are still valid and build the others again on top of them.
     Preamble.clear();
     PreambleDiagnostics.clear();
-    erasePreambleFile(this);
+    discardPreambleLayers(NumValidLayers);
     PreambleRebuildCounter = 1;
   } else if (!AllowRebuild) {
     // We aren't allowed to rebuild the precompiled preamble; just
@@ -1477,15 +1686,6 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
     return nullptr;
   }
 
-  // Create a temporary file for the precompiled preamble. In rare 
-  // circumstances, this can fail.
-  std::string PreamblePCHPath = GetPreamblePCHPath();
-  if (PreamblePCHPath.empty()) {
-    // Try again next time.
-    PreambleRebuildCounter = 1;
-    return nullptr;
-  }
-  
   // We did not previously compute a preamble, or it can't be reused anyway.
   SimpleTimer PreambleTimer(WantTiming);
   PreambleTimer.setOutput("Precompiling preamble");
@@ -1493,24 +1693,116 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
   // Save the preamble text for later; we'll need to compare against it for
   // subsequent reparses.
   StringRef MainFilename = FrontendOpts.Inputs[0].getFile();
-  Preamble.assign(FileMgr->getFile(MainFilename),
-                  NewPreamble.Buffer->getBufferStart(),
-                  NewPreamble.Buffer->getBufferStart() + NewPreamble.Size);
+  Preamble.assign(FileMgr->getFile(MainFilename), NewPreambleText.begin(),
+                  NewPreambleText.end());
   PreambleEndsAtStartOfLine = NewPreamble.PreambleEndsAtStartOfLine;
 
-  PreambleBuffer = llvm::MemoryBuffer::getMemBufferCopy(
-      NewPreamble.Buffer->getBuffer().slice(0, Preamble.size()), MainFilename);
+  // Build the missing layers, each on top of the one below it.
+  unsigned FirstNewLayer = PreambleLayers.size();
+  for (unsigned I = FirstNewLayer, N = NewLayerEnds.size(); I != N; ++I) {
+    if (!buildPreambleLayer(PCHContainerOps, *PreambleInvocation,
+                            NewPreambleText.slice(0, NewLayerEnds[I]),
+                            I + 1 != N ||
+                                NewPreamble.PreambleEndsAtStartOfLine)) {
+      Preamble.clear();
+      discardPreambleLayers(0);
+      return nullptr;
+    }
+  }
+
+  // Gather what was recorded while building each of the layers.
+  PreambleDiagnostics.clear();
+  TopLevelDeclsInPreamble.clear();
+  NumWarningsInPreamble = 0;
+  for (unsigned I = 0, N = PreambleLayers.size(); I != N; ++I) {
+    const PreambleLayer &Layer = PreambleLayers[I];
+    PreambleDiagnostics.append(Layer.Diagnostics.begin(),
+                               Layer.Diagnostics.end());
+    NumWarningsInPreamble += Layer.NumWarnings;
+    TopLevelDeclsInPreamble.insert(TopLevelDeclsInPreamble.end(),
+                                   Layer.TopLevelDecls.begin(),
+                                   Layer.TopLevelDecls.end());
+    if (I)
+      CurrentTopLevelHashValue =
+          llvm::hash_combine(CurrentTopLevelHashValue, Layer.TopLevelHashValue);
+    else
+      CurrentTopLevelHashValue = Layer.TopLevelHashValue;
+  }
+
+  // Unless the whole preamble was just built at once, set the state of the
+  // diagnostic object to mimic its state after parsing all of it.
+  if (FirstNewLayer != 0 || PreambleLayers.size() != 1) {
+    getDiagnostics().Reset();
+    ProcessWarningOptions(getDiagnostics(),
+                          PreambleInvocation->getDiagnosticOpts());
+    getDiagnostics().setNumWarnings(NumWarningsInPreamble);
+  }
+
+  PreambleRebuildCounter = 1;
+
+  // If the hash of top-level entities differs from the hash of the top-level
+  // entities the last time we rebuilt the preamble, clear out the completion
+  // cache.
+  if (CurrentTopLevelHashValue != PreambleTopLevelHashValue) {
+    CompletionCacheTopLevelHashValue = 0;
+    PreambleTopLevelHashValue = CurrentTopLevelHashValue;
+  }
+
+  return llvm::MemoryBuffer::getMemBufferCopy(NewPreamble.Buffer->getBuffer(),
+                                              MainFilename);
+}
+
+/// \brief Precompile the next layer of the preamble, on top of the layers
+/// that are already built, from the start of the preamble to the end of
+/// \p PreambleText.
+///
+/// \returns true if the layer was built. Otherwise, \c PreambleRebuildCounter
+/// is set to tell when to try again.
+bool ASTUnit::buildPreambleLayer(
+    std::shared_ptr<PCHContainerOperations> PCHContainerOps,
+    const CompilerInvocation &PreambleInvocationIn, StringRef PreambleText,
+    bool EndsAtStartOfLine) {
+  SimpleTimer LayerTimer(WantTiming && ChainedPreamble);
+  LayerTimer.setOutput("Precompiling preamble layer " +
+                       Twine(PreambleLayers.size() + 1));
+
+  // Create a temporary file for the precompiled preamble. In rare 
+  // circumstances, this can fail.
+  std::string PreamblePCHPath =
+      GetPreamblePCHPath(PreambleLayers.size(), PreambleFS != nullptr);
+  if (PreamblePCHPath.empty()) {
+    // Try again next time.
+    PreambleRebuildCounter = 1;
+    return false;
+  }
+
+  IntrusiveRefCntPtr<CompilerInvocation>
+    PreambleInvocation(new CompilerInvocation(PreambleInvocationIn));
+  FrontendOptions &FrontendOpts = PreambleInvocation->getFrontendOpts();
+  PreprocessorOptions &PreprocessorOpts
+    = PreambleInvocation->getPreprocessorOpts();
 
   // Remap the main source file to the preamble buffer.
   StringRef MainFilePath = FrontendOpts.Inputs[0].getFile();
+  PreambleBuffer =
+      llvm::MemoryBuffer::getMemBufferCopy(PreambleText, MainFilePath);
   PreprocessorOpts.addRemappedFile(MainFilePath, PreambleBuffer.get());
 
-  // Tell the compiler invocation to generate a temporary precompiled header.
+  // Tell the compiler invocation to generate a temporary precompiled header,
+  // chained onto the layer below this one.
   FrontendOpts.ProgramAction = frontend::GeneratePCH;
   // FIXME: Generate the precompiled header into memory?
   FrontendOpts.OutputFile = PreamblePCHPath;
-  PreprocessorOpts.PrecompiledPreambleBytes.first = 0;
-  PreprocessorOpts.PrecompiledPreambleBytes.second = false;
+  if (PreambleLayers.empty()) {
+    PreprocessorOpts.PrecompiledPreambleBytes.first = 0;
+    PreprocessorOpts.PrecompiledPreambleBytes.second = false;
+  } else {
+    PreprocessorOpts.PrecompiledPreambleBytes.first = PreambleLayers.back().End;
+    PreprocessorOpts.PrecompiledPreambleBytes.second
+                                      = PreambleLayers.back().EndsAtStartOfLine;
+    PreprocessorOpts.ImplicitPCHInclude = getPreambleFile();
+    PreprocessorOpts.DisablePCHValidation = true;
+  }
   
   // Create the compiler instance to use for building the precompiled preamble.
   std::unique_ptr<CompilerInstance> Clang(
@@ -1530,11 +1822,10 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
   Clang->setTarget(TargetInfo::CreateTargetInfo(
       Clang->getDiagnostics(), Clang->getInvocation().TargetOpts));
   if (!Clang->hasTarget()) {
-    llvm::sys::fs::remove(FrontendOpts.OutputFile);
-    Preamble.clear();
+    if (!PreambleFS)
+      llvm::sys::fs::remove(FrontendOpts.OutputFile);
     PreambleRebuildCounter = DefaultPreambleRebuildInterval;
-    PreprocessorOpts.RemappedFileBuffers.pop_back();
-    return nullptr;
+    return false;
   }
   
   // Inform the target of the language options.
@@ -1556,12 +1847,12 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
   checkAndRemoveNonDriverDiags(StoredDiagnostics);
   TopLevelDecls.clear();
   TopLevelDeclsInPreamble.clear();
-  PreambleDiagnostics.clear();
 
   IntrusiveRefCntPtr<vfs::FileSystem> VFS =
       createVFSFromCompilerInvocation(Clang->getInvocation(), getDiagnostics());
   if (!VFS)
-    return nullptr;
+    return false;
+  VFS = overlayPreambleFS(VFS);
 
   // Create a file manager object to provide access to and cache the filesystem.
   Clang->setFileManager(new FileManager(Clang->getFileSystemOpts(), VFS));
@@ -1574,23 +1865,26 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
   Clang->addDependencyCollector(PreambleDepCollector);
 
   std::unique_ptr<PrecompilePreambleAction> Act;
-  Act.reset(new PrecompilePreambleAction(*this));
+  Act.reset(new PrecompilePreambleAction(*this, PreambleFS != nullptr));
   if (!Act->BeginSourceFile(*Clang.get(), Clang->getFrontendOpts().Inputs[0])) {
-    llvm::sys::fs::remove(FrontendOpts.OutputFile);
-    Preamble.clear();
+    if (!PreambleFS)
+      llvm::sys::fs::remove(FrontendOpts.OutputFile);
     PreambleRebuildCounter = DefaultPreambleRebuildInterval;
-    PreprocessorOpts.RemappedFileBuffers.pop_back();
-    return nullptr;
+    return false;
   }
   
   Act->Execute();
 
-  // Transfer any diagnostics generated when parsing the preamble into the set
-  // of preamble diagnostics.
+  PreambleLayer Layer;
+  Layer.End = PreambleText.size();
+  Layer.EndsAtStartOfLine = EndsAtStartOfLine;
+
+  // Transfer any diagnostics generated when parsing the layer into the set
+  // of its diagnostics.
   for (stored_diag_iterator I = stored_diag_afterDriver_begin(),
                             E = stored_diag_end();
        I != E; ++I)
-    PreambleDiagnostics.push_back(
+    Layer.Diagnostics.push_back(
         makeStandaloneDiagnostic(Clang->getLangOpts(), *I));
 
   Act->EndSourceFile();
@@ -1601,49 +1895,73 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
     // The preamble PCH failed (e.g. there was a module loading fatal error),
     // so no precompiled header was generated. Forget that we even tried.
     // FIXME: Should we leave a note for ourselves to try again?
-    llvm::sys::fs::remove(FrontendOpts.OutputFile);
-    Preamble.clear();
+    if (!PreambleFS)
+      llvm::sys::fs::remove(FrontendOpts.OutputFile);
     TopLevelDeclsInPreamble.clear();
     PreambleRebuildCounter = DefaultPreambleRebuildInterval;
-    PreprocessorOpts.RemappedFileBuffers.pop_back();
-    return nullptr;
+    return false;
   }
   
-  // Keep track of the preamble we precompiled.
-  setPreambleFile(this, FrontendOpts.OutputFile);
-  NumWarningsInPreamble = getDiagnostics().getNumWarnings();
+  // Keep track of the layer we precompiled.
+  if (PreambleFS) {
+    if (!PreambleFS->addFile(FrontendOpts.OutputFile, /*ModificationTime=*/0,
+                             Act->takeInMemoryPCH())) {
+      TopLevelDeclsInPreamble.clear();
+      PreambleRebuildCounter = 1;
+      return false;
+    }
+  } else {
+    addPreambleFile(this, FrontendOpts.OutputFile);
+  }
+  Layer.PCHFile = FrontendOpts.OutputFile;
+  Layer.NumWarnings = getDiagnostics().getNumWarnings();
+  Layer.TopLevelDecls.swap(TopLevelDeclsInPreamble);
+  Layer.TopLevelHashValue = CurrentTopLevelHashValue;
   
   // Keep track of all of the files that the source manager knows about,
   // so we can verify whether they have changed or not.
-  FilesInPreamble.clear();
   SourceManager &SourceMgr = Clang->getSourceManager();
   for (auto &Filename : PreambleDepCollector->getDependencies()) {
     const FileEntry *File = Clang->getFileManager().getFile(Filename);
     if (!File || File == SourceMgr.getFileEntryForID(SourceMgr.getMainFileID()))
       continue;
     if (time_t ModTime = File->getModificationTime()) {
-      FilesInPreamble[File->getName()] = PreambleFileHash::createForFile(
+      Layer.Files[File->getName()] = PreambleFileHash::createForFile(
           File->getSize(), ModTime);
     } else {
       llvm::MemoryBuffer *Buffer = SourceMgr.getMemoryBufferForFile(File);
-      FilesInPreamble[File->getName()] =
+      Layer.Files[File->getName()] =
           PreambleFileHash::createForMemoryBuffer(Buffer);
     }
   }
 
-  PreambleRebuildCounter = 1;
-  PreprocessorOpts.RemappedFileBuffers.pop_back();
+  PreambleLayers.push_back(std::move(Layer));
+  return true;
+}
 
-  // If the hash of top-level entities differs from the hash of the top-level
-  // entities the last time we rebuilt the preamble, clear out the completion
-  // cache.
-  if (CurrentTopLevelHashValue != PreambleTopLevelHashValue) {
-    CompletionCacheTopLevelHashValue = 0;
-    PreambleTopLevelHashValue = CurrentTopLevelHashValue;
-  }
+/// \brief Throw away the layers of the precompiled preamble from
+/// \p FirstLayer up, along with their files. Files kept in memory are only
+/// removed by the next parse, once nothing uses them any more.
+void ASTUnit::discardPreambleLayers(unsigned FirstLayer) {
+  if (PreambleFS)
+    for (unsigned I = FirstLayer, N = PreambleLayers.size(); I < N; ++I)
+      DiscardedPreambleFiles.push_back(PreambleLayers[I].PCHFile);
+  if (FirstLayer < PreambleLayers.size())
+    PreambleLayers.erase(PreambleLayers.begin() + FirstLayer,
+                         PreambleLayers.end());
+  erasePreambleFiles(this, FirstLayer);
+}
 
-  return llvm::MemoryBuffer::getMemBufferCopy(NewPreamble.Buffer->getBuffer(),
-                                              MainFilename);
+/// \brief Returns \p VFS, with the file system that holds the precompiled
+/// preamble layered over it when the preamble is kept in memory.
+IntrusiveRefCntPtr<vfs::FileSystem>
+ASTUnit::overlayPreambleFS(IntrusiveRefCntPtr<vfs::FileSystem> VFS) {
+  if (!PreambleFS)
+    return VFS;
+  IntrusiveRefCntPtr<vfs::OverlayFileSystem> Overlay(
+      new vfs::OverlayFileSystem(VFS));
+  Overlay->pushOverlay(PreambleFS);
+  return Overlay;
 }
 
 void ASTUnit::RealizeTopLevelDeclsFromPreamble() {
@@ -1677,6 +1995,17 @@ void ASTUnit::transferASTDataFromCompilerInstance(CompilerInstance &CI) {
     Target = &CI.getTarget();
   Reader = CI.getModuleManager();
   HadModuleLoaderFatalFailure = CI.hadModuleLoaderFatalFailure();
+
+  // Find the main file of each preamble layer. The top layer was loaded
+  // first, and it loaded the layers below it.
+  PreambleLayerFileIDs.clear();
+  if (Reader) {
+    serialization::ModuleManager &Modules = Reader->getModuleManager();
+    for (auto M = Modules.rbegin(), MEnd = Modules.rend(); M != MEnd; ++M)
+      if ((*M)->Kind == serialization::MK_Preamble &&
+          (*M)->OriginalSourceFileID.isValid())
+        PreambleLayerFileIDs.push_back((*M)->OriginalSourceFileID);
+  }
 }
 
 StringRef ASTUnit::getMainFileName() const {
@@ -1944,8 +2273,9 @@ ASTUnit *ASTUnit::LoadFromCommandLine(
     unsigned PrecompilePreambleAfterNParses, TranslationUnitKind TUKind,
     bool CacheCodeCompletionResults, bool IncludeBriefCommentsInCodeCompletion,
     bool AllowPCHWithCompilerErrors, bool SkipFunctionBodies,
-    bool UserFilesAreVolatile, bool ForSerialization,
-    llvm::Optional<StringRef> ModuleFormat, std::unique_ptr<ASTUnit> *ErrAST) {
+    bool UserFilesAreVolatile, bool ForSerialization, bool ChainedPreamble,
+    bool StorePreambleInMemory, llvm::Optional<StringRef> ModuleFormat,
+    std::unique_ptr<ASTUnit> *ErrAST) {
   assert(Diags.get() && "no DiagnosticsEngine was provided");
 
   SmallVector<StoredDiagnostic, 4> StoredDiagnostics;
@@ -1991,7 +2321,10 @@ ASTUnit *ASTUnit::LoadFromCommandLine(
       createVFSFromCompilerInvocation(*CI, *Diags);
   if (!VFS)
     return nullptr;
-  AST->FileMgr = new FileManager(AST->FileSystemOpts, VFS);
+  if (StorePreambleInMemory)
+    AST->PreambleFS = new vfs::InMemoryFileSystem;
+  AST->FileMgr = new FileManager(AST->FileSystemOpts,
+                                 AST->overlayPreambleFS(VFS));
   AST->OnlyLocalDecls = OnlyLocalDecls;
   AST->CaptureDiagnostics = CaptureDiagnostics;
   AST->TUKind = TUKind;
@@ -1999,6 +2332,7 @@ ASTUnit *ASTUnit::LoadFromCommandLine(
   AST->IncludeBriefCommentsInCodeCompletion
     = IncludeBriefCommentsInCodeCompletion;
   AST->UserFilesAreVolatile = UserFilesAreVolatile;
+  AST->ChainedPreamble = ChainedPreamble;
   AST->NumStoredDiagnosticsFromDriver = StoredDiagnostics.size();
   AST->StoredDiagnostics.swap(StoredDiagnostics);
   AST->Invocation = CI;
@@ -2050,7 +2384,7 @@ bool ASTUnit::Reparse(std::shared_ptr<PCHContainerOperations> PCHContainerOps,
   // If we have a preamble file lying around, or if we might try to
   // build a precompiled preamble, do so now.
   std::unique_ptr<llvm::MemoryBuffer> OverrideMainBuffer;
-  if (!getPreambleFile(this).empty() || PreambleRebuildCounter > 0)
+  if (!getPreambleFile().empty() || PreambleRebuildCounter > 0)
     OverrideMainBuffer =
         getMainBufferWithPrecompiledPreamble(PCHContainerOps, *Invocation);
 
@@ -2418,7 +2752,7 @@ void ASTUnit::CodeComplete(
   // point is within the main file, after the end of the precompiled
   // preamble.
   std::unique_ptr<llvm::MemoryBuffer> OverrideMainBuffer;
-  if (!getPreambleFile(this).empty()) {
+  if (!getPreambleFile().empty()) {
     std::string CompleteFilePath(File);
     llvm::sys::fs::UniqueID CompleteFileID;
 
@@ -2441,7 +2775,7 @@ void ASTUnit::CodeComplete(
     PreprocessorOpts.PrecompiledPreambleBytes.first = Preamble.size();
     PreprocessorOpts.PrecompiledPreambleBytes.second
                                                     = PreambleEndsAtStartOfLine;
-    PreprocessorOpts.ImplicitPCHInclude = getPreambleFile(this);
+    PreprocessorOpts.ImplicitPCHInclude = getPreambleFile();
     PreprocessorOpts.DisablePCHValidation = true;
 
     OwnedBuffers.push_back(OverrideMainBuffer.release());
@@ -2677,18 +3011,19 @@ SourceLocation ASTUnit::getLocation(const FileEntry *File,
 /// the corresponding local location of the main file, otherwise it returns
 /// \arg Loc.
 SourceLocation ASTUnit::mapLocationFromPreamble(SourceLocation Loc) {
-  FileID PreambleID;
-  if (SourceMgr)
-    PreambleID = SourceMgr->getPreambleFileID();
-
-  if (Loc.isInvalid() || Preamble.empty() || PreambleID.isInvalid())
+  if (Loc.isInvalid() || Preamble.empty() || !SourceMgr)
     return Loc;
 
+  // Each layer of the preamble has its own copy of the main file.
   unsigned Offs;
-  if (SourceMgr->isInFileID(Loc, PreambleID, &Offs) && Offs < Preamble.size()) {
-    SourceLocation FileLoc
-        = SourceMgr->getLocForStartOfFile(SourceMgr->getMainFileID());
-    return FileLoc.getLocWithOffset(Offs);
+  for (FileID PreambleID : PreambleLayerFileIDs) {
+    if (SourceMgr->isInFileID(Loc, PreambleID, &Offs)) {
+      if (Offs >= Preamble.size())
+        return Loc;
+      SourceLocation FileLoc
+          = SourceMgr->getLocForStartOfFile(SourceMgr->getMainFileID());
+      return FileLoc.getLocWithOffset(Offs);
+    }
   }
 
   return Loc;
@@ -2698,16 +3033,22 @@ SourceLocation ASTUnit::mapLocationFromPreamble(SourceLocation Loc) {
 /// preamble chunk, returns the corresponding loaded location from the
 /// preamble, otherwise it returns \arg Loc.
 SourceLocation ASTUnit::mapLocationToPreamble(SourceLocation Loc) {
-  FileID PreambleID;
-  if (SourceMgr)
-    PreambleID = SourceMgr->getPreambleFileID();
-
-  if (Loc.isInvalid() || Preamble.empty() || PreambleID.isInvalid())
+  if (Loc.isInvalid() || Preamble.empty() || !SourceMgr ||
+      PreambleLayerFileIDs.empty())
     return Loc;
 
   unsigned Offs;
   if (SourceMgr->isInFileID(Loc, SourceMgr->getMainFileID(), &Offs) &&
       Offs < Preamble.size()) {
+    // Map into the lowest layer that extends past the location: that is the
+    // layer in which the entities at that location were parsed.
+    FileID PreambleID = PreambleLayerFileIDs.back();
+    for (FileID LayerID : PreambleLayerFileIDs) {
+      if (Offs < SourceMgr->getFileIDSize(LayerID)) {
+        PreambleID = LayerID;
+        break;
+      }
+    }
     SourceLocation FileLoc = SourceMgr->getLocForStartOfFile(PreambleID);
     return FileLoc.getLocWithOffset(Offs);
   }
@@ -2716,14 +3057,13 @@ SourceLocation ASTUnit::mapLocationToPreamble(SourceLocation Loc) {
 }
 
 bool ASTUnit::isInPreambleFileID(SourceLocation Loc) {
-  FileID FID;
-  if (SourceMgr)
-    FID = SourceMgr->getPreambleFileID();
-  
-  if (Loc.isInvalid() || FID.isInvalid())
+  if (Loc.isInvalid() || !SourceMgr)
     return false;
-  
-  return SourceMgr->isInFileID(Loc, FID);
+
+  for (FileID FID : PreambleLayerFileIDs)
+    if (SourceMgr->isInFileID(Loc, FID))
+      return true;
+  return false;
 }
 
 bool ASTUnit::isInMainFileID(SourceLocation Loc) {
@@ -13,6 +13,7 @@
 #include "clang/AST/Decl.h"
 #include "clang/Basic/Diagnostic.h"
 #include "clang/Basic/FileManager.h"
+#include "clang/Basic/PersistentStatCache.h"
 #include "clang/Basic/SourceManager.h"
 #include "clang/Basic/TargetInfo.h"
 #include "clang/Basic/Version.h"
@@ -46,10 +47,16 @@
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
+#include <chrono>
 #include <sys/stat.h>
 #include <system_error>
 #include <time.h>
 #include <utility>
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
 
 using namespace clang;
 
@@ -57,7 +64,7 @@ CompilerInstance::CompilerInstance(
     std::shared_ptr<PCHContainerOperations> PCHContainerOps,
     bool BuildingModule)
     : ModuleLoader(BuildingModule), Invocation(new CompilerInvocation()),
-      ModuleManager(nullptr),
+      OwnedStatCache(nullptr), ModuleManager(nullptr),
       ThePCHContainerOperations(std::move(PCHContainerOps)),
       BuildGlobalModuleIndex(false), HaveFullGlobalModuleIndex(false),
       ModuleBuildFailed(false) {}
@@ -86,6 +93,7 @@ void CompilerInstance::setAuxTarget(TargetInfo *Value) { AuxTarget = Value; }
 
 void CompilerInstance::setFileManager(FileManager *Value) {
   FileMgr = Value;
+  OwnedStatCache = nullptr;
   if (Value)
     VirtualFileSystem = Value->getVirtualFileSystem();
   else
@@ -236,6 +244,13 @@ void CompilerInstance::createFileManager() {
     setVirtualFileSystem(vfs::getRealFileSystem());
   }
   FileMgr = new FileManager(getFileSystemOpts(), VirtualFileSystem);
+  OwnedStatCache = nullptr;
+  if (!getFileSystemOpts().StatCachePath.empty()) {
+    auto StatCache = llvm::make_unique<PersistentStatCache>(
+        getFileSystemOpts().StatCachePath);
+    OwnedStatCache = StatCache.get();
+    FileMgr->addStatCache(std::move(StatCache));
+  }
 }
 
 // Source Manager
@@ -418,7 +433,8 @@ void CompilerInstance::createPCHExternalASTSource(
       getFrontendOpts().ModuleFileExtensions,
       DeserializationListener,
       OwnDeserializationListener, Preamble,
-      getFrontendOpts().UseGlobalModuleIndex);
+      getFrontendOpts().UseGlobalModuleIndex,
+      !getFrontendOpts().ModuleLoadProfileFile.empty());
 }
 
 IntrusiveRefCntPtr<ASTReader> CompilerInstance::createPCHExternalASTSource(
@@ -427,7 +443,7 @@ IntrusiveRefCntPtr<ASTReader> CompilerInstance::createPCHExternalASTSource(
     const PCHContainerReader &PCHContainerRdr,
     ArrayRef<IntrusiveRefCntPtr<ModuleFileExtension>> Extensions,
     void *DeserializationListener, bool OwnDeserializationListener,
-    bool Preamble, bool UseGlobalModuleIndex) {
+    bool Preamble, bool UseGlobalModuleIndex, bool CollectModuleLoadProfile) {
   HeaderSearchOptions &HSOpts = PP.getHeaderSearchInfo().getHeaderSearchOpts();
 
   IntrusiveRefCntPtr<ASTReader> Reader(new ASTReader(
@@ -435,6 +451,7 @@ IntrusiveRefCntPtr<ASTReader> CompilerInstance::createPCHExternalASTSource(
       Sysroot.empty() ? "" : Sysroot.data(), DisablePCHValidation,
       AllowPCHWithCompilerErrors, /*AllowConfigurationMismatch*/ false,
       HSOpts.ModulesValidateSystemHeaders, UseGlobalModuleIndex));
+  Reader->setCollectModuleLoadProfile(CollectModuleLoadProfile);
 
   // We need the external source to be set up before we read the AST, because
   // eagerly-deserialized declarations may use it.
@@ -873,6 +890,15 @@ bool CompilerInstance::ExecuteAction(FrontendAction &Act) {
     }
   }
 
+  // Write back the failed lookups seen while processing the inputs. The file
+  // manager may outlive this call (or be leaked), so don't wait for it to
+  // destroy the persistent stat cache. Leave the rest of the chain alone:
+  // it may belong to the instance that imported the module being built.
+  if (OwnedStatCache && hasFileManager()) {
+    getFileManager().removeStatCache(OwnedStatCache);
+    OwnedStatCache = nullptr;
+  }
+
   // Notify the diagnostic client that all files were processed.
   getDiagnostics().getClient()->finish();
 
@@ -964,6 +990,7 @@ static bool compileModuleImpl(CompilerInstance &ImportingInstance,
   FrontendOpts.DisableFree = false;
   FrontendOpts.GenerateGlobalModuleIndex = false;
   FrontendOpts.BuildingImplicitModule = true;
+  FrontendOpts.ModuleLoadProfileFile.clear();
   FrontendOpts.Inputs.clear();
   InputKind IK = getSourceInputKindFromOptions(*Invocation->getLangOpts());
 
@@ -1059,6 +1086,89 @@ static bool compileModuleImpl(CompilerInstance &ImportingInstance,
   return !Instance.getDiagnostics().hasErrorOccurred();
 }
 
+#if defined(__linux__)
+/// \brief Returns false if the process that holds the lock on
+/// \p ModuleFileName is no longer running, and true otherwise.
+static bool isLockOwnerAlive(StringRef ModuleFileName) {
+  // LockFileManager only shares a lock whose owner is still running, and
+  // removes the lock file of an owner that died. The probe doesn't create any
+  // files unless it takes over the lock, which it releases right away.
+  llvm::LockFileManager Probe(ModuleFileName);
+  return Probe != llvm::LockFileManager::LFS_Owned;
+}
+#endif
+
+/// \brief Wait for the process that holds the lock on \p ModuleFileName to
+/// finish building the module.
+///
+/// LockFileManager::waitForUnlock polls the lock file with a sleep that
+/// doubles each time, so once another process's build has taken a while, its
+/// waiters can notice that it finished long after it did. On Linux, watch the
+/// module cache directory instead, and check the lock file as soon as
+/// anything in it is removed.
+static llvm::LockFileManager::WaitForUnlockResult
+waitForModuleBuild(llvm::LockFileManager &Locked, StringRef ModuleFileName) {
+  llvm::LockFileManager::WaitForUnlockResult Result;
+#if defined(__linux__)
+  SmallString<128> LockFileName(ModuleFileName);
+  LockFileName += ".lock";
+  SmallString<128> Dir(llvm::sys::path::parent_path(ModuleFileName));
+  if (Dir.empty())
+    Dir = ".";
+
+  int FD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (FD >= 0 && inotify_add_watch(FD, Dir.c_str(),
+                                   IN_DELETE | IN_MOVED_FROM) >= 0) {
+    // Give up after as long as LockFileManager::waitForUnlock does: it first
+    // sleeps for a millisecond, then doubles the interval for as long as it
+    // is under five minutes, which adds up to almost nine minutes.
+    std::chrono::milliseconds Timeout(0);
+    for (std::chrono::milliseconds Interval(1);
+         Interval < std::chrono::minutes(5); Interval *= 2)
+      Timeout += Interval;
+    const auto Deadline = std::chrono::steady_clock::now() + Timeout;
+    while (true) {
+      // The watch is in place before each check, so a removal cannot be
+      // missed between the check and the wait.
+      if (!llvm::sys::fs::exists(LockFileName)) {
+        Result = llvm::LockFileManager::Res_Success;
+        break;
+      }
+      if (!isLockOwnerAlive(ModuleFileName)) {
+        Result = llvm::LockFileManager::Res_OwnerDied;
+        break;
+      }
+      if (std::chrono::steady_clock::now() >= Deadline) {
+        Result = llvm::LockFileManager::Res_Timeout;
+        break;
+      }
+
+      // Wake up once a second regardless, to notice an owner that died
+      // without removing its lock file.
+      struct pollfd PFD = { FD, POLLIN, 0 };
+      if (poll(&PFD, 1, /*timeout=*/1000) > 0) {
+        char Events[4096];
+        while (read(FD, Events, sizeof(Events)) > 0)
+          ;
+      }
+    }
+  } else
+    Result = Locked.waitForUnlock();
+  if (FD >= 0)
+    close(FD);
+#else
+  Result = Locked.waitForUnlock();
+#endif
+
+  // The lock is also released when the owner fails to build the module. Try
+  // to take over the lock and build it ourselves rather than reading a module
+  // file that isn't there.
+  if (Result == llvm::LockFileManager::Res_Success &&
+      !llvm::sys::fs::exists(ModuleFileName))
+    return llvm::LockFileManager::Res_OwnerDied;
+  return Result;
+}
+
 static bool compileAndLoadModule(CompilerInstance &ImportingInstance,
                                  SourceLocation ImportLoc,
                                  SourceLocation ModuleNameLoc, Module *Module,
@@ -1096,7 +1206,7 @@ static bool compileAndLoadModule(CompilerInstance &ImportingInstance,
     case llvm::LockFileManager::LFS_Shared:
       // Someone else is responsible for building the module. Wait for them to
       // finish.
-      switch (Locked.waitForUnlock()) {
+      switch (waitForModuleBuild(Locked, ModuleFileName)) {
       case llvm::LockFileManager::Res_Success:
         ModuleLoadCapabilities |= ASTReader::ARR_OutOfDate;
         break;
@@ -1243,9 +1353,12 @@ static void pruneModuleCache(const HeaderSearchOptions &HSOpts) {
     // Walk all of the files within this directory.
     for (llvm::sys::fs::directory_iterator File(Dir->path(), EC), FileEnd;
          File != FileEnd && !EC; File.increment(EC)) {
-      // We only care about module and global module index files.
+      // We only care about module and global module index files, and the file
+      // contents shared by modules. A module whose shared file contents were
+      // removed is rebuilt the next time it is loaded.
       StringRef Extension = llvm::sys::path::extension(File->path());
       if (Extension != ".pcm" && Extension != ".timestamp" &&
+          Extension != ".contents" &&
           llvm::sys::path::filename(File->path()) != "modules.idx")
         continue;
 
@@ -1307,6 +1420,8 @@ void CompilerInstance::createModuleManager() {
         HSOpts.ModulesValidateSystemHeaders,
         getFrontendOpts().UseGlobalModuleIndex,
         std::move(ReadTimer));
+    ModuleManager->setCollectModuleLoadProfile(
+        !getFrontendOpts().ModuleLoadProfileFile.empty());
     if (hasASTConsumer()) {
       ModuleManager->setDeserializationListener(
         getASTConsumer().GetASTDeserializationListener());
@@ -484,6 +484,20 @@ void FrontendAction::EndSourceFile() {
   // Finalize the action.
   EndSourceFileAction();
 
+  // Write the module load profile while the AST reader is still around.
+  StringRef ProfileFile = CI.getFrontendOpts().ModuleLoadProfileFile;
+  if (!ProfileFile.empty()) {
+    std::error_code EC;
+    llvm::raw_fd_ostream OS(ProfileFile, EC, llvm::sys::fs::F_Text);
+    if (EC)
+      CI.getDiagnostics().Report(diag::err_fe_unable_to_open_output)
+          << ProfileFile << EC.message();
+    else if (IntrusiveRefCntPtr<ASTReader> Reader = CI.getModuleManager())
+      Reader->writeModuleLoadProfile(OS);
+    else
+      OS << "{\n  \"modules\": []\n}\n";
+  }
+
   // Sema references the ast consumer, so reset sema first.
   //
   // FIXME: There is more per-file stuff we could just drop here?
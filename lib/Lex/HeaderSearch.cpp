@@ -14,9 +14,11 @@
 #include "clang/Lex/HeaderSearch.h"
 #include "clang/Basic/FileManager.h"
 #include "clang/Basic/IdentifierTable.h"
+#include "clang/Basic/VirtualFileSystem.h"
 #include "clang/Lex/ExternalPreprocessorSource.h"
 #include "clang/Lex/HeaderMap.h"
 #include "clang/Lex/HeaderSearchOptions.h"
+#include "clang/Lex/IncludeGuardCache.h"
 #include "clang/Lex/LexDiagnostic.h"
 #include "clang/Lex/Lexer.h"
 #include "clang/Lex/Preprocessor.h"
@@ -67,6 +69,12 @@ HeaderSearch::HeaderSearch(IntrusiveRefCntPtr<HeaderSearchOptions> HSOpts,
   NumIncluded = 0;
   NumMultiIncludeFileOptzn = 0;
   NumFrameworkLookups = NumSubFrameworkLookups = 0;
+  NumDirectoryListingSkips = 0;
+  NumIncludeGuardCacheSkips = 0;
+
+  if (!this->HSOpts->IncludeGuardCachePath.empty())
+    GuardCache = llvm::make_unique<IncludeGuardCache>(
+        this->HSOpts->IncludeGuardCachePath);
 }
 
 HeaderSearch::~HeaderSearch() {
@@ -95,6 +103,12 @@ void HeaderSearch::PrintStats() {
 
   fprintf(stderr, "%d framework lookups.\n", NumFrameworkLookups);
   fprintf(stderr, "%d subframework lookups.\n", NumSubFrameworkLookups);
+  if (HSOpts->UseDirectoryListings)
+    fprintf(stderr, "%d lookups skipped by directory listings.\n",
+            NumDirectoryListingSkips);
+  if (GuardCache)
+    fprintf(stderr, "%d #includes skipped due to the include guard cache.\n",
+            NumIncludeGuardCacheSkips);
 }
 
 /// CreateHeaderMap - This method returns a HeaderMap for the specified
@@ -285,6 +299,38 @@ const FileEntry *HeaderSearch::getFileAndSuggestModule(
   return File;
 }
 
+bool HeaderSearch::directoryMayContain(const DirectoryEntry *Dir,
+                                       StringRef Filename) {
+  if (!HSOpts->UseDirectoryListings || Filename.empty())
+    return true;
+
+  // Only the first component of the path is checked, so that one listing of
+  // each search directory is enough.
+  StringRef First = *llvm::sys::path::begin(Filename);
+  if (First == "." || First == "..")
+    return true;
+
+  auto Known = DirectoryListings.find(Dir);
+  if (Known == DirectoryListings.end()) {
+    SmallString<128> DirName(Dir->getName());
+    FileMgr.FixupRelativePath(DirName);
+
+    auto Names = llvm::make_unique<llvm::StringSet<>>();
+    std::error_code EC;
+    vfs::FileSystem &FS = *FileMgr.getVirtualFileSystem();
+    for (vfs::directory_iterator I = FS.dir_begin(DirName, EC), E;
+         !EC && I != E; I.increment(EC))
+      Names->insert(llvm::sys::path::filename(I->getName()).lower());
+    if (EC)
+      Names.reset();
+    Known = DirectoryListings.insert(std::make_pair(Dir, std::move(Names)))
+                .first;
+  }
+
+  // Names are compared without case, since the file system might do so too.
+  return !Known->second || Known->second->count(First.lower());
+}
+
 /// LookupFile - Lookup the specified file in this search path, returning it
 /// if it exists or returning null if not.
 const FileEntry *DirectoryLookup::LookupFile(
@@ -316,6 +362,14 @@ const FileEntry *DirectoryLookup::LookupFile(
       RelativePath->append(Filename.begin(), Filename.end());
     }
 
+    // Don't look for a file that isn't in the directory's listing, unless it
+    // is a virtual file.
+    if (!HS.directoryMayContain(getDir(), Filename) &&
+        !HS.getFileMgr().getCachedFile(TmpDir)) {
+      ++HS.NumDirectoryListingSkips;
+      return nullptr;
+    }
+
     return HS.getFileAndSuggestModule(TmpDir, IncludeLoc, getDir(),
                                       isSystemHeaderDirectory(),
                                       RequestingModule, SuggestedModule);
@@ -1088,6 +1142,22 @@ bool HeaderSearch::ShouldEnterIncludeFile(Preprocessor &PP,
       ++NumMultiIncludeFileOptzn;
       return false;
     }
+  } else if (GuardCache && !M && !FileInfo.NumIncludes) {
+    // The file hasn't been entered yet, so we don't know its guard, but an
+    // earlier translation unit might have. This is not done for modular
+    // headers, whose guards depend on the visibility of macros.
+    StringRef Guard = GuardCache->getGuard(File);
+    if (!Guard.empty()) {
+      IdentifierInfo *GuardII = PP.getIdentifierInfo(Guard);
+      if (PP.isMacroDefined(GuardII)) {
+        // The header's #ifndef would have used the guard macro, so mark it
+        // used here for -Wunused-macros.
+        if (MacroInfo *MI = PP.getMacroInfo(GuardII))
+          PP.markMacroAsUsed(MI);
+        ++NumIncludeGuardCacheSkips;
+        return false;
+      }
+    }
   }
 
   // Increment the number of times this file has been included.
@@ -1096,6 +1166,17 @@ bool HeaderSearch::ShouldEnterIncludeFile(Preprocessor &PP,
   return true;
 }
 
+void HeaderSearch::recordIncludeGuard(const FileEntry *File,
+                                      const IdentifierInfo *ControllingMacro) {
+  if (GuardCache)
+    GuardCache->setGuard(File, ControllingMacro->getName());
+}
+
+void HeaderSearch::saveIncludeGuards() {
+  if (GuardCache)
+    GuardCache->save();
+}
+
 size_t HeaderSearch::getTotalMemory() const {
   return SearchDirs.capacity()
     + llvm::capacity_in_bytes(FileInfo)
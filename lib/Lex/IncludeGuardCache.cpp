@@ -0,0 +1,198 @@
+//===--- IncludeGuardCache.cpp - Include guards shared between TUs --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the IncludeGuardCache class.
+//
+// The cache file holds an OnDiskCacheTable, with magic 'CIGC'. Each entry
+// maps the absolute path of a header to its modification time and size
+// (both uint64) followed by the name of its guard macro. All integers are
+// little endian.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Lex/IncludeGuardCache.h"
+#include "clang/Basic/FileManager.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Path.h"
+
+using namespace clang;
+
+/// \brief The magic number at the start of the cache file.
+static const char CacheMagic[] = "CIGC";
+
+/// \brief The version of the cache file format.
+static const uint32_t CurrentVersion = 1;
+
+/// \brief Trait used to read and write the guards in the cache file.
+class IncludeGuardCache::IncludeGuardTrait {
+public:
+  /// \brief A header's guard, as stored in the cache file.
+  struct GuardData {
+    uint64_t ModTime;
+    uint64_t Size;
+    StringRef Guard;
+  };
+
+  typedef StringRef key_type;
+  typedef StringRef key_type_ref;
+  typedef StringRef external_key_type;
+  typedef StringRef internal_key_type;
+  typedef GuardData data_type;
+  typedef const GuardData &data_type_ref;
+  typedef unsigned hash_value_type;
+  typedef unsigned offset_type;
+
+  static hash_value_type ComputeHash(StringRef Key) {
+    return llvm::HashString(Key);
+  }
+
+  static bool EqualKey(StringRef A, StringRef B) { return A == B; }
+
+  static StringRef GetInternalKey(StringRef Key) { return Key; }
+  static StringRef GetExternalKey(StringRef Key) { return Key; }
+
+  static std::pair<unsigned, unsigned>
+  EmitKeyDataLength(raw_ostream &Out, StringRef Key, const GuardData &Data) {
+    using namespace llvm::support;
+    endian::Writer<little> LE(Out);
+    unsigned DataLen = 16 + Data.Guard.size();
+    LE.write<uint16_t>(Key.size());
+    LE.write<uint16_t>(DataLen);
+    return std::make_pair(Key.size(), DataLen);
+  }
+
+  static void EmitKey(raw_ostream &Out, StringRef Key, unsigned) {
+    Out << Key;
+  }
+
+  static void EmitData(raw_ostream &Out, StringRef, const GuardData &Data,
+                       unsigned) {
+    using namespace llvm::support;
+    endian::Writer<little> LE(Out);
+    LE.write<uint64_t>(Data.ModTime);
+    LE.write<uint64_t>(Data.Size);
+    Out << Data.Guard;
+  }
+
+  static std::pair<unsigned, unsigned>
+  ReadKeyDataLength(const unsigned char *&D) {
+    using namespace llvm::support;
+    unsigned KeyLen = endian::readNext<uint16_t, little, unaligned>(D);
+    unsigned DataLen = endian::readNext<uint16_t, little, unaligned>(D);
+    return std::make_pair(KeyLen, DataLen);
+  }
+
+  static StringRef ReadKey(const unsigned char *D, unsigned N) {
+    return StringRef(reinterpret_cast<const char *>(D), N);
+  }
+
+  static GuardData ReadData(StringRef, const unsigned char *D,
+                            unsigned DataLen) {
+    using namespace llvm::support;
+    GuardData Data;
+    Data.ModTime = endian::readNext<uint64_t, little, unaligned>(D);
+    Data.Size = endian::readNext<uint64_t, little, unaligned>(D);
+    Data.Guard = StringRef(reinterpret_cast<const char *>(D), DataLen - 16);
+    return Data;
+  }
+};
+
+std::unique_ptr<IncludeGuardCache::Table>
+IncludeGuardCache::loadTable(StringRef Path) {
+  return Table::load(Path, CacheMagic, CurrentVersion);
+}
+
+/// \brief The key of \p File in the cache file: its absolute path, or an
+/// empty string if it has none.
+static StringRef getKey(const FileEntry *File) {
+  StringRef Name = File->getName();
+  if (!llvm::sys::path::is_absolute(Name))
+    Name = File->tryGetRealPathName();
+  if (Name.empty() || !llvm::sys::path::is_absolute(Name) ||
+      Name.size() > UINT16_MAX)
+    return StringRef();
+  return Name;
+}
+
+IncludeGuardCache::IncludeGuardCache(StringRef CachePath)
+    : CachePath(CachePath) {
+  Guards = loadTable(CachePath);
+}
+
+IncludeGuardCache::~IncludeGuardCache() { save(); }
+
+StringRef IncludeGuardCache::getGuard(const FileEntry *File) {
+  StringRef Key = getKey(File);
+  if (Key.empty())
+    return StringRef();
+
+  auto New = NewGuards.find(Key);
+  if (New != NewGuards.end())
+    return New->second.ModTime == (uint64_t)File->getModificationTime() &&
+                   New->second.Size == (uint64_t)File->getSize()
+               ? StringRef(New->second.Guard)
+               : StringRef();
+
+  if (!Guards)
+    return StringRef();
+  Table::iterator I = Guards->find(Key);
+  if (I == Guards->end())
+    return StringRef();
+  IncludeGuardTrait::GuardData Data = *I;
+  if (Data.ModTime != (uint64_t)File->getModificationTime() ||
+      Data.Size != (uint64_t)File->getSize())
+    return StringRef();
+  return Data.Guard;
+}
+
+void IncludeGuardCache::setGuard(const FileEntry *File, StringRef Guard) {
+  if (getGuard(File) == Guard || Guard.size() > UINT16_MAX - 16)
+    return;
+  StringRef Key = getKey(File);
+  if (Key.empty())
+    return;
+
+  NewGuard &New = NewGuards[Key];
+  New.ModTime = File->getModificationTime();
+  New.Size = File->getSize();
+  New.Guard = Guard;
+}
+
+bool IncludeGuardCache::save() {
+  if (NewGuards.empty())
+    return false;
+
+  // Merge with the current contents of the cache file, rather than with the
+  // ones this cache was opened with, so that the guards written by other
+  // compilations in the meantime are kept. The generator refers to the
+  // keys and guards of both, so they must outlive it.
+  llvm::OnDiskChainedHashTableGenerator<IncludeGuardTrait> Generator;
+  IncludeGuardTrait Trait;
+  std::unique_ptr<Table> Current = loadTable(CachePath);
+  if (Current) {
+    Table::key_iterator K = Current->key_begin();
+    for (Table::data_iterator D = Current->data_begin(),
+                              DEnd = Current->data_end();
+         D != DEnd; ++D, ++K)
+      if (!NewGuards.count(*K))
+        Generator.insert(*K, *D, Trait);
+  }
+  for (const auto &New : NewGuards) {
+    IncludeGuardTrait::GuardData Data = {New.second.ModTime, New.second.Size,
+                                         New.second.Guard};
+    Generator.insert(New.getKey(), Data, Trait);
+  }
+
+  bool Failed =
+      Table::save(CachePath, CacheMagic, CurrentVersion, Generator, Trait);
+  NewGuards.clear();
+  return Failed;
+}
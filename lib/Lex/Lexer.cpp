@@ -14,6 +14,7 @@
 #include "clang/Lex/Lexer.h"
 #include "UnicodeCharSets.h"
 #include "clang/Basic/CharInfo.h"
+#include "clang/Basic/CharScan.h"
 #include "clang/Basic/IdentifierTable.h"
 #include "clang/Basic/SourceManager.h"
 #include "clang/Lex/LexDiagnostic.h"
@@ -1505,11 +1506,19 @@ bool Lexer::tryConsumeIdentifierUTF8Char(const char *&CurPtr) {
 }
 
 bool Lexer::LexIdentifier(Token &Result, const char *CurPtr) {
-  // Match [_A-Za-z0-9]*, we have already matched [_A-Za-z$]
+  // Match [_A-Za-z0-9]*, we have already matched [_A-Za-z$]. Most
+  // identifiers are short, so only hand long ones to the vectorized scan.
   unsigned Size;
+  const char *ScalarEnd = CurPtr + 8;
   unsigned char C = *CurPtr++;
-  while (isIdentifierBody(C))
+  while (isIdentifierBody(C)) {
+    if (CurPtr == ScalarEnd) {
+      CurPtr = charscan::skipIdentifierBody(CurPtr, BufferEnd);
+      C = *CurPtr++;
+      break;
+    }
     C = *CurPtr++;
+  }
 
   --CurPtr;   // Back up over the skipped character.
 
@@ -2005,9 +2014,17 @@ bool Lexer::SkipWhitespace(Token &Result, const char *CurPtr,
 
   // Skip consecutive spaces efficiently.
   while (true) {
-    // Skip horizontal whitespace very aggressively.
-    while (isHorizontalWhitespace(Char))
-      Char = *++CurPtr;
+    // Skip horizontal whitespace very aggressively, using the vectorized scan
+    // for long runs such as deep indentation.
+    const char *ScalarEnd = CurPtr + 8;
+    while (isHorizontalWhitespace(Char)) {
+      if (++CurPtr == ScalarEnd) {
+        CurPtr = charscan::skipHorizontalWhitespace(CurPtr, BufferEnd);
+        Char = *CurPtr;
+        break;
+      }
+      Char = *CurPtr;
+    }
 
     // Otherwise if we have something other than whitespace, we're done.
     if (!isVerticalWhitespace(Char))
@@ -2334,27 +2351,25 @@ bool Lexer::SkipBlockComment(Token &Result, const char *CurPtr,
         // If there is a code-completion point avoid the fast scan because it
         // doesn't check for '\0'.
         !(PP && PP->getCodeCompletionFileLoc() == FileLoc)) {
+      if (C == '/') goto FoundSlash;
+
+#ifndef __ALTIVEC__
+      const char *Slash = charscan::findChar(CurPtr, BufferEnd, '/');
+      if (Slash != BufferEnd) {
+        // Adjust the pointer to point directly after the first slash. It's
+        // not necessary to set C here, it will be overwritten at the end of
+        // the outer loop.
+        CurPtr = Slash + 1;
+        goto FoundSlash;
+      }
+      CurPtr = BufferEnd;
+#else
       // While not aligned to a 16-byte boundary.
       while (C != '/' && ((intptr_t)CurPtr & 0x0F) != 0)
         C = *CurPtr++;
 
       if (C == '/') goto FoundSlash;
 
-#ifdef __SSE2__
-      __m128i Slashes = _mm_set1_epi8('/');
-      while (CurPtr+16 <= BufferEnd) {
-        int cmp = _mm_movemask_epi8(_mm_cmpeq_epi8(*(const __m128i*)CurPtr,
-                                    Slashes));
-        if (cmp != 0) {
-          // Adjust the pointer to point directly after the first slash. It's
-          // not necessary to set C here, it will be overwritten at the end of
-          // the outer loop.
-          CurPtr += llvm::countTrailingZeros<unsigned>(cmp) + 1;
-          goto FoundSlash;
-        }
-        CurPtr += 16;
-      }
-#elif __ALTIVEC__
       __vector unsigned char Slashes = {
         '/', '/', '/', '/',  '/', '/', '/', '/',
         '/', '/', '/', '/',  '/', '/', '/', '/'
@@ -2362,15 +2377,6 @@ bool Lexer::SkipBlockComment(Token &Result, const char *CurPtr,
       while (CurPtr+16 <= BufferEnd &&
              !vec_any_eq(*(const vector unsigned char*)CurPtr, Slashes))
         CurPtr += 16;
-#else
-      // Scan for '/' quickly.  Many block comments are very large.
-      while (CurPtr[0] != '/' &&
-             CurPtr[1] != '/' &&
-             CurPtr[2] != '/' &&
-             CurPtr[3] != '/' &&
-             CurPtr+4 < BufferEnd) {
-        CurPtr += 4;
-      }
 #endif
 
       // It has to be one of the bytes scanned, increment to it and read one.
@@ -2455,6 +2461,139 @@ bool Lexer::SkipBlockComment(Token &Result, const char *CurPtr,
   return false;
 }
 
+/// isExcludedTextSpecial - Return true if C is a character that
+/// SkipExcludedText has to look at: a newline, or the start of a comment,
+/// literal, escaped newline, trigraph or null character.
+static inline bool isExcludedTextSpecial(char C) {
+  switch (C) {
+  case '\n': case '\r': case '/': case '"': case '\'':
+  case '\\': case '?': case 0:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// findExcludedTextSpecial - Return a pointer to the first character at or
+/// after Ptr for which isExcludedTextSpecial is true. End must point to the
+/// null character that terminates the buffer.
+static const char *findExcludedTextSpecial(const char *Ptr, const char *End) {
+#ifdef __SSE2__
+  const __m128i NL = _mm_set1_epi8('\n');
+  const __m128i CR = _mm_set1_epi8('\r');
+  const __m128i Slash = _mm_set1_epi8('/');
+  const __m128i DQuote = _mm_set1_epi8('"');
+  const __m128i SQuote = _mm_set1_epi8('\'');
+  const __m128i Backslash = _mm_set1_epi8('\\');
+  const __m128i Question = _mm_set1_epi8('?');
+  const __m128i Zero = _mm_setzero_si128();
+  while (Ptr + 16 <= End) {
+    __m128i V = _mm_loadu_si128((const __m128i*)Ptr);
+    __m128i M = _mm_or_si128(
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(V, NL),
+                                  _mm_cmpeq_epi8(V, CR)),
+                     _mm_or_si128(_mm_cmpeq_epi8(V, Slash),
+                                  _mm_cmpeq_epi8(V, DQuote))),
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(V, SQuote),
+                                  _mm_cmpeq_epi8(V, Backslash)),
+                     _mm_or_si128(_mm_cmpeq_epi8(V, Question),
+                                  _mm_cmpeq_epi8(V, Zero))));
+    int Mask = _mm_movemask_epi8(M);
+    if (Mask != 0)
+      return Ptr + llvm::countTrailingZeros<unsigned>(Mask);
+    Ptr += 16;
+  }
+#endif
+
+  // The buffer is null terminated, so this always stops at End.
+  while (!isExcludedTextSpecial(*Ptr))
+    ++Ptr;
+  return Ptr;
+}
+
+void Lexer::SkipExcludedText() {
+  assert(LexingRawMode && !ParsingPreprocessorDirective &&
+         "Not skipping an excluded block?");
+  // The lexer keeps state across lines while handling a conflict marker; let
+  // it see every token.
+  if (CurrentConflictMarkerState != CMK_None)
+    return;
+
+  const char *CurPtr = BufferPtr;
+  bool AtStartOfLine = IsAtStartOfLine;
+
+  while (true) {
+    if (AtStartOfLine) {
+      // Skip leading whitespace and blank lines. A directive can only start
+      // with '#', or with its digraph or trigraph spellings, but a comment
+      // before it doesn't stop it from being at the start of the line.
+      while (isHorizontalWhitespace(*CurPtr) || *CurPtr == '\n' ||
+             *CurPtr == '\r')
+        ++CurPtr;
+      if (*CurPtr == '#' || *CurPtr == '%' || isExcludedTextSpecial(*CurPtr))
+        break;
+      AtStartOfLine = false;
+    }
+
+    // Find the next character in the middle of this line that matters.
+    const char *Start = CurPtr;
+    CurPtr = findExcludedTextSpecial(CurPtr, BufferEnd);
+    char C = *CurPtr;
+
+    if (C == '\n' || C == '\r') {
+      ++CurPtr;
+      AtStartOfLine = true;
+      continue;
+    }
+
+    if (C == '/') {
+      if (CurPtr[1] == '*' || CurPtr[1] == '/' || CurPtr[1] == '\\')
+        break;
+      ++CurPtr;
+      continue;
+    }
+
+    if (C == '?') {
+      if (CurPtr[1] == '?')
+        break;
+      ++CurPtr;
+      continue;
+    }
+
+    if (C == '\\') {
+      // A backslash directly followed by a newline continues the line.
+      if (CurPtr[1] == '\n' || CurPtr[1] == '\r') {
+        CurPtr += 2;
+        if ((CurPtr[0] == '\n' || CurPtr[0] == '\r') &&
+            CurPtr[0] != CurPtr[-1])
+          ++CurPtr;
+        continue;
+      }
+      break;
+    }
+
+    if (C == '"' || C == '\'') {
+      // Back up to the start of the identifier or number that the quote
+      // follows, so that the lexer sees encoding prefixes, raw string 
+      // literals and digit separators.
+      while (CurPtr != Start &&
+             (isIdentifierBody(CurPtr[-1], LangOpts.DollarIdents) ||
+              CurPtr[-1] == '.'))
+        --CurPtr;
+    }
+
+    // A literal or a null character.
+    break;
+  }
+
+  if (CurPtr == BufferPtr)
+    return;
+
+  BufferPtr = CurPtr;
+  IsAtStartOfLine = AtStartOfLine;
+  IsAtPhysicalStartOfLine = AtStartOfLine;
+}
+
 //===----------------------------------------------------------------------===//
 // Primary Lexing Entry Points
 //===----------------------------------------------------------------------===//
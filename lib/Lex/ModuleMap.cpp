@@ -2469,6 +2469,8 @@ bool ModuleMap::parseModuleMapFile(const FileEntry *File, bool IsSystem,
   assert(Target && "Missing target information");
   auto FileCharacter = IsSystem ? SrcMgr::C_System : SrcMgr::C_User;
   FileID ID = SourceMgr.createFileID(File, ExternModuleLoc, FileCharacter);
+  if (ID.isInvalid())
+    return ParsedModuleMap[File] = true;
   const llvm::MemoryBuffer *Buffer = SourceMgr.getBuffer(ID);
   if (!Buffer)
     return ParsedModuleMap[File] = true;
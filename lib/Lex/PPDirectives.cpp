@@ -399,6 +399,9 @@ void Preprocessor::SkipExcludedConditionalBlock(SourceLocation IfTokenLoc,
   CurPPLexer->LexingRawMode = true;
   Token Tok;
   while (true) {
+    // Most of an excluded block is text that can't contain a directive; skip
+    // over it without forming tokens.
+    CurLexer->SkipExcludedText();
     CurLexer->Lex(Tok);
 
     if (Tok.is(tok::code_completion)) {
@@ -2025,7 +2028,10 @@ void Preprocessor::HandleIncludeDirective(SourceLocation HashLoc,
   if (IncludePos.isMacroID())
     IncludePos = SourceMgr.getExpansionRange(IncludePos).second;
   FileID FID = SourceMgr.createFileID(File, IncludePos, FileCharacter);
-  assert(FID.isValid() && "Expected valid file ID");
+  // The file did not fit in the source location address space; the source
+  // manager has already emitted a fatal error.
+  if (FID.isInvalid())
+    return;
 
   // If all is good, enter the new file!
   if (EnterSourceFile(FID, CurDir, FilenameTok.getLocation()))
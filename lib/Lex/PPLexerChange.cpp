@@ -303,6 +303,10 @@ bool Preprocessor::HandleEndOfFile(Token &Result, bool isEndOfMacro) {
       // Okay, this has a controlling macro, remember in HeaderFileInfo.
       if (const FileEntry *FE = CurPPLexer->getFileEntry()) {
         HeaderInfo.SetFileControllingMacro(FE, ControllingMacro);
+        // The guard of a file whose contents were replaced only holds for
+        // this translation unit.
+        if (!SourceMgr.isFileOverridden(FE))
+          HeaderInfo.recordIncludeGuard(FE, ControllingMacro);
         if (MacroInfo *MI =
               getMacroInfo(const_cast<IdentifierInfo*>(ControllingMacro))) {
           MI->UsedForHeaderGuard = true;
@@ -534,8 +538,16 @@ bool Preprocessor::HandleEndOfTokenLexer(Token &Result) {
   else
     TokenLexerCache[NumCachedTokenLexers++] = std::move(CurTokenLexer);
 
-  // Handle this like a #include file being popped off the stack.
-  return HandleEndOfFile(Result, true);
+  // Pop the macro off the stack as HandleEndOfFile would, without going
+  // through the checks that only matter at the end of a file: there is
+  // always a lexer under a macro, and leaving a macro never leaves a file or
+  // a submodule.
+  assert(!IncludeMacroStack.empty() && "Macro expansion at the bottom?");
+  PopIncludeMacroStack();
+
+  // Propagate info about start-of-line/leading white-space/etc.
+  PropagateLineStartLeadingSpaceInfo(Result);
+  return false;
 }
 
 /// RemoveTopOfLexerStack - Pop the current lexer/macro exp off the top of the
@@ -543,6 +543,9 @@ void Preprocessor::EndSourceFile() {
   // Notify the client that we reached the end of the source file.
   if (Callbacks)
     Callbacks->EndOfMainFile();
+
+  // Share the include guards found with later translation units.
+  HeaderInfo.saveIncludeGuards();
 }
 
 //===----------------------------------------------------------------------===//
@@ -42,6 +42,7 @@ void TokenLexer::Init(Token &Tok, SourceLocation ELEnd, MacroInfo *MI,
   OwnsTokens = false;
   DisableMacroExpansion = false;
   NumTokens = Macro->tokens_end()-Macro->tokens_begin();
+  IsSimpleExpansion = Macro->isObjectLike() && !Macro->hasPasteOrComment();
   MacroExpansionStart = SourceLocation();
 
   SourceManager &SM = PP.getSourceManager();
@@ -89,6 +90,7 @@ void TokenLexer::Init(const Token *TokArray, unsigned NumToks,
   Tokens = TokArray;
   OwnsTokens = ownsTokens;
   DisableMacroExpansion = disableMacroExpansion;
+  IsSimpleExpansion = false;
   NumTokens = NumToks;
   CurToken = 0;
   ExpandLocStart = ExpandLocEnd = SourceLocation();
@@ -444,7 +446,7 @@ bool TokenLexer::Lex(Token &Tok) {
 
   // If this token is followed by a token paste (##) operator, paste the tokens!
   // Note that ## is a normal token when not expanding a macro.
-  if (!isAtEnd() && Macro &&
+  if (!IsSimpleExpansion && !isAtEnd() && Macro &&
       (Tokens[CurToken].is(tok::hashhash) ||
        // Special processing of L#x macros in -fms-compatibility mode.
        // Microsoft compiler is able to form a wide string literal from
@@ -464,9 +466,13 @@ bool TokenLexer::Lex(Token &Tok) {
   // diagnostics for the expanded token should appear as if they came from
   // ExpansionLoc.  Pull this information together into a new SourceLocation
   // that captures all of this.
-  if (ExpandLocStart.isValid() &&   // Don't do this for token streams.
-      // Check that the token's location was not already set properly.
-      SM.isBeforeInSLocAddrSpace(Tok.getLocation(), MacroStartSLocOffset)) {
+  if (IsSimpleExpansion) {
+    // All of the tokens are in the macro definition.
+    Tok.setLocation(getExpansionLocForMacroDefLoc(Tok.getLocation()));
+  } else if (ExpandLocStart.isValid() &&   // Don't do this for token streams.
+             // Check that the token's location was not already set properly.
+             SM.isBeforeInSLocAddrSpace(Tok.getLocation(),
+                                        MacroStartSLocOffset)) {
     SourceLocation instLoc;
     if (Tok.is(tok::comment)) {
       instLoc = SM.createExpansionLoc(Tok.getLocation(),
@@ -46,6 +46,13 @@ static inline bool isWhitespaceExceptNL(unsigned char c) {
   }
 }
 
+/// \brief Return the offset at which the 0-based line \p LineNo of \p FID
+/// starts.
+static unsigned getLineStartOffset(const SourceManager &SM, FileID FID,
+                                   unsigned LineNo) {
+  return SM.getFileOffset(SM.translateLineCol(FID, LineNo + 1, 1));
+}
+
 void RewriteBuffer::RemoveText(unsigned OrigOffset, unsigned Size,
                                bool removeLineIfEmpty) {
   // Nothing to remove, exit early.
@@ -246,9 +253,7 @@ bool Rewriter::InsertText(SourceLocation Loc, StringRef Str,
     StringRef MB = SourceMgr->getBufferData(FID);
 
     unsigned lineNo = SourceMgr->getLineNumber(FID, StartOffs) - 1;
-    const SrcMgr::ContentCache *
-        Content = SourceMgr->getSLocEntry(FID).getFile().getContentCache();
-    unsigned lineOffs = Content->SourceLineCache[lineNo];
+    unsigned lineOffs = getLineStartOffset(*SourceMgr, FID, lineNo);
 
     // Find the whitespace at the start of the line.
     StringRef indentSpace;
@@ -350,12 +355,9 @@ bool Rewriter::IncreaseIndentation(CharSourceRange range,
   unsigned startLineNo = SourceMgr->getLineNumber(FID, StartOff) - 1;
   unsigned endLineNo = SourceMgr->getLineNumber(FID, EndOff) - 1;
   
-  const SrcMgr::ContentCache *
-      Content = SourceMgr->getSLocEntry(FID).getFile().getContentCache();
-  
   // Find where the lines start.
-  unsigned parentLineOffs = Content->SourceLineCache[parentLineNo];
-  unsigned startLineOffs = Content->SourceLineCache[startLineNo];
+  unsigned parentLineOffs = getLineStartOffset(*SourceMgr, FID, parentLineNo);
+  unsigned startLineOffs = getLineStartOffset(*SourceMgr, FID, startLineNo);
 
   // Find the whitespace at the start of each line.
   StringRef parentSpace, startSpace;
@@ -380,7 +382,7 @@ bool Rewriter::IncreaseIndentation(CharSourceRange range,
   // Indent the lines between start/end offsets.
   RewriteBuffer &RB = getEditBuffer(FID);
   for (unsigned lineNo = startLineNo; lineNo <= endLineNo; ++lineNo) {
-    unsigned offs = Content->SourceLineCache[lineNo];
+    unsigned offs = getLineStartOffset(*SourceMgr, FID, lineNo);
     unsigned i = offs;
     while (isWhitespaceExceptNL(MB[i]))
       ++i;
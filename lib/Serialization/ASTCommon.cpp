@@ -17,6 +17,9 @@
 #include "clang/Basic/IdentifierTable.h"
 #include "clang/Serialization/ASTDeserializationListener.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Path.h"
 
 using namespace clang;
 
@@ -164,6 +167,22 @@ serialization::TypeIdxFromBuiltin(const BuiltinType *BT) {
   return TypeIdx(ID);
 }
 
+void serialization::getSharedFileContentsDir(StringRef ModuleFileName,
+                                             SmallVectorImpl<char> &Dir) {
+  // Module files are kept in a subdirectory of the module cache for each
+  // configuration, and the store sits next to those subdirectories.
+  StringRef ModuleDir = llvm::sys::path::parent_path(ModuleFileName);
+  StringRef ModuleCachePath = llvm::sys::path::parent_path(ModuleDir);
+  Dir.assign(ModuleCachePath.begin(), ModuleCachePath.end());
+  llvm::sys::path::append(Dir, "contents");
+}
+
+void serialization::getSharedFileContentsPath(StringRef Dir, StringRef Hash,
+                                              SmallVectorImpl<char> &Path) {
+  Path.assign(Dir.begin(), Dir.end());
+  llvm::sys::path::append(Path, Hash + ".contents");
+}
+
 unsigned serialization::ComputeHash(Selector Sel) {
   unsigned N = Sel.getNumArgs();
   if (N == 0)
@@ -175,6 +194,16 @@ unsigned serialization::ComputeHash(Selector Sel) {
   return R;
 }
 
+uint64_t serialization::ComputeInputFileContentHash(StringRef Contents) {
+  llvm::MD5 Hash;
+  Hash.update(Contents);
+  llvm::MD5::MD5Result Result;
+  Hash.final(Result);
+  // The first 64 bits of the digest are plenty to tell versions of a file
+  // apart.
+  return llvm::support::endian::read64le(Result);
+}
+
 const DeclContext *
 serialization::getDefinitiveDeclContext(const DeclContext *DC) {
   switch (DC->getDeclKind()) {
@@ -71,6 +71,24 @@ TypeID MakeTypeID(ASTContext &Context, QualType T, IdxForTypeTy IdxForType) {
 
 unsigned ComputeHash(Selector Sel);
 
+/// \brief Compute the hash of the contents of an input file that is stored in
+/// AST files by -fvalidate-ast-input-files-content. Unlike llvm::hash_value,
+/// it is the same on every host and in every execution.
+uint64_t ComputeInputFileContentHash(StringRef Contents);
+
+/// \brief Get the directory that holds the file contents shared by the
+/// modules in the same module cache as the module file \p ModuleFileName.
+///
+/// The store is found relative to the module file rather than through the
+/// module cache path, so that it is found however the module file is loaded.
+void getSharedFileContentsDir(StringRef ModuleFileName,
+                              SmallVectorImpl<char> &Dir);
+
+/// \brief Get the path of the file contents stored under \p Hash in the
+/// store of shared file contents in \p Dir.
+void getSharedFileContentsPath(StringRef Dir, StringRef Hash,
+                               SmallVectorImpl<char> &Path);
+
 /// \brief Retrieve the "definitive" declaration that provides all of the
 /// visible entries for the given declaration context, if there is one.
 ///
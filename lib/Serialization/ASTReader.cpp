@@ -74,6 +74,7 @@
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/SaveAndRestore.h"
@@ -1042,6 +1043,23 @@ void ASTDeclContextNameLookupTrait::ReadDataInto(internal_key_type,
   }
 }
 
+/// \brief Decompress the blob of a record that was written compressed into
+/// storage that lives as long as \p M, and point \p Blob at it.
+///
+/// \returns true if the blob could not be decompressed.
+static bool decompressBlob(ModuleFile &M, StringRef &Blob,
+                           uint64_t UncompressedSize) {
+  M.DecompressedBlobs.emplace_back();
+  SmallString<0> &Uncompressed = M.DecompressedBlobs.back();
+  if (llvm::zlib::uncompress(Blob, Uncompressed, UncompressedSize) !=
+      llvm::zlib::StatusOK) {
+    M.DecompressedBlobs.pop_back();
+    return true;
+  }
+  Blob = Uncompressed;
+  return false;
+}
+
 bool ASTReader::ReadLexicalDeclContextStorage(ModuleFile &M,
                                               BitstreamCursor &Cursor,
                                               uint64_t Offset,
@@ -1055,7 +1073,8 @@ bool ASTReader::ReadLexicalDeclContextStorage(ModuleFile &M,
   StringRef Blob;
   unsigned Code = Cursor.ReadCode();
   unsigned RecCode = Cursor.readRecord(Code, Record, &Blob);
-  if (RecCode != DECL_CONTEXT_LEXICAL) {
+  if (RecCode != DECL_CONTEXT_LEXICAL &&
+      RecCode != DECL_CONTEXT_LEXICAL_COMPRESSED) {
     Error("Expected lexical block");
     return true;
   }
@@ -1066,13 +1085,18 @@ bool ASTReader::ReadLexicalDeclContextStorage(ModuleFile &M,
   // lexical updates for the same record. It's important that we select only one
   // of them, so that field numbering works properly. Just pick the first one we
   // see.
-  auto &Lex = LexicalDecls[DC];
-  if (!Lex.first) {
-    Lex = std::make_pair(
-        &M, llvm::makeArrayRef(
-                reinterpret_cast<const llvm::support::unaligned_uint32_t *>(
-                    Blob.data()),
-                Blob.size() / 4));
+  if (!LexicalDecls.count(DC) && !CompressedLexicalDecls.count(DC)) {
+    // Most declaration contexts are never walked, so leave compressed
+    // contents alone until one is.
+    if (RecCode == DECL_CONTEXT_LEXICAL_COMPRESSED)
+      CompressedLexicalDecls[DC] = CompressedLexicalContents{&M, Blob,
+                                                             Record[0]};
+    else
+      LexicalDecls[DC] = std::make_pair(
+          &M, llvm::makeArrayRef(
+                  reinterpret_cast<const llvm::support::unaligned_uint32_t *>(
+                      Blob.data()),
+                  Blob.size() / 4));
   }
   DC->setHasExternalLexicalStorage(true);
   return false;
@@ -1091,6 +1115,12 @@ bool ASTReader::ReadVisibleDeclContextStorage(ModuleFile &M,
   StringRef Blob;
   unsigned Code = Cursor.ReadCode();
   unsigned RecCode = Cursor.readRecord(Code, Record, &Blob);
+  if (RecCode == DECL_CONTEXT_VISIBLE_COMPRESSED) {
+    // Leave the table compressed until the context is looked into.
+    PendingVisibleUpdates[ID].push_back(
+        PendingVisibleUpdate{&M, nullptr, Blob, Record[0]});
+    return false;
+  }
   if (RecCode != DECL_CONTEXT_VISIBLE) {
     Error("Expected visible lookup table block");
     return true;
@@ -1103,6 +1133,48 @@ bool ASTReader::ReadVisibleDeclContextStorage(ModuleFile &M,
   return false;
 }
 
+void ASTReader::loadCompressedLexicalDecls(const DeclContext *DC) {
+  auto I = CompressedLexicalDecls.find(DC);
+  if (I == CompressedLexicalDecls.end())
+    return;
+  CompressedLexicalContents Contents = I->second;
+  CompressedLexicalDecls.erase(I);
+
+  StringRef Blob = Contents.Blob;
+  if (decompressBlob(*Contents.Mod, Blob, Contents.UncompressedSize)) {
+    Error("could not decompress lexical block");
+    return;
+  }
+  LexicalDecls[DC] = std::make_pair(
+      Contents.Mod,
+      llvm::makeArrayRef(
+          reinterpret_cast<const llvm::support::unaligned_uint32_t *>(
+              Blob.data()),
+          Blob.size() / 4));
+}
+
+void ASTReader::loadCompressedLookupTables(const DeclContext *DC) {
+  auto I = PendingCompressedLookupTables.find(DC);
+  if (I == PendingCompressedLookupTables.end())
+    return;
+  auto Updates = std::move(I->second);
+  PendingCompressedLookupTables.erase(I);
+
+  auto &Table = Lookups[DC].Table;
+  for (PendingVisibleUpdate &Update : Updates) {
+    if (!Update.Data) {
+      StringRef Blob = Update.Compressed;
+      if (decompressBlob(*Update.Mod, Blob, Update.UncompressedSize)) {
+        Error("could not decompress visible lookup table block");
+        continue;
+      }
+      Update.Data = (const unsigned char *)Blob.data();
+    }
+    Table.add(Update.Mod, Update.Data,
+              reader::ASTDeclContextNameLookupTrait(*this, *Update.Mod));
+  }
+}
+
 void ASTReader::Error(StringRef Msg) {
   Error(diag::err_fe_pch_malformed, Msg);
   if (Context.getLangOpts().Modules && !Diags.isDiagnosticInFlight() &&
@@ -1270,7 +1342,7 @@ bool ASTReader::ReadSLocEntry(int ID) {
   // Local helper to read the (possibly-compressed) buffer data following the
   // entry record.
   auto ReadBuffer = [this](
-      BitstreamCursor &SLocEntryCursor,
+      ModuleFile &F, BitstreamCursor &SLocEntryCursor,
       StringRef Name) -> std::unique_ptr<llvm::MemoryBuffer> {
     RecordData Record;
     StringRef Blob;
@@ -1285,6 +1357,14 @@ bool ASTReader::ReadSLocEntry(int ID) {
         return nullptr;
       }
       return llvm::MemoryBuffer::getMemBufferCopy(Uncompressed, Name);
+    } else if (RecCode == SM_SLOC_BUFFER_BLOB_SHARED) {
+      const llvm::MemoryBuffer *Shared =
+          getSharedFileContents(F, Blob, Record[0]);
+      if (!Shared) {
+        Error("could not read shared file contents '" + Blob.str() + "'");
+        return nullptr;
+      }
+      return llvm::MemoryBuffer::getMemBuffer(Shared->getBuffer(), Name, true);
     } else if (RecCode == SM_SLOC_BUFFER_BLOB) {
       return llvm::MemoryBuffer::getMemBuffer(Blob.drop_back(1), Name, true);
     } else {
@@ -1355,7 +1435,7 @@ bool ASTReader::ReadSLocEntry(int ID) {
     if (OverriddenBuffer && !ContentCache->BufferOverridden &&
         ContentCache->ContentsEntry == ContentCache->OrigEntry &&
         !ContentCache->getRawBuffer()) {
-      auto Buffer = ReadBuffer(SLocEntryCursor, File->getName());
+      auto Buffer = ReadBuffer(*F, SLocEntryCursor, File->getName());
       if (!Buffer)
         return true;
       SourceMgr.overrideFileContents(File, std::move(Buffer));
@@ -1374,7 +1454,7 @@ bool ASTReader::ReadSLocEntry(int ID) {
       IncludeLoc = getImportLocation(F);
     }
 
-    auto Buffer = ReadBuffer(SLocEntryCursor, Name);
+    auto Buffer = ReadBuffer(*F, SLocEntryCursor, Name);
     if (!Buffer)
       return true;
     SourceMgr.createFileID(std::move(Buffer), FileCharacter, ID,
@@ -1812,6 +1892,10 @@ namespace {
 } // end anonymous namespace
 
 void ASTReader::updateOutOfDateIdentifier(IdentifierInfo &II) {
+  ProfiledLookupRAIIObj ProfileLookup(*this, [&] {
+    return "identifier '" + II.getName().str() + "'";
+  });
+
   // Note that we are loading an identifier.
   Deserializing AnIdentifier(this);
 
@@ -1981,9 +2065,62 @@ ASTReader::readInputFileInfo(ModuleFile &F, unsigned ID) {
   R.Transient = static_cast<bool>(Record[4]);
   R.Filename = Blob;
   ResolveImportedPath(F, R.Filename);
+
+  // The hash of the file's contents, if it was recorded, comes right after.
+  // Only look for it if it is going to be used.
+  R.ContentHash = 0;
+  if (PP.getHeaderSearchInfo()
+          .getHeaderSearchOpts()
+          .ValidateASTInputFilesContent) {
+    Code = Cursor.ReadCode();
+    if (Code != llvm::bitc::END_BLOCK) {
+      Record.clear();
+      if (Cursor.readRecord(Code, Record) == INPUT_FILE_HASH)
+        R.ContentHash = Record[0] | (Record[1] << 32);
+    }
+  }
   return R;
 }
 
+const llvm::MemoryBuffer *
+ASTReader::getSharedFileContents(ModuleFile &F, StringRef Hash,
+                                 uint64_t Size) {
+  SmallString<128> Dir, Path;
+  getSharedFileContentsDir(F.FileName, Dir);
+  getSharedFileContentsPath(Dir, Hash, Path);
+
+  // The store is compressed, so it saves space on disk but every reader still
+  // ends up with its own copy of the contents. Decompress each file once, so
+  // that at least the modules loaded by one reader share that copy.
+  std::unique_ptr<llvm::MemoryBuffer> &Buffer = SharedFileContents[Path];
+  if (!Buffer) {
+    auto BufferOrErr = llvm::MemoryBuffer::getFile(Path);
+    if (!BufferOrErr)
+      return nullptr;
+    SmallString<0> Uncompressed;
+    if (llvm::zlib::uncompress((*BufferOrErr)->getBuffer(), Uncompressed,
+                               Size) != llvm::zlib::StatusOK)
+      return nullptr;
+    Buffer = llvm::MemoryBuffer::getMemBufferCopy(Uncompressed);
+  }
+
+  if (Buffer->getBufferSize() != Size)
+    return nullptr;
+  return Buffer.get();
+}
+
+uint64_t ASTReader::getInputFileContentHash(const FileEntry *File) {
+  auto Known = InputFileContentHashes.find(File);
+  if (Known != InputFileContentHashes.end())
+    return Known->second;
+
+  uint64_t Hash = 0;
+  if (auto Buffer = FileMgr.getBufferForFile(File))
+    Hash = ComputeInputFileContentHash((*Buffer)->getBuffer());
+  InputFileContentHashes[File] = Hash;
+  return Hash;
+}
+
 InputFile ASTReader::getInputFile(ModuleFile &F, unsigned ID, bool Complain) {
   // If this ID is bogus, just return an empty input file.
   if (ID == 0 || ID > F.InputFilesLoaded.size())
@@ -2064,14 +2201,21 @@ InputFile ASTReader::getInputFile(ModuleFile &F, unsigned ID, bool Complain) {
                             StoredSize, StoredTime);
   }
 
+  auto HasInputFileChanged = [&]() {
+    if (StoredSize != File->getSize())
+      return true;
+    if (!StoredTime || StoredTime == File->getModificationTime() ||
+        DisableValidation)
+      return false;
+    // The modification time changed; if we know what the contents were,
+    // check whether they did too.
+    return !FI.ContentHash || FI.ContentHash != getInputFileContentHash(File);
+  };
+
   bool IsOutOfDate = false;
 
   // For an overridden file, there is nothing to validate.
-  if (!Overridden && //
-      (StoredSize != File->getSize() ||
-       (StoredTime && StoredTime != File->getModificationTime() &&
-        !DisableValidation)
-       )) {
+  if (!Overridden && HasInputFileChanged()) {
     if (Complain) {
       // Build a list of the PCH imports that got us here (in reverse).
       SmallVector<ModuleFile *, 4> ImportStack(1, &F);
@@ -2501,6 +2645,25 @@ ASTReader::ReadControlBlock(ModuleFile &F,
         return Result;
       break;
 
+    case SHARED_FILE_CONTENTS: {
+      // The file contents this module keeps in the shared store may have been
+      // pruned, or the module may have been copied without them. Either way,
+      // it has to be rebuilt before its source locations can be read.
+      SmallString<128> Dir;
+      getSharedFileContentsDir(F.FileName, Dir);
+      for (size_t I = 0; I + 32 <= Blob.size(); I += 32) {
+        SmallString<128> Path;
+        getSharedFileContentsPath(Dir, Blob.substr(I, 32), Path);
+        if (!llvm::sys::fs::exists(Path)) {
+          if ((ClientLoadCapabilities & ARR_OutOfDate) == 0)
+            Error("could not find shared file contents '" + Path.str().str() +
+                  "' referenced by AST file");
+          return OutOfDate;
+        }
+      }
+      break;
+    }
+
     case INPUT_FILE_OFFSETS:
       NumInputs = Record[0];
       NumUserInputs = Record[1];
@@ -3593,6 +3756,12 @@ ASTReader::ASTReadResult ASTReader::ReadAST(StringRef FileName,
     if (ASTReadResult Result = ReadASTBlock(F, ClientLoadCapabilities))
       return Result;
 
+    // Now that the source locations of the AST file are known, translate the
+    // ID of the file it was built from.
+    if (F.OriginalSourceFileID.isValid())
+      F.OriginalSourceFileID = FileID::get(
+          F.SLocEntryBaseID + F.OriginalSourceFileID.getOpaqueValue() - 1);
+
     // Read the extension blocks.
     while (!SkipCursorToBlock(F.Stream, EXTENSION_BLOCK_ID)) {
       if (ASTReadResult Result = ReadExtensionBlock(F))
@@ -3719,10 +3888,6 @@ ASTReader::ASTReadResult ASTReader::ReadAST(StringRef FileName,
 
   ModuleFile &PrimaryModule = ModuleMgr.getPrimaryModule();
   if (PrimaryModule.OriginalSourceFileID.isValid()) {
-    PrimaryModule.OriginalSourceFileID 
-      = FileID::get(PrimaryModule.SLocEntryBaseID
-                    + PrimaryModule.OriginalSourceFileID.getOpaqueValue() - 1);
-
     // If this AST file is a precompiled preamble, then set the
     // preamble file ID of the source manager to the file source file
     // from which the preamble was built.
@@ -3844,6 +4009,7 @@ ASTReader::ReadASTCore(StringRef FileName,
   }
 
   ModuleFile &F = *M;
+  ProfiledModuleRAIIObj ProfileLoad(*this, F);
   BitstreamCursor &Stream = F.Stream;
   PCHContainerRdr.ExtractPCH(F.Buffer->getMemBufferRef(), F.StreamFile);
   Stream.init(&F.StreamFile);
@@ -4168,7 +4334,8 @@ std::string ASTReader::getOriginalSourceFile(
     const std::string &ASTFileName, FileManager &FileMgr,
     const PCHContainerReader &PCHContainerRdr, DiagnosticsEngine &Diags) {
   // Open the AST file.
-  auto Buffer = FileMgr.getBufferForFile(ASTFileName);
+  auto Buffer = FileMgr.getBufferForFile(ASTFileName,
+                                         /*RequiresNullTerminator=*/false);
   if (!Buffer) {
     Diags.Report(diag::err_fe_unable_to_read_pch_file)
         << ASTFileName << Buffer.getError().message();
@@ -4272,7 +4439,8 @@ bool ASTReader::readASTFileControlBlock(
   // Open the AST file.
   // FIXME: This allows use of the VFS; we do not allow use of the
   // VFS when actually loading a module.
-  auto Buffer = FileMgr.getBufferForFile(Filename);
+  auto Buffer = FileMgr.getBufferForFile(Filename,
+                                         /*RequiresNullTerminator=*/false);
   if (!Buffer) {
     return true;
   }
@@ -4393,7 +4561,7 @@ bool ASTReader::readASTFileControlBlock(
         StringRef Blob;
         bool shouldContinue = false;
         switch ((InputFileRecordTypes)Cursor.readRecord(Code, Record, &Blob)) {
-        case INPUT_FILE:
+        case INPUT_FILE: {
           bool Overridden = static_cast<bool>(Record[3]);
           std::string Filename = Blob;
           ResolveImportedPath(Filename, ModuleDir);
@@ -4401,6 +4569,9 @@ bool ASTReader::readASTFileControlBlock(
               Filename, isSystemFile, Overridden, /*IsExplicitModule*/false);
           break;
         }
+        case INPUT_FILE_HASH:
+          break;
+        }
         if (!shouldContinue)
           break;
       }
@@ -5291,11 +5462,19 @@ QualType ASTReader::readTypeRecord(unsigned Index) {
   // Note that we are loading a type record.
   Deserializing AType(this);
 
+  ProfiledModuleRAIIObj ProfileRead(*this, *Loc.F);
+
   unsigned Idx = 0;
   DeclsCursor.JumpToBit(Loc.Offset);
   RecordData Record;
   unsigned Code = DeclsCursor.ReadCode();
-  switch ((TypeCode)DeclsCursor.readRecord(Code, Record)) {
+  TypeCode TC = (TypeCode)DeclsCursor.readRecord(Code, Record);
+  if (CollectModuleLoadProfile) {
+    ++Loc.F->Profile.NumTypesRead;
+    Loc.F->Profile.NumBitsRead += DeclsCursor.GetCurrentBitNo() - Loc.Offset;
+  }
+
+  switch (TC) {
   case TYPE_EXT_QUAL: {
     if (Record.size() != 2) {
       Error("Incorrect encoding of extended qualifier type");
@@ -6655,11 +6834,24 @@ Stmt *ASTReader::GetExternalDeclStmt(uint64_t Offset) {
   return ReadStmtFromStream(*Loc.F);
 }
 
+/// \brief Describes \p DC for the lookups of the module load profile.
+static std::string getLookupContextName(const DeclContext *DC) {
+  if (isa<TranslationUnitDecl>(DC))
+    return "the translation unit";
+  if (const NamedDecl *ND = dyn_cast<NamedDecl>(DC))
+    return "'" + ND->getQualifiedNameAsString() + "'";
+  return std::string(DC->getDeclKindName()) + " context";
+}
+
 void ASTReader::FindExternalLexicalDecls(
     const DeclContext *DC, llvm::function_ref<bool(Decl::Kind)> IsKindWeWant,
     SmallVectorImpl<Decl *> &Decls) {
   bool PredefsVisited[NUM_PREDEF_DECL_IDS] = {};
 
+  ProfiledLookupRAIIObj ProfileLookup(*this, [&] {
+    return "lexical declarations of " + getLookupContextName(DC);
+  });
+
   auto Visit = [&] (ModuleFile *M, LexicalContents LexicalDecls) {
     assert(LexicalDecls.size() % 2 == 0 && "expected an even number of entries");
     for (int I = 0, N = LexicalDecls.size(); I != N; I += 2) {
@@ -6690,6 +6882,7 @@ void ASTReader::FindExternalLexicalDecls(
     for (auto Lexical : TULexicalDecls)
       Visit(Lexical.first, Lexical.second);
   } else {
+    loadCompressedLexicalDecls(DC);
     auto I = LexicalDecls.find(DC);
     if (I != LexicalDecls.end())
       Visit(I->second.first, I->second.second);
@@ -6782,10 +6975,15 @@ ASTReader::FindExternalVisibleDeclsByName(const DeclContext *DC,
   if (!Name)
     return false;
 
+  loadCompressedLookupTables(DC);
   auto It = Lookups.find(DC);
   if (It == Lookups.end())
     return false;
 
+  ProfiledLookupRAIIObj ProfileLookup(*this, [&] {
+    return "name '" + Name.getAsString() + "' in " + getLookupContextName(DC);
+  });
+
   Deserializing LookupResults(this);
 
   // Load the list of declarations.
@@ -6805,10 +7003,15 @@ void ASTReader::completeVisibleDeclsMap(const DeclContext *DC) {
   if (!DC->hasExternalVisibleStorage())
     return;
 
+  loadCompressedLookupTables(DC);
   auto It = Lookups.find(DC);
   assert(It != Lookups.end() &&
          "have external visible storage but no lookup tables");
 
+  ProfiledLookupRAIIObj ProfileLookup(*this, [&] {
+    return "all names in " + getLookupContextName(DC);
+  });
+
   DeclsMap Decls;
 
   for (DeclID ID : It->second.Table.findAll()) {
@@ -6825,7 +7028,8 @@ void ASTReader::completeVisibleDeclsMap(const DeclContext *DC) {
 }
 
 const serialization::reader::DeclContextLookupTable *
-ASTReader::getLoadedLookupTables(DeclContext *Primary) const {
+ASTReader::getLoadedLookupTables(DeclContext *Primary) {
+  loadCompressedLookupTables(Primary);
   auto I = Lookups.find(Primary);
   return I == Lookups.end() ? nullptr : &I->second;
 }
@@ -6985,6 +7189,84 @@ void ASTReader::PrintStats() {
   std::fprintf(stderr, "\n");
 }
 
+void ASTReader::switchProfiledModule(ModuleFile *M) {
+  auto Now = std::chrono::steady_clock::now();
+  if (ProfiledModule)
+    ProfiledModule->Profile.ReadTime +=
+        std::chrono::duration<double>(Now - ProfiledModuleStartTime).count();
+  ProfiledModule = M;
+  ProfiledModuleStartTime = Now;
+}
+
+static const char *getModuleKindName(ModuleKind Kind) {
+  switch (Kind) {
+  case MK_ImplicitModule: return "implicit-module";
+  case MK_ExplicitModule: return "explicit-module";
+  case MK_PrebuiltModule: return "prebuilt-module";
+  case MK_PCH: return "pch";
+  case MK_Preamble: return "preamble";
+  case MK_MainFile: return "main-file";
+  }
+  llvm_unreachable("unknown module kind");
+}
+
+/// \brief Write \p Str to \p OS as a JSON string.
+static void writeJSONString(raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (unsigned char C : Str) {
+    if (C == '"' || C == '\\')
+      OS << '\\' << C;
+    else if (C < 0x20)
+      OS << "\\u00" << llvm::hexdigit(C >> 4) << llvm::hexdigit(C & 0xF);
+    else
+      OS << C;
+  }
+  OS << '"';
+}
+
+void ASTReader::writeModuleLoadProfile(raw_ostream &OS) {
+  OS << "{\n  \"modules\": [";
+  bool First = true;
+  for (ModuleFile *M : ModuleMgr) {
+    const ModuleFileProfile &Profile = M->Profile;
+    OS << (First ? "\n" : ",\n") << "    {\n";
+    First = false;
+
+    OS << "      \"file\": ";
+    writeJSONString(OS, M->FileName);
+    OS << ",\n      \"module\": ";
+    writeJSONString(OS, M->ModuleName);
+    OS << ",\n      \"kind\": \"" << getModuleKindName(M->Kind) << "\",\n"
+       << "      \"size\": " << M->SizeInBits / 8 << ",\n"
+       << "      \"read_time\": " << llvm::format("%.6f", Profile.ReadTime)
+       << ",\n"
+       << "      \"decls\": " << Profile.NumDeclsRead << ",\n"
+       << "      \"types\": " << Profile.NumTypesRead << ",\n"
+       << "      \"statements\": " << Profile.NumStatementsRead << ",\n"
+       << "      \"bytes_read\": " << (Profile.NumBitsRead + 7) / 8 << ",\n"
+       << "      \"lookups\": [";
+
+    // List the lookups that read the most declarations first.
+    SmallVector<std::pair<StringRef, unsigned>, 16> Lookups;
+    for (const auto &Lookup : Profile.DeclsReadByLookup)
+      Lookups.push_back(std::make_pair(Lookup.getKey(), Lookup.getValue()));
+    std::sort(Lookups.begin(), Lookups.end(),
+              [](const std::pair<StringRef, unsigned> &L,
+                 const std::pair<StringRef, unsigned> &R) {
+      if (L.second != R.second)
+        return L.second > R.second;
+      return L.first < R.first;
+    });
+    for (unsigned I = 0, N = Lookups.size(); I != N; ++I) {
+      OS << (I ? ",\n" : "\n") << "        { \"lookup\": ";
+      writeJSONString(OS, Lookups[I].first);
+      OS << ", \"decls\": " << Lookups[I].second << " }";
+    }
+    OS << (Lookups.empty() ? "" : "\n      ") << "]\n    }";
+  }
+  OS << (First ? "" : "\n  ") << "]\n}\n";
+}
+
 template<typename Key, typename ModuleFile, unsigned InitialCapacity>
 static void 
 dumpModuleIDMap(StringRef Name,
@@ -7102,6 +7384,10 @@ void ASTReader::UpdateSema() {
 }
 
 IdentifierInfo *ASTReader::get(StringRef Name) {
+  ProfiledLookupRAIIObj ProfileLookup(*this, [&] {
+    return "identifier '" + Name.str() + "'";
+  });
+
   // Note that we are loading an identifier.
   Deserializing AnIdentifier(this);
 
@@ -7329,11 +7615,25 @@ void ASTReader::ReadMethodPool(Selector Sel) {
   unsigned PriorGeneration = Generation;
   Generation = getGeneration();
   SelectorOutOfDate[Sel] = false;
+
+  ProfiledLookupRAIIObj ProfileLookup(*this, [&] {
+    return "selector '" + Sel.getAsString() + "'";
+  });
   
   // Search for methods defined with this selector.
   ++NumMethodPoolLookups;
   ReadMethodPoolVisitor Visitor(*this, Sel, PriorGeneration);
-  ModuleMgr.visit(Visitor);
+
+  // If there is a global index, look there first to skip the modules that
+  // provably do not have any methods with this selector.
+  GlobalModuleIndex::HitSet Hits;
+  GlobalModuleIndex::HitSet *HitsPtr = nullptr;
+  if (!loadGlobalIndex()) {
+    if (GlobalIndex->lookupSelector(Sel, Hits))
+      HitsPtr = &Hits;
+  }
+
+  ModuleMgr.visit(Visitor, HitsPtr);
 
   if (Visitor.getInstanceMethods().empty() &&
       Visitor.getFactoryMethods().empty())
@@ -8848,7 +9148,8 @@ ASTReader::ASTReader(
       Diags(PP.getDiagnostics()), SemaObj(nullptr), PP(PP), Context(Context),
       Consumer(nullptr), ModuleMgr(PP.getFileManager(), PCHContainerRdr),
       DummyIdResolver(PP),
-      ReadTimer(std::move(ReadTimer)),
+      ReadTimer(std::move(ReadTimer)), CollectModuleLoadProfile(false),
+      ProfiledModule(nullptr),
       PragmaMSStructState(-1),
       PragmaMSPointersToMembersState(-1),
       isysroot(isysroot), DisableValidation(DisableValidation),
@@ -1589,6 +1589,8 @@ void ASTDeclReader::MergeDefinitionData(
     MergeDD.Definition->IsCompleteDefinition = false;
     mergeDefinitionVisibility(DD.Definition, MergeDD.Definition);
     assert(Reader.Lookups.find(MergeDD.Definition) == Reader.Lookups.end() &&
+           Reader.PendingCompressedLookupTables.find(MergeDD.Definition) ==
+               Reader.PendingCompressedLookupTables.end() &&
            "already loaded pending lookups for merged definition");
   }
 
@@ -3244,6 +3246,8 @@ Decl *ASTReader::ReadDeclRecord(DeclID ID) {
   // Note that we are loading a declaration record.
   Deserializing ADecl(this);
 
+  ProfiledModuleRAIIObj ProfileRead(*this, *Loc.F);
+
   DeclsCursor.JumpToBit(Loc.Offset);
   RecordData Record;
   unsigned Code = DeclsCursor.ReadCode();
@@ -3254,6 +3258,8 @@ Decl *ASTReader::ReadDeclRecord(DeclID ID) {
   switch ((DeclCode)DeclsCursor.readRecord(Code, Record)) {
   case DECL_CONTEXT_LEXICAL:
   case DECL_CONTEXT_VISIBLE:
+  case DECL_CONTEXT_LEXICAL_COMPRESSED:
+  case DECL_CONTEXT_VISIBLE_COMPRESSED:
     llvm_unreachable("Record cannot be de-serialized with ReadDeclRecord");
   case DECL_TYPEDEF:
     D = TypedefDecl::CreateDeserialized(Context, ID);
@@ -3481,6 +3487,13 @@ Decl *ASTReader::ReadDeclRecord(DeclID ID) {
   }
 
   assert(D && "Unknown declaration reading AST file");
+  if (CollectModuleLoadProfile) {
+    ModuleFileProfile &Profile = Loc.F->Profile;
+    ++Profile.NumDeclsRead;
+    Profile.NumBitsRead += DeclsCursor.GetCurrentBitNo() - Loc.Offset;
+    ++Profile.DeclsReadByLookup[CurrentLookup.empty() ? "<other>"
+                                                      : CurrentLookup];
+  }
   LoadedDecl(Index, D);
   // Set the DeclContext before doing any deserialization, to make sure internal
   // calls to Decl::getASTContext() by Decl's methods will find the
@@ -3564,10 +3577,17 @@ void ASTReader::loadDeclUpdateRecords(serialization::DeclID ID, Decl *D) {
     PendingVisibleUpdates.erase(I);
 
     auto *DC = cast<DeclContext>(D)->getPrimaryContext();
-    for (const PendingVisibleUpdate &Update : VisibleUpdates)
-      Lookups[DC].Table.add(
-          Update.Mod, Update.Data,
-          reader::ASTDeclContextNameLookupTrait(*this, *Update.Mod));
+    for (const PendingVisibleUpdate &Update : VisibleUpdates) {
+      // Compressed tables are decompressed when the context is first looked
+      // into. Queue any table read after one behind it, so that the tables
+      // are still added in the order they were read.
+      if (!Update.Data || PendingCompressedLookupTables.count(DC))
+        PendingCompressedLookupTables[DC].push_back(Update);
+      else
+        Lookups[DC].Table.add(
+            Update.Mod, Update.Data,
+            reader::ASTDeclContextNameLookupTrait(*this, *Update.Mod));
+    }
     DC->setHasExternalVisibleStorage(true);
   }
 }
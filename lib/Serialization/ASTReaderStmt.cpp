@@ -2977,7 +2977,9 @@ Expr *ASTReader::ReadSubExpr() {
 Stmt *ASTReader::ReadStmtFromStream(ModuleFile &F) {
 
   ReadingKindTracker ReadingKind(Read_Stmt, *this);
+  ProfiledModuleRAIIObj ProfileRead(*this, F);
   llvm::BitstreamCursor &Cursor = F.DeclsCursor;
+  uint64_t StartBit = Cursor.GetCurrentBitNo();
   
   // Map of offset to previously deserialized stmt. The offset points
   /// just after the stmt record.
@@ -3933,6 +3935,8 @@ Stmt *ASTReader::ReadStmtFromStream(ModuleFile &F) {
       break;
 
     ++NumStatementsRead;
+    if (CollectModuleLoadProfile)
+      ++F.Profile.NumStatementsRead;
 
     if (S && !IsStmtReference) {
       Reader.Visit(S);
@@ -3944,6 +3948,8 @@ Stmt *ASTReader::ReadStmtFromStream(ModuleFile &F) {
     StmtStack.push_back(S);
   }
 Done:
+  if (CollectModuleLoadProfile)
+    F.Profile.NumBitsRead += Cursor.GetCurrentBitNo() - StartBit;
   assert(StmtStack.size() > PrevNumStmts && "Read too many sub-stmts!");
   assert(StmtStack.size() == PrevNumStmts + 1 && "Extra expressions on stack!");
   return StmtStack.pop_back_val();
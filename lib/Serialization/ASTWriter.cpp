@@ -37,6 +37,7 @@
 #include "clang/Basic/LLVM.h"
 #include "clang/Basic/Module.h"
 #include "clang/Basic/ObjCRuntime.h"
+#include "clang/Basic/OnDiskCacheFile.h"
 #include "clang/Basic/SourceManager.h"
 #include "clang/Basic/SourceManagerInternals.h"
 #include "clang/Basic/TargetInfo.h"
@@ -74,10 +75,13 @@
 #include "llvm/Support/Compression.h"
 #include "llvm/Support/EndianStream.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/OnDiskHashTable.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Process.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
@@ -88,6 +92,7 @@
 #include <limits>
 #include <new>
 #include <tuple>
+#include <thread>
 #include <utility>
 
 using namespace clang;
@@ -1002,6 +1007,7 @@ void ASTWriter::WriteBlockInfoBlock() {
   RECORD(SIGNATURE);
   RECORD(MODULE_NAME);
   RECORD(MODULE_DIRECTORY);
+  RECORD(SHARED_FILE_CONTENTS);
   RECORD(MODULE_MAP_FILE);
   RECORD(IMPORTS);
   RECORD(ORIGINAL_FILE);
@@ -1019,6 +1025,7 @@ void ASTWriter::WriteBlockInfoBlock() {
 
   BLOCK(INPUT_FILES_BLOCK);
   RECORD(INPUT_FILE);
+  RECORD(INPUT_FILE_HASH);
 
   // AST Top-Level Block.
   BLOCK(AST_BLOCK);
@@ -1076,6 +1083,7 @@ void ASTWriter::WriteBlockInfoBlock() {
   RECORD(SM_SLOC_BUFFER_ENTRY);
   RECORD(SM_SLOC_BUFFER_BLOB);
   RECORD(SM_SLOC_BUFFER_BLOB_COMPRESSED);
+  RECORD(SM_SLOC_BUFFER_BLOB_SHARED);
   RECORD(SM_SLOC_EXPANSION_ENTRY);
 
   // Preprocessor Block.
@@ -1180,6 +1188,8 @@ void ASTWriter::WriteBlockInfoBlock() {
   RECORD(DECL_BLOCK);
   RECORD(DECL_CONTEXT_LEXICAL);
   RECORD(DECL_CONTEXT_VISIBLE);
+  RECORD(DECL_CONTEXT_LEXICAL_COMPRESSED);
+  RECORD(DECL_CONTEXT_VISIBLE_COMPRESSED);
   RECORD(DECL_NAMESPACE);
   RECORD(DECL_NAMESPACE_ALIAS);
   RECORD(DECL_USING);
@@ -1409,6 +1419,22 @@ uint64_t ASTWriter::WriteControlBlock(Preprocessor &PP,
     Stream.EmitRecord(MODULE_MAP_FILE, Record);
   }
 
+  // Shared file contents
+  if (WritingModule) {
+    SmallString<256> Hashes;
+    for (const SLocBufferBlob &Blob : SLocBufferBlobs)
+      Hashes += Blob.SharedHash;
+    if (!Hashes.empty()) {
+      auto *Abbrev = new BitCodeAbbrev();
+      Abbrev->Add(BitCodeAbbrevOp(SHARED_FILE_CONTENTS));
+      Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Blob)); // Hashes
+      unsigned AbbrevCode = Stream.EmitAbbrev(Abbrev);
+
+      RecordData::value_type Record[] = {SHARED_FILE_CONTENTS};
+      Stream.EmitRecordWithBlob(AbbrevCode, Record, Hashes);
+    }
+  }
+
   // Imports
   if (Chain) {
     serialization::ModuleManager &Mgr = Chain->getModuleManager();
@@ -1628,6 +1654,7 @@ namespace  {
     bool IsSystemFile;
     bool IsTransient;
     bool BufferOverridden;
+    uint64_t ContentHash;
   };
 
 } // end anonymous namespace
@@ -1649,6 +1676,13 @@ void ASTWriter::WriteInputFiles(SourceManager &SourceMgr,
   IFAbbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Blob)); // File name
   unsigned IFAbbrevCode = Stream.EmitAbbrev(IFAbbrev);
 
+  // Create input file hash abbreviation.
+  auto *IFHAbbrev = new BitCodeAbbrev();
+  IFHAbbrev->Add(BitCodeAbbrevOp(INPUT_FILE_HASH));
+  IFHAbbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 32)); // Low bits
+  IFHAbbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 32)); // High bits
+  unsigned IFHAbbrevCode = Stream.EmitAbbrev(IFHAbbrev);
+
   // Get all ContentCache objects for files, sorted by whether the file is a
   // system one or not. System files go at the back, users files at the front.
   std::deque<InputFileEntry> SortedFiles;
@@ -1669,6 +1703,15 @@ void ASTWriter::WriteInputFiles(SourceManager &SourceMgr,
     Entry.IsSystemFile = Cache->IsSystemFile;
     Entry.IsTransient = Cache->IsTransient;
     Entry.BufferOverridden = Cache->BufferOverridden;
+    Entry.ContentHash = 0;
+    if (HSOpts.ValidateASTInputFilesContent && !Cache->BufferOverridden &&
+        !Cache->IsTransient) {
+      bool Invalid = false;
+      llvm::MemoryBuffer *Buffer = Cache->getBuffer(
+          SourceMgr.getDiagnostics(), SourceMgr, SourceLocation(), &Invalid);
+      if (!Invalid)
+        Entry.ContentHash = ComputeInputFileContentHash(Buffer->getBuffer());
+    }
     if (Cache->IsSystemFile)
       SortedFiles.push_back(Entry);
     else
@@ -1702,6 +1745,14 @@ void ASTWriter::WriteInputFiles(SourceManager &SourceMgr,
         Entry.IsTransient};
 
     EmitRecordWithPath(IFAbbrevCode, Record, Entry.File->getName());
+
+    // Emit the hash of the file's contents, if there is one, right after it.
+    if (Entry.ContentHash) {
+      RecordData::value_type HashRecord[] = {INPUT_FILE_HASH,
+                                             Entry.ContentHash & 0xFFFFFFFF,
+                                             Entry.ContentHash >> 32};
+      Stream.EmitRecordWithAbbrev(IFHAbbrevCode, HashRecord);
+    }
   }
 
   Stream.ExitBlock();
@@ -1762,13 +1813,12 @@ static unsigned CreateSLocBufferAbbrev(llvm::BitstreamWriter &Stream) {
 /// \brief Create an abbreviation for the SLocEntry that refers to a
 /// buffer's blob.
 static unsigned CreateSLocBufferBlobAbbrev(llvm::BitstreamWriter &Stream,
-                                           bool Compressed) {
+                                           unsigned Code) {
   using namespace llvm;
 
   auto *Abbrev = new BitCodeAbbrev();
-  Abbrev->Add(BitCodeAbbrevOp(Compressed ? SM_SLOC_BUFFER_BLOB_COMPRESSED
-                                         : SM_SLOC_BUFFER_BLOB));
-  if (Compressed)
+  Abbrev->Add(BitCodeAbbrevOp(Code));
+  if (Code != SM_SLOC_BUFFER_BLOB)
     Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 8)); // Uncompressed size
   Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Blob)); // Blob
   return Stream.EmitAbbrev(Abbrev);
@@ -1980,6 +2030,113 @@ void ASTWriter::WriteHeaderSearch(const HeaderSearch &HS) {
     free(const_cast<char *>(SavedStrings[I]));
 }
 
+/// \brief The smallest buffer that is worth keeping in the store of shared
+/// file contents, rather than in the module itself.
+static const size_t MinSharedBufferSize = 1024;
+
+/// \brief The total size of the buffers to compress below which it is not
+/// worth starting threads to compress them.
+static const size_t MinParallelCompressionSize = 1 << 20;
+
+void ASTWriter::SLocBufferBlob::compress() {
+  IsCompressed = llvm::zlib::compress(Contents, Compressed) ==
+                 llvm::zlib::StatusOK;
+}
+
+/// \brief Keep the compressed contents in the shared store in \p StoreDir,
+/// under the hash of the contents, unless an identical buffer is already
+/// there.
+void ASTWriter::SLocBufferBlob::share(StringRef StoreDir) {
+  llvm::MD5 Hash;
+  Hash.update(Contents);
+  llvm::MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Name;
+  llvm::MD5::stringifyResult(Result, Name);
+
+  SmallString<128> Path;
+  getSharedFileContentsPath(StoreDir, Name, Path);
+  if (!llvm::sys::fs::exists(Path) && writeFileAtomically(Path, Compressed))
+    return;
+  SharedHash = Name;
+}
+
+/// \brief Whether the contents of \p Content are written out with its
+/// source location entry, rather than being read from its input file.
+static bool emitsBufferBlob(const SrcMgr::ContentCache *Content) {
+  return !Content->OrigEntry || Content->BufferOverridden ||
+         Content->IsTransient;
+}
+
+/// \brief Prepare the buffers that are written out with the source manager
+/// block, before the control block is written.
+void ASTWriter::PrepareSourceManagerBlobs(SourceManager &SourceMgr,
+                                          const Preprocessor &PP,
+                                          StringRef OutputFile) {
+  // Compress the buffers that are written out ahead of time. Usually these
+  // are only a few small buffers (the predefines, remapped files), but with
+  // -fmodules-embed-all-files every input of the module is embedded, and
+  // compressing them is where most of the time in the source manager block
+  // goes. The buffers are independent of each other, so compress them in
+  // parallel once there is enough work to pay for the threads. They are
+  // still emitted in order, so the output does not depend on how the work
+  // was scheduled.
+  //
+  // With -fmodules-share-file-contents, the larger buffers of a module in the
+  // module cache go to the store shared by all of the modules there instead.
+  // Readers find the store relative to the module file, so modules written
+  // anywhere else keep their buffers. So do modules written without a module
+  // hash: they sit directly in the module cache, and the store would end up
+  // beside it, where nothing prunes it.
+  SmallString<128> StoreDir;
+  const HeaderSearch &HS = PP.getHeaderSearchInfo();
+  const HeaderSearchOptions &HSOpts = HS.getHeaderSearchOpts();
+  if (WritingModule && HSOpts.ModulesShareFileContents &&
+      !HSOpts.DisableModuleHash && !HS.getModuleCachePath().empty()) {
+    FileManager &FileMgr = PP.getFileManager();
+    const DirectoryEntry *CacheDir =
+        FileMgr.getDirectory(HS.getModuleCachePath());
+    if (CacheDir &&
+        FileMgr.getDirectory(llvm::sys::path::parent_path(OutputFile)) ==
+            CacheDir) {
+      getSharedFileContentsDir(OutputFile, StoreDir);
+      if (llvm::sys::fs::create_directories(StoreDir))
+        StoreDir.clear();
+    }
+  }
+
+  std::vector<SLocBufferBlob> &Blobs = SLocBufferBlobs;
+  Blobs.clear();
+  size_t TotalSize = 0;
+  for (unsigned I = 1, N = SourceMgr.local_sloc_entry_size(); I != N; ++I) {
+    const SrcMgr::SLocEntry &SLoc = SourceMgr.getLocalSLocEntry(I);
+    if (!SLoc.isFile() || !emitsBufferBlob(SLoc.getFile().getContentCache()))
+      continue;
+    const llvm::MemoryBuffer *Buffer =
+        SLoc.getFile().getContentCache()->getBuffer(PP.getDiagnostics(),
+                                                    PP.getSourceManager());
+    Blobs.emplace_back();
+    Blobs.back().Contents = Buffer->getBuffer();
+    TotalSize += Buffer->getBufferSize();
+  }
+  auto ProcessBlob = [&StoreDir](SLocBufferBlob &Blob) {
+    Blob.compress();
+    if (Blob.IsCompressed && !StoreDir.empty() &&
+        Blob.Contents.size() >= MinSharedBufferSize)
+      Blob.share(StoreDir);
+  };
+  if (Blobs.size() > 1 && TotalSize >= MinParallelCompressionSize) {
+    llvm::ThreadPool Pool(std::min<unsigned>(
+        Blobs.size(), std::max(1u, std::thread::hardware_concurrency())));
+    for (SLocBufferBlob &Blob : Blobs)
+      Pool.async([&ProcessBlob, &Blob] { ProcessBlob(Blob); });
+    Pool.wait();
+  } else {
+    for (SLocBufferBlob &Blob : Blobs)
+      ProcessBlob(Blob);
+  }
+}
+
 /// \brief Writes the block containing the serialized form of the
 /// source manager.
 ///
@@ -1998,11 +2155,19 @@ void ASTWriter::WriteSourceManagerBlock(SourceManager &SourceMgr,
   // Abbreviations for the various kinds of source-location entries.
   unsigned SLocFileAbbrv = CreateSLocFileAbbrev(Stream);
   unsigned SLocBufferAbbrv = CreateSLocBufferAbbrev(Stream);
-  unsigned SLocBufferBlobAbbrv = CreateSLocBufferBlobAbbrev(Stream, false);
+  unsigned SLocBufferBlobAbbrv =
+      CreateSLocBufferBlobAbbrev(Stream, SM_SLOC_BUFFER_BLOB);
   unsigned SLocBufferBlobCompressedAbbrv =
-      CreateSLocBufferBlobAbbrev(Stream, true);
+      CreateSLocBufferBlobAbbrev(Stream, SM_SLOC_BUFFER_BLOB_COMPRESSED);
+  unsigned SLocBufferBlobSharedAbbrv =
+      CreateSLocBufferBlobAbbrev(Stream, SM_SLOC_BUFFER_BLOB_SHARED);
   unsigned SLocExpansionAbbrv = CreateSLocExpansionAbbrev(Stream);
 
+  // The buffers were prepared before the control block was written.
+  std::vector<SLocBufferBlob> Blobs;
+  Blobs.swap(SLocBufferBlobs);
+  unsigned NextBlob = 0;
+
   // Write out the source location entry table. We skip the first
   // entry, which is always the same dummy entry.
   std::vector<uint32_t> SLocEntryOffsets;
@@ -2040,7 +2205,6 @@ void ASTWriter::WriteSourceManagerBlock(SourceManager &SourceMgr,
       Record.push_back(File.hasLineDirectives());
 
       const SrcMgr::ContentCache *Content = File.getContentCache();
-      bool EmitBlob = false;
       if (Content->OrigEntry) {
         assert(Content->OrigEntry == Content->ContentsEntry &&
                "Writing to AST an overridden file is not supported");
@@ -2061,9 +2225,6 @@ void ASTWriter::WriteSourceManagerBlock(SourceManager &SourceMgr,
         }
         
         Stream.EmitRecordWithAbbrev(SLocFileAbbrv, Record);
-        
-        if (Content->BufferOverridden || Content->IsTransient)
-          EmitBlob = true;
       } else {
         // The source location entry is a buffer. The blob associated
         // with this entry contains the contents of the buffer.
@@ -2076,32 +2237,35 @@ void ASTWriter::WriteSourceManagerBlock(SourceManager &SourceMgr,
         const char *Name = Buffer->getBufferIdentifier();
         Stream.EmitRecordWithBlob(SLocBufferAbbrv, Record,
                                   StringRef(Name, strlen(Name) + 1));
-        EmitBlob = true;
 
         if (strcmp(Name, "<built-in>") == 0) {
           PreloadSLocs.push_back(SLocEntryOffsets.size());
         }
       }
 
-      if (EmitBlob) {
-        // Include the implicit terminating null character in the on-disk buffer
-        // if we're writing it uncompressed.
-        const llvm::MemoryBuffer *Buffer =
-            Content->getBuffer(PP.getDiagnostics(), PP.getSourceManager());
-        StringRef Blob(Buffer->getBufferStart(), Buffer->getBufferSize() + 1);
-
-        // Compress the buffer if possible. We expect that almost all PCM
-        // consumers will not want its contents.
-        SmallString<0> CompressedBuffer;
-        if (llvm::zlib::compress(Blob.drop_back(1), CompressedBuffer) ==
-            llvm::zlib::StatusOK) {
+      if (emitsBufferBlob(Content)) {
+        assert(NextBlob < Blobs.size() && "Missed buffer blob");
+        const SLocBufferBlob &Blob = Blobs[NextBlob++];
+
+        // Write the buffer compressed if possible. We expect that almost all
+        // PCM consumers will not want its contents.
+        if (!Blob.SharedHash.empty()) {
+          RecordData::value_type Record[] = {SM_SLOC_BUFFER_BLOB_SHARED,
+                                             Blob.Contents.size()};
+          Stream.EmitRecordWithBlob(SLocBufferBlobSharedAbbrv, Record,
+                                    Blob.SharedHash);
+        } else if (Blob.IsCompressed) {
           RecordData::value_type Record[] = {SM_SLOC_BUFFER_BLOB_COMPRESSED,
-                                             Blob.size() - 1};
+                                             Blob.Contents.size()};
           Stream.EmitRecordWithBlob(SLocBufferBlobCompressedAbbrv, Record,
-                                    CompressedBuffer);
+                                    Blob.Compressed);
         } else {
+          // Include the implicit terminating null character in the on-disk
+          // buffer if we're writing it uncompressed.
           RecordData::value_type Record[] = {SM_SLOC_BUFFER_BLOB};
-          Stream.EmitRecordWithBlob(SLocBufferBlobAbbrv, Record, Blob);
+          Stream.EmitRecordWithBlob(
+              SLocBufferBlobAbbrv, Record,
+              StringRef(Blob.Contents.data(), Blob.Contents.size() + 1));
         }
       }
     } else {
@@ -2859,6 +3023,30 @@ void ASTWriter::WriteType(QualType T) {
 // Declaration Serialization
 //===----------------------------------------------------------------------===//
 
+/// \brief The smallest declaration context blob that is worth compressing.
+static const size_t MinCompressedDeclContextBlobSize = 256;
+
+/// \brief Emit a record with the blob of a declaration context, compressed
+/// if -fcompress-ast-files was given and that makes it smaller.
+void ASTWriter::EmitDeclContextBlob(unsigned Code, unsigned Abbrev,
+                                    unsigned CompressedCode,
+                                    unsigned CompressedAbbrev,
+                                    StringRef Blob) {
+  if (PP->getHeaderSearchInfo().getHeaderSearchOpts().CompressASTFiles &&
+      Blob.size() >= MinCompressedDeclContextBlobSize) {
+    SmallString<0> Compressed;
+    if (llvm::zlib::compress(Blob, Compressed) == llvm::zlib::StatusOK &&
+        Compressed.size() < Blob.size()) {
+      RecordData::value_type Record[] = {CompressedCode, Blob.size()};
+      Stream.EmitRecordWithBlob(CompressedAbbrev, Record, Compressed);
+      return;
+    }
+  }
+
+  RecordData::value_type Record[] = {Code};
+  Stream.EmitRecordWithBlob(Abbrev, Record, Blob);
+}
+
 /// \brief Write the block containing all of the declaration IDs
 /// lexically declared within the given DeclContext.
 ///
@@ -2877,9 +3065,9 @@ uint64_t ASTWriter::WriteDeclContextLexicalBlock(ASTContext &Context,
   }
 
   ++NumLexicalDeclContexts;
-  RecordData::value_type Record[] = {DECL_CONTEXT_LEXICAL};
-  Stream.EmitRecordWithBlob(DeclContextLexicalAbbrev, Record,
-                            bytes(KindDeclPairs));
+  EmitDeclContextBlob(DECL_CONTEXT_LEXICAL, DeclContextLexicalAbbrev,
+                      DECL_CONTEXT_LEXICAL_COMPRESSED,
+                      DeclContextLexicalCompressedAbbrev, bytes(KindDeclPairs));
   return Offset;
 }
 
@@ -3892,9 +4080,9 @@ uint64_t ASTWriter::WriteDeclContextVisibleBlock(ASTContext &Context,
   GenerateNameLookupTable(DC, LookupTable);
 
   // Write the lookup table
-  RecordData::value_type Record[] = {DECL_CONTEXT_VISIBLE};
-  Stream.EmitRecordWithBlob(DeclContextVisibleLookupAbbrev, Record,
-                            LookupTable);
+  EmitDeclContextBlob(DECL_CONTEXT_VISIBLE, DeclContextVisibleLookupAbbrev,
+                      DECL_CONTEXT_VISIBLE_COMPRESSED,
+                      DeclContextVisibleLookupCompressedAbbrev, LookupTable);
   ++NumVisibleDeclContexts;
   return Offset;
 }
@@ -4193,7 +4381,9 @@ ASTWriter::ASTWriter(
       NumLexicalDeclContexts(0), NumVisibleDeclContexts(0),
       TypeExtQualAbbrev(0), TypeFunctionProtoAbbrev(0), DeclParmVarAbbrev(0),
       DeclContextLexicalAbbrev(0), DeclContextVisibleLookupAbbrev(0),
-      UpdateVisibleAbbrev(0), DeclRecordAbbrev(0), DeclTypedefAbbrev(0),
+      DeclContextLexicalCompressedAbbrev(0),
+      DeclContextVisibleLookupCompressedAbbrev(0), UpdateVisibleAbbrev(0),
+      DeclRecordAbbrev(0), DeclTypedefAbbrev(0),
       DeclVarAbbrev(0), DeclFieldAbbrev(0), DeclEnumAbbrev(0),
       DeclObjCIvarAbbrev(0), DeclCXXMethodAbbrev(0), DeclRefExprAbbrev(0),
       CharacterLiteralAbbrev(0), IntegerLiteralAbbrev(0),
@@ -4403,7 +4593,9 @@ uint64_t ASTWriter::WriteASTCore(Sema &SemaRef, StringRef isysroot,
     }
   }
 
-  // Write the control block
+  // Write the control block, which lists the file contents kept in the
+  // store of shared file contents.
+  PrepareSourceManagerBlobs(Context.getSourceManager(), PP, OutputFile);
   uint64_t Signature = WriteControlBlock(PP, Context, isysroot, OutputFile);
 
   // Write the remaining AST contents.
@@ -11,6 +11,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "ASTCommon.h"
 #include "ASTReaderInternals.h"
 #include "clang/Frontend/PCHContainerOperations.h"
 #include "clang/Basic/FileManager.h"
@@ -50,7 +51,9 @@ namespace {
     /// \brief Describes a module, including its file name and dependencies.
     MODULE,
     /// \brief The index for identifiers.
-    IDENTIFIER_INDEX
+    IDENTIFIER_INDEX,
+    /// \brief The Bloom filter over the selectors of a module.
+    SELECTOR_FILTER
   };
 }
 
@@ -58,7 +61,24 @@ namespace {
 static const char * const IndexFileName = "modules.idx";
 
 /// \brief The global index file version.
-static const unsigned CurrentVersion = 1;
+static const unsigned CurrentVersion = 2;
+
+/// \brief The number of bits of a module's selector filter that are set for
+/// each of its selectors.
+static const unsigned SelectorFilterNumProbes = 7;
+
+/// \brief The size of a module's selector filter, in bits per selector. With
+/// SelectorFilterNumProbes, this gives a false positive rate around 1%.
+static const unsigned SelectorFilterBitsPerSelector = 10;
+
+/// \brief Returns the bit of a selector filter of \p NumBits bits that is
+/// set by the \p Probe'th probe for a selector with the given hash.
+static uint32_t getSelectorFilterBit(uint32_t Hash, unsigned Probe,
+                                     uint32_t NumBits) {
+  // Derive the probes from the one hash by double hashing.
+  uint32_t Step = ((Hash >> 16) | (Hash << 16)) | 1;
+  return (Hash + Probe * Step) % NumBits;
+}
 
 //----------------------------------------------------------------------------//
 // Global module index reader.
@@ -126,7 +146,8 @@ typedef llvm::OnDiskIterableChainedHashTable<IdentifierIndexReaderTrait>
 GlobalModuleIndex::GlobalModuleIndex(std::unique_ptr<llvm::MemoryBuffer> Buffer,
                                      llvm::BitstreamCursor Cursor)
     : Buffer(std::move(Buffer)), IdentifierIndex(), NumIdentifierLookups(),
-      NumIdentifierLookupHits() {
+      NumIdentifierLookupHits(), NumSelectorLookups(),
+      NumSelectorLookupModuleHits() {
   // Read the global index.
   bool InGlobalIndexBlock = false;
   bool Done = false;
@@ -224,6 +245,13 @@ GlobalModuleIndex::GlobalModuleIndex(std::unique_ptr<llvm::MemoryBuffer> Buffer,
             (const unsigned char *)Blob.data(), IdentifierIndexReaderTrait());
       }
       break;
+
+    case SELECTOR_FILTER:
+      // The filter of a module described above.
+      if (Record.size() < 1 || Record[0] >= Modules.size())
+        return;
+      Modules[Record[0]].SelectorFilter = Blob;
+      break;
     }
   }
 }
@@ -240,7 +268,8 @@ GlobalModuleIndex::readIndex(StringRef Path) {
   llvm::sys::path::append(IndexPath, IndexFileName);
 
   llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> BufferOrErr =
-      llvm::MemoryBuffer::getFile(IndexPath.c_str());
+      llvm::MemoryBuffer::getFile(IndexPath.c_str(), /*FileSize=*/-1,
+                                  /*RequiresNullTerminator=*/false);
   if (!BufferOrErr)
     return std::make_pair(nullptr, EC_NotFound);
   std::unique_ptr<llvm::MemoryBuffer> Buffer = std::move(BufferOrErr.get());
@@ -317,6 +346,36 @@ bool GlobalModuleIndex::lookupIdentifier(StringRef Name, HitSet &Hits) {
   return true;
 }
 
+bool GlobalModuleIndex::lookupSelector(Selector Sel, HitSet &Hits) {
+  Hits.clear();
+
+  ++NumSelectorLookups;
+  uint32_t Hash = serialization::ComputeHash(Sel);
+  for (const ModuleInfo &Info : Modules) {
+    if (!Info.File || Info.SelectorFilter.empty())
+      continue;
+
+    const unsigned char *Filter =
+        (const unsigned char *)Info.SelectorFilter.data();
+    uint32_t NumBits = Info.SelectorFilter.size() * 8;
+    bool MightContain = true;
+    for (unsigned Probe = 0; Probe != SelectorFilterNumProbes; ++Probe) {
+      uint32_t Bit = getSelectorFilterBit(Hash, Probe, NumBits);
+      if (!(Filter[Bit / 8] & (1 << (Bit % 8)))) {
+        MightContain = false;
+        break;
+      }
+    }
+
+    if (MightContain) {
+      Hits.insert(Info.File);
+      ++NumSelectorLookupModuleHits;
+    }
+  }
+
+  return true;
+}
+
 bool GlobalModuleIndex::loadedModuleFile(ModuleFile *File) {
   // Look for the module in the global module index based on the module name.
   StringRef Name = File->ModuleName;
@@ -351,6 +410,12 @@ void GlobalModuleIndex::printStats() {
             NumIdentifierLookupHits, NumIdentifierLookups,
             (double)NumIdentifierLookupHits*100.0/NumIdentifierLookups);
   }
+  if (NumSelectorLookups) {
+    fprintf(stderr, "  %u selector lookups, %f module files searched per "
+                    "lookup\n",
+            NumSelectorLookups,
+            (double)NumSelectorLookupModuleHits / NumSelectorLookups);
+  }
   std::fprintf(stderr, "\n");
 }
 
@@ -380,6 +445,9 @@ namespace {
     /// \brief The set of modules on which this module depends. Each entry is
     /// a module ID.
     SmallVector<unsigned, 4> Dependencies;
+
+    /// \brief The hashes of the selectors in this module's method pool.
+    std::vector<uint32_t> SelectorHashes;
   };
 
   /// \brief Builder that generates the global module index file.
@@ -468,6 +536,7 @@ GlobalModuleIndexBuilder::emitBlockInfoBlock(llvm::BitstreamWriter &Stream) {
   RECORD(INDEX_METADATA);
   RECORD(MODULE);
   RECORD(IDENTIFIER_INDEX);
+  RECORD(SELECTOR_FILTER);
 #undef RECORD
 #undef BLOCK
 
@@ -495,6 +564,37 @@ namespace {
   };
 }
 
+/// \brief Collect the hashes of the selectors in the method pool table of a
+/// module file, without resolving the selectors themselves.
+///
+/// \param Base The start of the table's blob.
+/// \param Buckets The table's buckets, preceded by their counts.
+static void collectSelectorHashes(const unsigned char *Base,
+                                  const unsigned char *Buckets,
+                                  std::vector<uint32_t> &Hashes) {
+  using namespace llvm::support;
+  typedef serialization::reader::ASTSelectorLookupTrait Trait;
+
+  uint32_t NumBuckets = endian::readNext<uint32_t, little, aligned>(Buckets);
+  uint32_t NumEntries = endian::readNext<uint32_t, little, aligned>(Buckets);
+  Hashes.reserve(Hashes.size() + NumEntries);
+  for (uint32_t B = 0; B != NumBuckets; ++B) {
+    uint32_t Offset = endian::readNext<uint32_t, little, aligned>(Buckets);
+    if (!Offset)
+      continue;
+
+    const unsigned char *Items = Base + Offset;
+    unsigned Len = endian::readNext<uint16_t, little, unaligned>(Items);
+    for (unsigned I = 0; I != Len; ++I) {
+      Hashes.push_back(endian::readNext<Trait::hash_value_type, little,
+                                        unaligned>(Items));
+      std::pair<unsigned, unsigned> KeyDataLen =
+          Trait::ReadKeyDataLength(Items);
+      Items += KeyDataLen.first + KeyDataLen.second;
+    }
+  }
+}
+
 bool GlobalModuleIndexBuilder::loadModuleFile(const FileEntry *File) {
   // Open the module file.
 
@@ -638,6 +738,13 @@ bool GlobalModuleIndexBuilder::loadModuleFile(const FileEntry *File) {
       }
     }
 
+    // Handle the method pool.
+    if (State == ASTBlock && Code == METHOD_POOL && Record[0] > 0) {
+      collectSelectorHashes((const unsigned char *)Blob.data(),
+                            (const unsigned char *)Blob.data() + Record[0],
+                            getModuleFileInfo(File).SelectorHashes);
+    }
+
     // We don't care about this record.
   }
 
@@ -761,6 +868,37 @@ void GlobalModuleIndexBuilder::writeIndex(llvm::BitstreamWriter &Stream) {
     Stream.EmitRecordWithBlob(IDTableAbbrev, Record, IdentifierTable);
   }
 
+  // Write the selector filter of each module file that has a method pool.
+  {
+    BitCodeAbbrev *Abbrev = new BitCodeAbbrev();
+    Abbrev->Add(BitCodeAbbrevOp(SELECTOR_FILTER));
+    Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Module ID
+    Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Blob));   // Filter bits
+    unsigned FilterAbbrev = Stream.EmitAbbrev(Abbrev);
+
+    for (ModuleFilesMap::iterator M = ModuleFiles.begin(),
+                                  MEnd = ModuleFiles.end();
+         M != MEnd; ++M) {
+      const std::vector<uint32_t> &Hashes = M->second.SelectorHashes;
+      if (Hashes.empty())
+        continue;
+
+      SmallString<256> Filter;
+      Filter.resize(
+          (Hashes.size() * SelectorFilterBitsPerSelector + 7) / 8, '\0');
+      uint32_t NumBits = Filter.size() * 8;
+      for (uint32_t Hash : Hashes) {
+        for (unsigned Probe = 0; Probe != SelectorFilterNumProbes; ++Probe) {
+          uint32_t Bit = getSelectorFilterBit(Hash, Probe, NumBits);
+          Filter[Bit / 8] |= 1 << (Bit % 8);
+        }
+      }
+
+      uint64_t Record[] = {SELECTOR_FILTER, M->second.ID};
+      Stream.EmitRecordWithBlob(FilterAbbrev, Record, Filter);
+    }
+  }
+
   Stream.ExitBlock();
 }
 
@@ -120,9 +120,14 @@ ModuleManager::addModule(StringRef FileName, ModuleKind Type,
         // ModuleManager it must be the same underlying file.
         // FIXME: Because FileManager::getFile() doesn't guarantee that it will
         // give us an open file, this may not be 100% reliable.
+        //
+        // The reader never looks past the end of the file, so it does not
+        // need a null terminator; without one, the file is always mapped
+        // rather than read, and only the pages that are used get loaded.
         Buf = FileMgr.getBufferForFile(ModuleEntry->File,
                                        /*IsVolatile=*/false,
-                                       /*ShouldClose=*/false);
+                                       /*ShouldClose=*/false,
+                                       /*RequiresNullTerminator=*/false);
       }
 
       if (!Buf) {
@@ -0,0 +1,49 @@
+// Tests for Checked C rewriter tool.
+//
+// Checks that -cache-dir reuses the constraints gathered for a file on later
+// runs, and that entries are not used once they are out of date or damaged.
+//
+// RUN: rm -rf %t && mkdir -p %t
+// RUN: cp %s %t/cache.c
+//
+// The first run has nothing to load, and writes an entry.
+// RUN: checked-c-convert -verbose -cache-dir=%t/cache %t/cache.c -- 2>&1 | FileCheck -check-prefix=MISS -check-prefix=CHECK -match-full-lines %s
+// MISS-NOT: Loaded constraints for {{.*}}
+// MISS: Wrote constraint cache entry for {{.*}}cache.c
+//
+// The second run loads the entry and doesn't analyze the file again, but
+// the file is rewritten in the same way.
+// RUN: checked-c-convert -verbose -cache-dir=%t/cache %t/cache.c -- 2>&1 | FileCheck -check-prefix=HIT -check-prefix=CHECK -match-full-lines %s
+// HIT: Loaded constraints for {{.*}}cache.c from cache
+// HIT-NOT: Wrote constraint cache entry for {{.*}}
+//
+// Entries are keyed by the compile command and the analysis options.
+// RUN: checked-c-convert -verbose -cache-dir=%t/cache %t/cache.c -- -DUNUSED 2>&1 | FileCheck -check-prefix=MISS -check-prefix=CHECK -match-full-lines %s
+// RUN: checked-c-convert -verbose -context-sensitive -cache-dir=%t/cache %t/cache.c -- 2>&1 | FileCheck -check-prefix=MISS -check-prefix=CHECK -match-full-lines %s
+//
+// A damaged entry is ignored and replaced.
+// RUN: rm -rf %t/cache
+// RUN: checked-c-convert -cache-dir=%t/cache %t/cache.c -- > /dev/null
+// RUN: sed '$d' %t/cache/*.cache > %t/truncated
+// RUN: cp %t/truncated %t/cache/*.cache
+// RUN: checked-c-convert -verbose -cache-dir=%t/cache %t/cache.c -- 2>&1 | FileCheck -check-prefix=MISS -check-prefix=CHECK -match-full-lines %s
+// RUN: checked-c-convert -verbose -cache-dir=%t/cache %t/cache.c -- 2>&1 | FileCheck -check-prefix=HIT -check-prefix=CHECK -match-full-lines %s
+//
+// Changing the file makes its entry out of date.
+// RUN: echo "int *extra;" >> %t/cache.c
+// RUN: checked-c-convert -verbose -cache-dir=%t/cache %t/cache.c -- 2>&1 | FileCheck -check-prefix=CHANGED -check-prefix=CHECK -match-full-lines %s
+// CHANGED: Constraint cache entry for {{.*}}cache.c is out of date: {{.*}}cache.c has changed
+// CHANGED-NOT: Loaded constraints for {{.*}}
+// CHANGED: Wrote constraint cache entry for {{.*}}cache.c
+
+void set(int *a, int b) {
+  *a = b;
+}
+//CHECK: void set(_Ptr<int>  a, int b) {
+
+void f(void) {
+  int x = 0;
+  int *p = &x;
+  set(p, 1);
+}
+//CHECK: _Ptr<int> p = &x;
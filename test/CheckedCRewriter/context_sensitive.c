@@ -0,0 +1,53 @@
+// Tests for Checked C rewriter tool.
+//
+// Checks that with -context-sensitive, an unchecked argument at one call
+// site doesn't make the parameter, or the arguments at other call sites,
+// unchecked.
+//
+// RUN: checked-c-convert -context-sensitive %s -- | FileCheck -match-full-lines %s
+// RUN: checked-c-convert -context-sensitive %s -- | %clang_cc1 -verify -fcheckedc-extension -x c -
+// expected-no-diagnostics
+
+void set(int *a, int b) {
+  *a = b;
+}
+//CHECK: void set(_Ptr<int>  a, int b) {
+//CHECK-NEXT: *a = b;
+
+void good_caller(void) {
+  int u = 0;
+  int *v = &u;
+  set(v, 1);
+}
+//CHECK: void good_caller(void) {
+//CHECK-NEXT: int u = 0;
+//CHECK-NEXT: _Ptr<int> v = &u;
+//CHECK-NEXT: set(v, 1);
+
+void bad_caller(void) {
+  int u[2] = { 0, 0 };
+  int *v = u;
+  v++;
+  set(v, 1);
+}
+//CHECK: void bad_caller(void) {
+//CHECK-NEXT: int u[2] = { 0, 0 };
+//CHECK-NEXT: int *v = u;
+//CHECK-NEXT: v++;
+//CHECK-NEXT: set((_Ptr<int>)(v), 1);
+
+void walk(int *a, int n) {
+  *(a + n) = 0;
+}
+//CHECK: void walk(int *a, int n) {
+//CHECK-NEXT: *(a + n) = 0;
+
+void walk_caller(void) {
+  int u = 0;
+  int *v = &u;
+  walk(v, 0);
+}
+//CHECK: void walk_caller(void) {
+//CHECK-NEXT: int u = 0;
+//CHECK-NEXT: int *v = &u;
+//CHECK-NEXT: walk(v, 0);
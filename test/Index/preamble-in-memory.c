@@ -0,0 +1,33 @@
+// RUN: env CINDEXTEST_EDITING=1 CINDEXTEST_PREAMBLE_IN_MEMORY=1 \
+// RUN:     CINDEXTEST_FAILONERROR=1 \
+// RUN:   c-index-test -test-load-source-reparse 3 local %s 2>&1 | FileCheck %s
+// RUN: env CINDEXTEST_EDITING=1 CINDEXTEST_PREAMBLE_IN_MEMORY=1 \
+// RUN:     CINDEXTEST_CHAINED_PREAMBLE=1 CINDEXTEST_REMAP_AFTER_TRIAL=2 \
+// RUN:     CINDEXTEST_FAILONERROR=1 \
+// RUN:   c-index-test -test-load-source-reparse 4 local \
+// RUN:     "-remap-file=%s,%S/preamble-layers.c.remap" %s 2>&1 | FileCheck %s
+//
+// The preamble is dropped while the AST that was built with it is still in
+// use, by a reparse and by code completion.
+// RUN: env CINDEXTEST_EDITING=1 CINDEXTEST_PREAMBLE_IN_MEMORY=1 \
+// RUN:     CINDEXTEST_REMAP_AFTER_TRIAL=2 CINDEXTEST_FAILONERROR=1 \
+// RUN:   c-index-test -test-load-source-reparse 4 local \
+// RUN:     "-remap-file=%s,%s.remap" %s 2>&1 \
+// RUN:   | FileCheck -check-prefix=NO-PREAMBLE %s
+// RUN: env CINDEXTEST_EDITING=1 CINDEXTEST_PREAMBLE_IN_MEMORY=1 \
+// RUN:   c-index-test -code-completion-at=%s:1:22 \
+// RUN:     "-remap-file=%s,%s.remap" %s \
+// RUN:   | FileCheck -check-prefix=COMPLETE %s
+
+#include "preamble-layers.c-1.h"
+#include "preamble-layers.c-2.h"
+
+int f(void) { return one() + two; }
+
+// CHECK-NOT: error:
+// CHECK: FunctionDecl=f:{{[0-9]+}}:5 (Definition)
+
+// NO-PREAMBLE-NOT: error:
+// NO-PREAMBLE: FunctionDecl=f:1:5 (Definition)
+
+// COMPLETE: FunctionDecl:{ResultType int}{TypedText f}{LeftParen (}{RightParen )}
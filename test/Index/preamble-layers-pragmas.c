@@ -0,0 +1,24 @@
+#define X 1
+#pragma push_macro("X")
+#undef X
+#define X 2
+#include "preamble-layers.c-1.h"
+#pragma pop_macro("X")
+#include "preamble-layers.c-2.h"
+#define THREE 3
+
+_Static_assert(X == 1, "X was not restored");
+int f(void) { return one() + two + THREE; }
+
+// The saved definition of X is not kept in a precompiled header, so the
+// preamble is not split between push_macro and pop_macro.
+// RUN: env CINDEXTEST_EDITING=1 CINDEXTEST_CHAINED_PREAMBLE=1 \
+// RUN:     CINDEXTEST_FAILONERROR=1 LIBCLANG_TIMING=1 \
+// RUN:   c-index-test -test-load-source-reparse 2 local %s 2>&1 > /dev/null \
+// RUN:   | FileCheck %s
+
+// CHECK-NOT: error:
+// CHECK: Precompiling preamble layer 1:
+// CHECK-NEXT: Precompiling preamble layer 2:
+// CHECK-NOT: Precompiling preamble layer 3:
+// CHECK-NOT: error:
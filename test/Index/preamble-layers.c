@@ -0,0 +1,49 @@
+#define ONE one()
+#include "preamble-layers.c-1.h"
+#include "preamble-layers.c-2.h"
+
+int f(void) { return ONE + two; }
+
+// RUN: env CINDEXTEST_EDITING=1 CINDEXTEST_CHAINED_PREAMBLE=1 \
+// RUN:     CINDEXTEST_REMAP_AFTER_TRIAL=2 CINDEXTEST_FAILONERROR=1 \
+// RUN:   c-index-test -test-load-source-reparse 4 local \
+// RUN:     "-remap-file=%s,%s.remap" %s 2>&1 | FileCheck %s
+
+// CHECK-NOT: error:
+// CHECK: FunctionDecl=f:5:5 (Definition)
+
+// The remapped file only changes the second layer, so the first one is
+// reused.
+// RUN: env CINDEXTEST_EDITING=1 CINDEXTEST_CHAINED_PREAMBLE=1 \
+// RUN:     CINDEXTEST_REMAP_AFTER_TRIAL=2 LIBCLANG_TIMING=1 \
+// RUN:   c-index-test -test-load-source-reparse 4 local \
+// RUN:     "-remap-file=%s,%s.remap" %s 2>&1 > /dev/null \
+// RUN:   | FileCheck -check-prefix=TIMING %s
+
+// The same, with the preamble kept in memory under the same name on every
+// rebuild.
+// RUN: env CINDEXTEST_EDITING=1 CINDEXTEST_CHAINED_PREAMBLE=1 \
+// RUN:     CINDEXTEST_PREAMBLE_IN_MEMORY=1 \
+// RUN:     CINDEXTEST_PREAMBLE_FILE=%t-preamble.pch \
+// RUN:     CINDEXTEST_REMAP_AFTER_TRIAL=2 LIBCLANG_TIMING=1 \
+// RUN:   c-index-test -test-load-source-reparse 4 local \
+// RUN:     "-remap-file=%s,%s.remap" %s 2>&1 > /dev/null \
+// RUN:   | FileCheck -check-prefix=TIMING %s
+
+// TIMING: Parsing
+// TIMING: Precompiling preamble layer 1:
+// TIMING-NEXT: Precompiling preamble layer 2:
+// TIMING: Reparsing
+// TIMING-NOT: Precompiling preamble layer 1:
+// TIMING: Precompiling preamble layer 2:
+// TIMING-NOT: Precompiling preamble layer 1:
+
+// The preprocessed entities of the main file are found in every layer.
+// RUN: env CINDEXTEST_EDITING=1 CINDEXTEST_CHAINED_PREAMBLE=1 \
+// RUN:   c-index-test -cursor-at=%s:1:9 -cursor-at=%s:2:2 -cursor-at=%s:3:2 \
+// RUN:     -cursor-at=%s:5:22 %s | FileCheck -check-prefix=CURSOR %s
+
+// CURSOR: 1:9 macro definition=ONE
+// CURSOR: 2:1 inclusion directive=preamble-layers.c-1.h
+// CURSOR: 3:1 inclusion directive=preamble-layers.c-2.h
+// CURSOR: 5:22 macro expansion=ONE:1:9
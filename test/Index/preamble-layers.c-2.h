@@ -0,0 +1 @@
+#define two 2
@@ -0,0 +1,3 @@
+namespace ns {
+inline int twice(int x) { return x * 2; }
+}
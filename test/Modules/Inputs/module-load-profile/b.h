@@ -0,0 +1,2 @@
+#include "a.h"
+inline int forty_two() { return ns::twice(21); }
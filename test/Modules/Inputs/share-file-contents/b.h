@@ -0,0 +1 @@
+#include "t.h"
@@ -0,0 +1,26 @@
+// This header is shared by modules a and b. It is long enough for its
+// contents to be kept in the store of shared file contents when the modules
+// are built with -fmodules-embed-all-files -fmodules-share-file-contents.
+extern int t;
+
+// Padding to make the header larger than the smallest shared buffer.
+// ................................................................
+// ................................................................
+// ................................................................
+// ................................................................
+// ................................................................
+// ................................................................
+// ................................................................
+// ................................................................
+// ................................................................
+// ................................................................
+// ................................................................
+// ................................................................
+// ................................................................
+// ................................................................
+// ................................................................
+// ................................................................
+// ................................................................
+// ................................................................
+// ................................................................
+// ................................................................
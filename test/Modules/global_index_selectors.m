@@ -0,0 +1,17 @@
+// RUN: rm -rf %t
+// Create the global module index
+// RUN: %clang_cc1 -fmodules-cache-path=%t -fdisable-module-hash -fmodules -fimplicit-module-maps -F %S/Inputs %s -verify
+// RUN: ls %t|grep modules.idx
+// Use its selector filters to find the module files with methods
+// RUN: %clang_cc1 -fmodules-cache-path=%t -fdisable-module-hash -fmodules -fimplicit-module-maps -F %S/Inputs %s -verify -print-stats 2>&1 | FileCheck %s
+
+// expected-no-diagnostics
+@import DependsOnModule;
+@import Module;
+
+const char *get_version(id M) {
+  return [M version];
+}
+
+// CHECK: *** Global Module Index Statistics:
+// CHECK: selector lookups, {{.*}} module files searched per lookup
@@ -0,0 +1,26 @@
+// Test that a module is built when the process that held the lock on it
+// released the lock without writing the module file.
+@import Waited;
+
+// We need backticks and a background process for this test to work.
+// REQUIRES: shell
+
+// RUN: rm -rf %t
+// RUN: mkdir -p %t/include
+// RUN: echo 'module Waited { header "waited.h" }' > %t/include/module.modulemap
+// RUN: echo 'extern int waited;' > %t/include/waited.h
+//
+// Build the module once to find out where its module file goes.
+// RUN: %clang_cc1 -fmodules -fimplicit-module-maps -fmodules-cache-path=%t/cache -I %t/include %s -verify
+// RUN: find %t/cache -name 'Waited-*.pcm' > %t/pcm
+//
+// Lock the module on behalf of the running shell, as if it were building it,
+// and release the lock without writing the module file while the compiler
+// waits for it.
+// RUN: rm `cat %t/pcm`
+// RUN: echo "`hostname` $$" > `cat %t/pcm`.lock
+// RUN: (sleep 2; rm -f `cat %t/pcm`.lock) > /dev/null 2>&1 & %clang_cc1 -fmodules -fimplicit-module-maps -fmodules-cache-path=%t/cache -I %t/include %s -verify
+// RUN: test -f `cat %t/pcm`
+
+// expected-no-diagnostics
+int *use = &waited;
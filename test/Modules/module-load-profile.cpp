@@ -0,0 +1,35 @@
+// RUN: rm -rf %t
+// RUN: %clang_cc1 -fmodules -fimplicit-module-maps -fmodules-cache-path=%t -I %S/Inputs/module-load-profile %s -emit-llvm -o %t.ll -verify -module-load-profile=%t.json
+// RUN: FileCheck %s < %t.json
+// expected-no-diagnostics
+
+#include "b.h"
+
+int test() { return ns::twice(forty_two()); }
+
+// CHECK:      {
+// CHECK-NEXT:   "modules": [
+// CHECK-NEXT:     {
+// CHECK-NEXT:       "file": "{{.*}}B-{{[^"]*}}.pcm",
+// CHECK-NEXT:       "module": "B",
+// CHECK-NEXT:       "kind": "implicit-module",
+// CHECK-NEXT:       "size": {{[1-9][0-9]*}},
+// CHECK-NEXT:       "read_time": {{[0-9]+\.[0-9]+}},
+// CHECK-NEXT:       "decls": {{[1-9][0-9]*}},
+// CHECK-NEXT:       "types": {{[0-9]+}},
+// CHECK-NEXT:       "statements": {{[1-9][0-9]*}},
+// CHECK-NEXT:       "bytes_read": {{[1-9][0-9]*}},
+// CHECK-NEXT:       "lookups": [
+// CHECK-NEXT:         { "lookup": "{{[^"]+}}", "decls": {{[1-9][0-9]*}} }
+// CHECK:          ]
+// CHECK-NEXT:     },
+// CHECK-NEXT:     {
+// CHECK-NEXT:       "file": "{{.*}}A-{{[^"]*}}.pcm",
+// CHECK-NEXT:       "module": "A",
+// CHECK-NEXT:       "kind": "implicit-module",
+// CHECK:            "lookups": [
+// CHECK:            { "lookup": "name 'twice' in 'ns'", "decls": {{[1-9][0-9]*}} }
+// CHECK:          ]
+// CHECK-NEXT:     }
+// CHECK-NEXT:   ]
+// CHECK-NEXT: }
@@ -0,0 +1,29 @@
+// REQUIRES: shell
+// RUN: rm -rf %t
+// RUN: %clang_cc1 -fmodules -fimplicit-module-maps -fmodules-cache-path=%t -fmodules-embed-all-files -fmodules-share-file-contents -I %S/Inputs/share-file-contents %s -verify
+// RUN: ls %t/contents | grep '^[0-9a-f]\{32\}\.contents$'
+//
+// Read the modules back from the cache.
+// RUN: %clang_cc1 -fmodules -fimplicit-module-maps -fmodules-cache-path=%t -fmodules-embed-all-files -fmodules-share-file-contents -I %S/Inputs/share-file-contents %s -verify
+//
+// The store is found next to the module files, not through the module cache
+// path of the compilation that loads them.
+// RUN: %clang_cc1 -fmodules -fimplicit-module-maps -fno-implicit-modules -fmodule-file=`find %t -name 'a-*.pcm'` -fmodule-file=`find %t -name 'b-*.pcm'` -I %S/Inputs/share-file-contents %s -verify
+//
+// Modules whose shared file contents are gone are rebuilt.
+// RUN: rm -rf %t/contents
+// RUN: %clang_cc1 -fmodules -fimplicit-module-maps -fmodules-cache-path=%t -fmodules-embed-all-files -fmodules-share-file-contents -I %S/Inputs/share-file-contents %s -verify
+// RUN: ls %t/contents | grep '^[0-9a-f]\{32\}\.contents$'
+//
+// Without a module hash the modules sit directly in the module cache, and
+// they keep their own buffers rather than putting a store next to the cache.
+// RUN: rm -rf %t-nohash
+// RUN: %clang_cc1 -fmodules -fimplicit-module-maps -fmodules-cache-path=%t-nohash/cache -fdisable-module-hash -fmodules-embed-all-files -fmodules-share-file-contents -I %S/Inputs/share-file-contents %s -verify
+// RUN: ls %t-nohash/cache/a.pcm %t-nohash/cache/b.pcm
+// RUN: not ls %t-nohash/contents
+// RUN: not ls %t-nohash/cache/contents
+// RUN: %clang_cc1 -fmodules -fimplicit-module-maps -fno-implicit-modules -fmodule-file=%t-nohash/cache/a.pcm -fmodule-file=%t-nohash/cache/b.pcm -I %S/Inputs/share-file-contents %s -verify
+#include "a.h"
+char t; // expected-error {{different type}}
+// expected-note@t.h:4 {{here}}
+#include "b.h"
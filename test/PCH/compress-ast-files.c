@@ -0,0 +1,28 @@
+// Test that declaration contexts stored compressed with -fcompress-ast-files
+// can be read back.
+
+// RUN: %clang_cc1 -fcompress-ast-files -emit-pch -o %t %s
+// RUN: %clang_cc1 -include-pch %t -fsyntax-only -verify %s
+// RUN: llvm-bcanalyzer -dump %t | FileCheck %s
+
+#ifndef HEADER
+#define HEADER
+
+#define FIELDS(P) \
+  int P##0; int P##1; int P##2; int P##3; int P##4; \
+  int P##5; int P##6; int P##7; int P##8; int P##9;
+
+struct S {
+  FIELDS(a) FIELDS(b) FIELDS(c) FIELDS(d) FIELDS(e)
+  FIELDS(f) FIELDS(g) FIELDS(h) FIELDS(i) FIELDS(j)
+};
+
+#else
+
+int get(struct S *s) { return s->a0 + s->j9; }
+int bad(struct S *s) { return s->k0; } // expected-error {{no member named 'k0' in 'struct S'}}
+
+#endif
+
+// CHECK: <DECL_CONTEXT_LEXICAL_COMPRESSED
+// CHECK: <DECL_CONTEXT_VISIBLE_COMPRESSED
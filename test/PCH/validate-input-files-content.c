@@ -0,0 +1,25 @@
+// Test that -fvalidate-ast-input-files-content accepts an input file whose
+// modification time changed but whose contents did not.
+
+// RUN: rm -rf %t && mkdir %t
+// RUN: echo 'int foo(void);' > %t/a.h
+// RUN: touch -m -a -t 201008011501 %t/a.h
+// RUN: %clang_cc1 -fvalidate-ast-input-files-content -x c-header -emit-pch -o %t/a.pch %t/a.h
+// RUN: llvm-bcanalyzer -dump %t/a.pch | FileCheck -check-prefix=CHECK-BITCODE %s
+
+// Only the modification time changed.
+// RUN: touch -m -a -t 201008011502 %t/a.h
+// RUN: %clang_cc1 -fvalidate-ast-input-files-content -include-pch %t/a.pch -fsyntax-only %s
+// RUN: not %clang_cc1 -include-pch %t/a.pch -fsyntax-only %s 2>&1 | FileCheck %s
+
+// The contents changed too, but not the size.
+// RUN: echo 'int bar(void);' > %t/a.h
+// RUN: touch -m -a -t 201008011503 %t/a.h
+// RUN: not %clang_cc1 -fvalidate-ast-input-files-content -include-pch %t/a.pch -fsyntax-only %s 2>&1 | FileCheck %s
+
+void g(void) { foo(); }
+
+// CHECK-BITCODE: <INPUT_FILE abbrevid=
+// CHECK-BITCODE-NEXT: <INPUT_FILE_HASH abbrevid=
+
+// CHECK: fatal error: file {{.*}}a.h' has been modified since the precompiled header {{.*}} was built
@@ -0,0 +1 @@
+int both_two;
@@ -0,0 +1,2 @@
+#define LAST_IN_HEADER in_header ONE
+LAST_IN_HEADER
\ No newline at end of file
@@ -0,0 +1,36 @@
+// The remapped path is spelled with a "/" separator.
+// UNSUPPORTED: system-windows
+
+// RUN: %clang_cc1 -fheader-search-listings -E %s \
+// RUN:   -I %S/Inputs/header-search-listings/one \
+// RUN:   -I %S/Inputs/header-search-listings/two \
+// RUN:   -remap-file "%S/Inputs/header-search-listings/one/virtual.h;%S/Inputs/header-search-listings/two/both.h" \
+// RUN:   | FileCheck %s
+// RUN: %clang_cc1 -fheader-search-listings -fsyntax-only -print-stats %s \
+// RUN:   -I %S/Inputs/header-search-listings/one \
+// RUN:   -I %S/Inputs/header-search-listings/two \
+// RUN:   -remap-file "%S/Inputs/header-search-listings/one/virtual.h;%S/Inputs/header-search-listings/two/both.h" \
+// RUN:   2>&1 | FileCheck -check-prefix=STATS %s
+
+#include "first.h"
+// CHECK: int first;
+
+// 'one' has no 'sub' directory, so it is skipped.
+#include "sub/second.h"
+// CHECK: int second;
+
+#include "both.h"
+// CHECK: int both_one;
+
+// Virtual files are found even though they aren't in the listing.
+#include "virtual.h"
+// CHECK: int both_two;
+
+#include "./first.h"
+// CHECK: int first;
+
+#if __has_include("missing.h")
+#error found missing.h
+#endif
+
+// STATS: 3 lookups skipped by directory listings.
@@ -0,0 +1,29 @@
+// RUN: rm -f %t.cache
+// RUN: %clang_cc1 -finclude-guard-cache-path=%t.cache -fsyntax-only %s \
+// RUN:   -I %S/Inputs/include-guard-cache -print-stats 2>&1 \
+// RUN:   | FileCheck -check-prefix=FIRST %s
+// RUN: %clang_cc1 -finclude-guard-cache-path=%t.cache -fsyntax-only %s \
+// RUN:   -I %S/Inputs/include-guard-cache -print-stats -Wunused-macros 2>&1 \
+// RUN:   -dependency-file %t.d -MT %s.o \
+// RUN:   | FileCheck -check-prefix=SECOND %s
+// RUN: FileCheck -check-prefix=DEPS %s < %t.d
+
+// The guard is already defined, so the second compilation doesn't need to
+// open guarded.h to know that it has no effect.
+#define GUARDED_H
+#include "guarded.h"
+
+// Headers that use #pragma once are not recorded: the first #include of one
+// in each translation unit has to enter it, whatever earlier translation
+// units saw.
+#include "once.h"
+#include "once.h"
+int *p = &once;
+
+// FIRST: 0 #includes skipped due to the include guard cache.
+// The guard counts as used, as it would have been by the header's #ifndef.
+// SECOND-NOT: macro is not used
+// SECOND: 1 #includes skipped due to the include guard cache.
+
+// Skipped headers are still dependencies.
+// DEPS: guarded.h
@@ -0,0 +1,49 @@
+// RUN: %clang_cc1 -E -I %S/Inputs/macro-expand-object-like %s | FileCheck %s
+// RUN: %clang_cc1 -E -CC -I %S/Inputs/macro-expand-object-like %s \
+// RUN:   | FileCheck -check-prefix=COMMENTS %s
+// RUN: %clang_cc1 -fsyntax-only -verify -DSEMA %s
+
+// Object-like macros without '##' or comments take a shorter path through
+// TokenLexer, and leave the lexer stack without HandleEndOfFile. Check that
+// nested expansions, empty expansions and expansions that end a file still
+// come out right, and that diagnostics in them still point into the macros.
+
+#define EMPTY
+#define ONE 1
+#define TWO ONE + ONE
+#define FOUR TWO * TWO
+#define CALL(x) x FOUR
+#define PASTE a ## b
+#define COMMENT /* kept */ c
+
+#ifndef SEMA
+
+// CHECK: nested: 1 + 1 * 1 + 1 end
+nested: FOUR EMPTY end
+
+// CHECK: empty: 1{{$}}
+empty: EMPTY EMPTY ONE
+
+// CHECK: argument: 1 + 1 1 + 1 * 1 + 1{{$}}
+argument: CALL(TWO)
+
+// CHECK: paste: ab{{$}}
+paste: PASTE
+
+// COMMENTS: comment: /* kept */ c{{$}}
+comment: COMMENT
+
+// The expansion is the last thing in the header, which has no newline at
+// the end.
+// CHECK: in_header 1{{$}}
+// CHECK: after_header 1{{$}}
+#include "last.h"
+after_header ONE
+
+#else
+
+#define UNDECLARED undeclared_identifier // expected-note {{expanded from macro 'UNDECLARED'}}
+#define NESTED 1 + UNDECLARED // expected-note {{expanded from macro 'NESTED'}}
+int x = NESTED; // expected-error {{use of undeclared identifier 'undeclared_identifier'}}
+
+#endif
@@ -0,0 +1,16 @@
+// RUN: %clang_cc1 -E -std=c++14 %s | FileCheck --strict-whitespace %s
+
+// Raw string literals in excluded blocks can span lines and hide
+// directives; the skipper has to let the lexer see their prefixes.
+
+#if 0
+R"(a raw string literal
+#else
+)" u8R"x(with a prefix and a delimiter
+#else
+)x"
+int n = 1'000'000; '"'
+#else
+one
+#endif
+// CHECK: {{^}}one{{$}}
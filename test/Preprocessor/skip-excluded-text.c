@@ -0,0 +1,37 @@
+// RUN: %clang_cc1 -E %s | FileCheck --strict-whitespace %s
+// RUN: %clang_cc1 -E -trigraphs %s | FileCheck --strict-whitespace --check-prefix=CHECK --check-prefix=TRIGRAPHS %s
+
+// Excluded blocks are skipped without lexing most of their text; make sure
+// that comments, literals and escaped newlines still hide or reveal
+// directives the way the lexer would.
+
+#if 0
+a block comment that is long enough to span several vector widths /*
+#else
+#endif
+*/
+a line comment that continues onto the next line // \
+#else
+"a string literal that looks like it starts a comment /*"
+'"' "and a character literal that looks like a string"
+a line that is continued with an escaped newline \
+#else
+a division / that isn't a comment, and a question mark ? that isn't a trigraph
+    /* a comment before a directive */ #else
+one
+#endif
+// CHECK: {{^}}one{{$}}
+
+#if 0
+a digraph
+%:else
+two
+#endif
+// CHECK: {{^}}two{{$}}
+
+#if 0
+a trigraph
+??=else
+three
+#endif
+// TRIGRAPHS: {{^}}three{{$}}
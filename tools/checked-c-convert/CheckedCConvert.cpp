@@ -10,23 +10,32 @@
 #include "clang/AST/RecursiveASTVisitor.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendAction.h"
+#include "clang/Lex/Lexer.h"
 #include "clang/Rewrite/Core/Rewriter.h"
 #include "clang/Tooling/CommonOptionsParser.h"
+#include "clang/Tooling/Core/Replacement.h"
 #include "clang/Tooling/Tooling.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/Option/OptTable.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/Timer.h"
 
 #include <algorithm>
 #include <map>
 #include <sstream>
+#include <unordered_set>
+#if defined(LLVM_ON_UNIX)
+#include <sys/resource.h>
+#endif
 
 #include "Constraints.h"
 
 #include "ConstraintBuilder.h"
+#include "ConstraintCache.h"
 #include "PersistentSourceLoc.h"
 #include "ProgramInfo.h"
 #include "MappingVisitor.h"
@@ -50,6 +59,13 @@ cl::opt<bool> Verbose("verbose",
                       cl::init(false),
                       cl::cat(ConvertCategory));
 
+cl::opt<bool> ContextSensitive("context-sensitive",
+  cl::desc("Constrain the arguments of direct calls by the summary of the "
+           "callee's parameters instead of unifying them, and cast arguments "
+           "that stay unchecked"),
+  cl::init(false),
+  cl::cat(ConvertCategory));
+
 static cl::opt<std::string>
     OutputPostfix("output-postfix",
                   cl::desc("Postfix to add to the names of rewritten files, if "
@@ -61,6 +77,20 @@ static cl::opt<bool> DumpStats( "dump-stats",
                                 cl::init(false),
                                 cl::cat(ConvertCategory));
 
+static cl::opt<std::string>
+ProfileOutput("profile-output",
+  cl::desc("Write a JSON profile of the conversion (time per phase, "
+           "constraint counts, solver iterations and memory use) to <file>"),
+  cl::init(""),
+  cl::cat(ConvertCategory));
+
+static cl::opt<std::string>
+CacheDir("cache-dir",
+  cl::desc("Directory in which to cache the constraints gathered for each "
+           "file, so that unchanged files are not re-analyzed on later runs"),
+  cl::init(""),
+  cl::cat(ConvertCategory));
+
 static cl::opt<std::string>
 BaseDir("base-dir",
   cl::desc("Base directory for the code we're translating"),
@@ -78,26 +108,74 @@ const Type *getNextTy(const Type *Ty) {
     return Ty;
 }
 
-// Test to see if we can rewrite a given SourceRange. 
-// Note that R.getRangeSize will return -1 if SR is within
-// a macro as well. This means that we can't re-write any 
-// text that occurs within a macro.
-bool canRewrite(Rewriter &R, SourceRange &SR) {
-  return SR.isValid() && (R.getRangeSize(SR) != -1);
+// Test to see if we can rewrite a given SourceRange. Both ends of SR must
+// be in the same file, and not within a macro. This means that we can't
+// re-write any text that occurs within a macro.
+bool canRewrite(SourceManager &SM, SourceRange &SR) {
+  return SR.isValid() && Rewriter::isRewritable(SR.getBegin()) &&
+    Rewriter::isRewritable(SR.getEnd()) &&
+    SM.getFileID(SR.getBegin()) == SM.getFileID(SR.getEnd());
+}
+
+// The rewrites for the whole program. Each compilation unit adds the 
+// replacements for the declarations that it can resolve, keyed by the 
+// absolute path of the file they apply to, so that a header rewritten by
+// several compilation units is only stored once. Each output file is 
+// written once, after every compilation unit has been processed.
+class RewriteOutput {
+public:
+  explicit RewriteOutput(std::set<std::string> &F) : InOutFiles(F) {}
+
+  // Record that the text in the token range SR should be replaced with
+  // Text. SR must satisfy canRewrite.
+  void replaceText(SourceManager &SM, const LangOptions &LO, SourceRange SR,
+                   StringRef Text);
+
+  // Declarations whose rewrites have been computed by an earlier 
+  // compilation unit don't need to be revisited by later ones.
+  bool isRewritten(const PersistentSourceLoc &L) const {
+    return Rewritten.count(L) > 0;
+  }
+  void setRewritten(const PersistentSourceLoc &L) { Rewritten.insert(L); }
+
+  // Apply the replacements and write out the rewritten files.
+  void emit();
+
+private:
+  std::set<std::string> &InOutFiles;
+  std::map<std::string, std::set<tooling::Replacement>> FileReplacements;
+  std::unordered_set<PersistentSourceLoc> Rewritten;
+};
+
+void RewriteOutput::replaceText(SourceManager &SM, const LangOptions &LO,
+                                SourceRange SR, StringRef Text) {
+  std::pair<FileID, unsigned> B = SM.getDecomposedLoc(SR.getBegin());
+  std::pair<FileID, unsigned> E = SM.getDecomposedLoc(SR.getEnd());
+  assert(B.first == E.first);
+
+  const FileEntry *FE = SM.getFileEntryForID(B.first);
+  if (!FE)
+    return;
+
+  unsigned Length =
+    E.second - B.second + Lexer::MeasureTokenLength(SR.getEnd(), SM, LO);
+  std::string Path = getAbsolutePath(FE->getName());
+  FileReplacements[Path].insert(
+    tooling::Replacement(Path, B.second, Length, Text));
 }
 
 typedef std::pair<Decl*, DeclStmt*> DeclNStmt;
 typedef std::pair<DeclNStmt, std::string> DAndReplace;
 
 // Visit each Decl in toRewrite and apply the appropriate pointer type
-// to that Decl. The state of the rewrite is contained within R, which
-// is both input and output. R is initialized to point to the 'main'
-// source file for this transformation. toRewrite contains the set of
-// declarations to rewrite. S is passed for source-level information
-// about the current compilation unit.
-void rewrite(Rewriter &R, std::set<DAndReplace> &toRewrite, SourceManager &S,
-             ASTContext &A, std::set<FileID> &Files) {
+// to that Decl. The replacements are added to R, which collects them for
+// the whole program. toRewrite contains the set of declarations to 
+// rewrite. S is passed for source-level information about the current
+// compilation unit.
+void rewrite(RewriteOutput &R, std::set<DAndReplace> &toRewrite,
+             SourceManager &S, ASTContext &A) {
   std::set<DAndReplace> skip;
+  const LangOptions &LO = A.getLangOpts();
 
   for (const auto &N : toRewrite) {
     //if (N->anyChanges() == false)
@@ -147,8 +225,8 @@ void rewrite(Rewriter &R, std::set<DAndReplace> &toRewrite, SourceManager &S,
               SourceRange TR = Rewrite->getSourceRange();
               std::string sRewrite = N.second + " " + Rewrite->getNameAsString();
 
-              if (canRewrite(R, TR))
-                R.ReplaceText(TR, sRewrite);
+              if (canRewrite(S, TR))
+                R.replaceText(S, LO, TR, sRewrite);
             }
           }
         } else
@@ -176,26 +254,20 @@ void rewrite(Rewriter &R, std::set<DAndReplace> &toRewrite, SourceManager &S,
 
         // Is it a variable type? This is the easy case, we can re-write it
         // locally, at the site of the declaration.
-
-        // Get a FullSourceLoc for the start location and add it to the
-        // list of file ID's we've touched.
-        FullSourceLoc FSL(TR.getBegin(), S);
-        Files.insert(FSL.getFileID());
         if (Where->isSingleDecl()) {
-          if (canRewrite(R, TR)) {
-            R.ReplaceText(TR, sRewrite);
+          if (canRewrite(S, TR)) {
+            R.replaceText(S, LO, TR, sRewrite);
           } else {
             // This can happen if SR is within a macro. If that is the case, 
             // maybe there is still something we can do because Decl refers 
             // to a non-macro line.
 
-            SourceRange possible(R.getSourceMgr().getExpansionLoc(TR.getBegin()),
+            SourceRange possible(S.getExpansionLoc(TR.getBegin()),
               VD->getLocation());
 
-            if (canRewrite(R, possible)) {
-              R.ReplaceText(possible, N.second);
-              std::string newStr = " " + VD->getName().str();
-              R.InsertTextAfter(VD->getLocation(), newStr);
+            if (canRewrite(S, possible)) {
+              std::string newStr = N.second + " " + VD->getName().str();
+              R.replaceText(S, LO, possible, newStr);
             } else {
               if (Verbose) {
                 errs() << "Still don't know how to re-write VarDecl\n";
@@ -224,9 +296,8 @@ void rewrite(Rewriter &R, std::set<DAndReplace> &toRewrite, SourceManager &S,
             ++I;
           }
 
-          // Step 2: remove the original line from the program.
+          // Step 2: find the original line in the program.
           SourceRange DR = Where->getSourceRange();
-          R.RemoveText(DR);
 
           // Step 3: for each decl in the original, build up a new string
           //         and if the original decl was re-written, write that
@@ -261,8 +332,10 @@ void rewrite(Rewriter &R, std::set<DAndReplace> &toRewrite, SourceManager &S,
             }
           }
 
-          // Step 4: Write out the string built up in step 3.
-          R.InsertTextAfter(DR.getEnd(), newMLDecl.str());
+          // Step 4: Replace the original line with the string built up in
+          //         step 3.
+          if (canRewrite(S, DR))
+            R.replaceText(S, LO, DR, newMLDecl.str());
 
           // Step 5: Be sure and skip all of the NewTyps that we dealt with
           //         during this time of hacking, by adding them to the
@@ -295,14 +368,14 @@ void rewrite(Rewriter &R, std::set<DAndReplace> &toRewrite, SourceManager &S,
       //       spanning multiple files. We don't know how to re-write that,
       //       so don't.
       SourceRange SR = UD->getReturnTypeSourceRange();
-      if (canRewrite(R, SR))
-        R.ReplaceText(SR, N.second);
+      if (canRewrite(S, SR))
+        R.replaceText(S, LO, SR, N.second);
     } else if (FieldDecl *FD = dyn_cast<FieldDecl>(D)) {
       SourceRange SR = FD->getSourceRange();
       std::string sRewrite = N.second + " " + FD->getNameAsString();
 
-      if (canRewrite(R, SR))
-        R.ReplaceText(SR, sRewrite);
+      if (canRewrite(S, SR))
+        R.replaceText(S, LO, SR, sRewrite);
     }
   }
 }
@@ -354,81 +427,184 @@ canWrite(std::string filePath, std::set<std::string> &iof, std::string b) {
     return false;
 }
 
-void emit(Rewriter &R, ASTContext &C, std::set<FileID> &Files,
-          std::set<std::string> &InOutFiles) {
+// Write the contents of the file at Path to O, with the replacements in Rs
+// applied. The file is read through a (possibly memory mapped) buffer and
+// written out in a single pass. Rs is sorted by offset; a replacement that
+// overlaps one before it is dropped.
+static void writeRewritten(StringRef Path,
+                           const std::set<tooling::Replacement> &Rs,
+                           raw_ostream &O) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buf = MemoryBuffer::getFile(Path);
+  if (!Buf) {
+    errs() << "could not read file " << Path << "\n";
+    return;
+  }
+
+  StringRef Code = (*Buf)->getBuffer();
+  unsigned Pos = 0;
+  for (const auto &R : Rs) {
+    if (R.getOffset() < Pos || R.getOffset() + R.getLength() > Code.size()) {
+      if (Verbose)
+        errs() << "Skipping conflicting rewrite: " << R.toString() << "\n";
+      continue;
+    }
+
+    O << Code.slice(Pos, R.getOffset()) << R.getReplacementText();
+    Pos = R.getOffset() + R.getLength();
+  }
+  O << Code.substr(Pos);
+}
+
+void RewriteOutput::emit() {
   // Check if we are outputing to stdout or not, if we are, just output the
-  // main file ID to stdout.
+  // main file to stdout.
   if (Verbose)
     errs() << "Writing files out\n";
 
-  SourceManager &SM = C.getSourceManager();
   if (OutputPostfix == "-") {
-    if (const RewriteBuffer *B = R.getRewriteBufferFor(SM.getMainFileID()))
-      B->write(outs());
-  } else
-    for (const auto &F : Files)
-      if (const RewriteBuffer *B = R.getRewriteBufferFor(F))
-        if (const FileEntry *FE = SM.getFileEntryForID(F)) {
-          assert(FE->isValid());
-
-          // Produce a path/file name for the rewritten source file.
-          // That path should be the same as the old one, with a
-          // suffix added between the file name and the extension.
-          // For example \foo\bar\a.c should become \foo\bar\a.checked.c
-          // if the OutputPostfix parameter is "checked" .
-
-          std::string pfName = sys::path::filename(FE->getName()).str();
-          std::string dirName = sys::path::parent_path(FE->getName()).str();
-          std::string fileName = sys::path::remove_leading_dotslash(pfName).str();
-          std::string ext = sys::path::extension(fileName).str();
-          std::string stem = sys::path::stem(fileName).str();
-          std::string nFileName = stem + "." + OutputPostfix + ext;
-          std::string nFile = dirName + sys::path::get_separator().str() + nFileName;
-          
-          // Write this file out if it was specified as a file on the command
-          // line.
-          SmallString<254>  feAbs(FE->getName());
-          std::string feAbsS = "";
-          if (std::error_code ec = sys::fs::make_absolute(feAbs)) {
-            if (Verbose)
-              errs() << "could not make path absolote\n";
-          } else
-            feAbsS = feAbs.str();
-
-          if(canWrite(feAbsS, InOutFiles, BaseDir)) {
-            std::error_code EC;
-            raw_fd_ostream out(nFile, EC, sys::fs::F_None);
-
-            if (!EC) {
-              if (Verbose)
-                outs() << "writing out " << nFile << "\n";
-              B->write(out);
-            }
-            else
-              errs() << "could not open file " << nFile << "\n";
-            // This is awkward. What to do? Since we're iterating,
-            // we could have created other files successfully. Do we go back
-            // and erase them? Is that surprising? For now, let's just keep
-            // going.
-          }
-        }
+    assert(InOutFiles.size() <= 1);
+    for (const auto &F : InOutFiles) {
+      auto I = FileReplacements.find(F);
+      if (I != FileReplacements.end())
+        writeRewritten(F, I->second, outs());
+    }
+    return;
+  }
+
+  for (const auto &I : FileReplacements) {
+    // Produce a path/file name for the rewritten source file.
+    // That path should be the same as the old one, with a
+    // suffix added between the file name and the extension.
+    // For example \foo\bar\a.c should become \foo\bar\a.checked.c
+    // if the OutputPostfix parameter is "checked" .
+    const std::string &feAbsS = I.first;
+    std::string pfName = sys::path::filename(feAbsS).str();
+    std::string dirName = sys::path::parent_path(feAbsS).str();
+    std::string fileName = sys::path::remove_leading_dotslash(pfName).str();
+    std::string ext = sys::path::extension(fileName).str();
+    std::string stem = sys::path::stem(fileName).str();
+    std::string nFileName = stem + "." + OutputPostfix + ext;
+    std::string nFile = dirName + sys::path::get_separator().str() + nFileName;
+
+    // Write this file out if it was specified as a file on the command
+    // line.
+    if (canWrite(feAbsS, InOutFiles, BaseDir)) {
+      std::error_code EC;
+      raw_fd_ostream out(nFile, EC, sys::fs::F_None);
+
+      if (!EC) {
+        if (Verbose)
+          outs() << "writing out " << nFile << "\n";
+        writeRewritten(feAbsS, I.second, out);
+      }
+      else
+        errs() << "could not open file " << nFile << "\n";
+      // This is awkward. What to do? Since we're iterating,
+      // we could have created other files successfully. Do we go back
+      // and erase them? Is that surprising? For now, let's just keep
+      // going.
+    }
+  }
+}
+
+// Is the level K of the pointer variable PV rewritten to a checked pointer
+// under the solution E?
+static bool isCheckedLevel(PVConstraint *PV, uint32_t K,
+                           Constraints::EnvironmentMap &E) {
+  VarAtom V(K);
+  ConstAtom *C = E[&V];
+  assert(C != nullptr);
+  return isa<PtrAtom>(C) && !PV->isConstrained(K);
 }
 
+// With -context-sensitive, the argument of a direct call is no longer
+// unified with its parameter, so a call may pass a pointer that stays 
+// unchecked for a parameter that becomes checked. Find those arguments and
+// cast them to the rewritten type of the parameter.
+class CallCastVisitor : public RecursiveASTVisitor<CallCastVisitor> {
+public:
+  explicit CallCastVisitor(ASTContext *C, ProgramInfo &I, RewriteOutput &O)
+    : Context(C), Info(I), Output(O) {}
+
+  bool VisitCallExpr(CallExpr *E) {
+    FunctionDecl *FD = dyn_cast_or_null<FunctionDecl>(E->getCalleeDecl());
+    if (!FD)
+      return true;
+
+    unsigned i = 0;
+    for (const auto &A : E->arguments()) {
+      if (i >= FD->getNumParams())
+        break;
+      castArgument(A, FD->getParamDecl(i));
+      i++;
+    }
+
+    return true;
+  }
+
+private:
+  void castArgument(Expr *A, ParmVarDecl *PVD) {
+    Constraints::EnvironmentMap &Env = 
+      Info.getConstraints().getVariables();
+
+    PVConstraint *Param = nullptr;
+    for (const auto &V : Info.getVariable(PVD, Context))
+      if (PVConstraint *PV = dyn_cast<PVConstraint>(V))
+        Param = PV;
+    if (!Param || Param->getFV())
+      return;
+
+    bool NeedsCast = false;
+    for (const auto &V : Info.getVariable(A, Context)) {
+      PVConstraint *Arg = dyn_cast<PVConstraint>(V);
+      if (!Arg || Arg->getCvars().size() != Param->getCvars().size())
+        continue;
+
+      CVars::const_iterator I = Arg->getCvars().begin();
+      for (const auto &P : Param->getCvars()) {
+        if (isCheckedLevel(Param, P, Env) && !isCheckedLevel(Arg, *I, Env))
+          NeedsCast = true;
+        ++I;
+      }
+    }
+
+    if (!NeedsCast)
+      return;
+
+    SourceManager &SM = Context->getSourceManager();
+    const LangOptions &LO = Context->getLangOpts();
+    SourceRange SR = A->getSourceRange();
+    if (!canRewrite(SM, SR))
+      return;
+
+    StringRef Text = 
+      Lexer::getSourceText(CharSourceRange::getTokenRange(SR), SM, LO);
+    std::string Ty = StringRef(Param->mkString(Env)).rtrim();
+    Output.replaceText(SM, LO, SR, "(" + Ty + ")(" + Text.str() + ")");
+  }
+
+  ASTContext *Context;
+  ProgramInfo &Info;
+  RewriteOutput &Output;
+};
+
 class RewriteConsumer : public ASTConsumer {
 public:
   explicit RewriteConsumer(ProgramInfo &I, 
-    std::set<std::string> &F, ASTContext *Context) : Info(I), InOutFiles(F) {}
+    RewriteOutput &O, ASTContext *Context) : Info(I), Output(O) {}
 
   virtual void HandleTranslationUnit(ASTContext &Context) {
     Info.enterCompilationUnit(Context);
 
     // Build a map of all of the PersistentSourceLoc's back to some kind of 
-    // Stmt, Decl, or Type.
+    // Stmt, Decl, or Type. Skip the ones that an earlier compilation unit
+    // has already rewritten, such as declarations in shared headers.
     VariableMap &VarMap = Info.getVarMap();
     std::set<PersistentSourceLoc> keys;
 
     for (const auto &I : VarMap)
-      keys.insert(I.first);
+      if (!Output.isRewritten(I.first))
+        keys.insert(I.first);
     std::map<PersistentSourceLoc, MappingVisitor::StmtDeclOrType> PSLMap;
     VariableDecltoStmtMap VDLToStmtMap;
 
@@ -442,6 +618,8 @@ public:
     std::set<DAndReplace> rewriteThese;
     for (const auto &V : Info.getVarMap()) {
       PersistentSourceLoc PLoc = V.first;
+      if (keys.count(PLoc) == 0)
+        continue;
       std::set<ConstraintVariable*> Vars = V.second;
       // I don't think it's important that Vars have any especial size, but 
       // at one point I did so I'm keeping this comment here. It's possible 
@@ -465,6 +643,8 @@ public:
       std::tie(S, D, T) = PSLMap[PLoc];
 
       if (D) {
+        Output.setRewritten(PLoc);
+
         // We might have one Decl for multiple Vars, however, one will be a 
         // PointerVar so we'll use that.
         VariableDecltoStmtMap::iterator K = VDLToStmtMap.find(D);
@@ -496,13 +676,13 @@ public:
       }
     }
 
-    Rewriter R(Context.getSourceManager(), Context.getLangOpts());
-    std::set<FileID> Files;
+    rewrite(Output, rewriteThese, Context.getSourceManager(), Context);
 
-    rewrite(R, rewriteThese, Context.getSourceManager(), Context, Files);
-
-    // Output files.
-    emit(R, Context, Files, InOutFiles);
+    if (ContextSensitive) {
+      CallCastVisitor CV(&Context, Info, Output);
+      for (const auto &D : TUD->decls())
+        CV.TraverseDecl(D);
+    }
 
     Info.exitCompilationUnit();
     return;
@@ -510,7 +690,7 @@ public:
 
 private:
   ProgramInfo &Info;
-  std::set<std::string> &InOutFiles;
+  RewriteOutput &Output;
 };
 
 template <typename T, typename V>
@@ -562,23 +742,108 @@ newFrontendActionFactoryA(ProgramInfo &I) {
 
 template <typename T>
 std::unique_ptr<FrontendActionFactory>
-newFrontendActionFactoryB(ProgramInfo &I, std::set<std::string> &PS) {
+newFrontendActionFactoryB(ProgramInfo &I, RewriteOutput &PS) {
   class ArgFrontendActionFactory : public FrontendActionFactory {
   public:
     explicit ArgFrontendActionFactory(ProgramInfo &I,
-      std::set<std::string> &PS) : Info(I),Files(PS) {}
+      RewriteOutput &PS) : Info(I),Files(PS) {}
 
     FrontendAction *create() override { return new T(Info, Files); }
 
   private:
     ProgramInfo &Info;
-    std::set<std::string> &Files;
+    RewriteOutput &Files;
   };
 
   return std::unique_ptr<FrontendActionFactory>(
     new ArgFrontendActionFactory(I, PS));
 }
 
+// Collects the wall time and memory use of each phase of the conversion,
+// and writes them out together with statistics about the constraint system
+// as a JSON object, for -profile-output.
+class ConversionProfile {
+public:
+  ConversionProfile() : Enabled(ProfileOutput.size() > 0) {}
+
+  // Start timing the phase named Name, ending the current phase, if any.
+  void startPhase(StringRef Name) {
+    if (!Enabled)
+      return;
+    endPhase();
+    Current = Name;
+    Start = TimeRecord::getCurrentTime(true);
+  }
+
+  void endPhase() {
+    if (!Enabled || Current.empty())
+      return;
+    TimeRecord Elapsed = TimeRecord::getCurrentTime(false);
+    Elapsed -= Start;
+    Phases.push_back(std::make_pair(Current, Elapsed));
+    Current.clear();
+  }
+
+  void write(ProgramInfo &Info, unsigned NumFiles, unsigned NumCached);
+
+private:
+  // The peak resident set size of the process, or 0 if it isn't known.
+  static uint64_t getPeakMemory() {
+#if defined(LLVM_ON_UNIX)
+    struct rusage RU;
+    if (getrusage(RUSAGE_SELF, &RU) == 0) {
+#if defined(__APPLE__)
+      return RU.ru_maxrss;
+#else
+      return (uint64_t)RU.ru_maxrss * 1024;
+#endif
+    }
+#endif
+    return 0;
+  }
+
+  bool Enabled;
+  std::string Current;
+  TimeRecord Start;
+  std::vector<std::pair<std::string, TimeRecord>> Phases;
+};
+
+void ConversionProfile::write(ProgramInfo &Info, unsigned NumFiles,
+                              unsigned NumCached) {
+  if (!Enabled)
+    return;
+  endPhase();
+
+  std::error_code EC;
+  raw_fd_ostream O(ProfileOutput, EC, sys::fs::F_Text);
+  if (EC) {
+    errs() << "could not open file " << ProfileOutput << "\n";
+    return;
+  }
+
+  Constraints &CS = Info.getConstraints();
+  double Total = 0;
+  O << "{\n";
+  O << "  \"files\": " << NumFiles << ",\n";
+  O << "  \"files_from_cache\": " << NumCached << ",\n";
+  O << "  \"phases\": {";
+  for (unsigned i = 0; i < Phases.size(); i++) {
+    const TimeRecord &T = Phases[i].second;
+    Total += T.getWallTime();
+    O << (i ? "," : "") << "\n    \"" << Phases[i].first << "\": { "
+      << "\"wall_seconds\": " << format("%.6f", T.getWallTime()) << ", "
+      << "\"user_seconds\": " << format("%.6f", T.getUserTime()) << ", "
+      << "\"malloc_delta_bytes\": " << (int64_t)T.getMemUsed() << " }";
+  }
+  O << "\n  },\n";
+  O << "  \"total_wall_seconds\": " << format("%.6f", Total) << ",\n";
+  O << "  \"constraint_variables\": " << CS.getVariables().size() << ",\n";
+  O << "  \"constraints\": " << CS.getConstraints().size() << ",\n";
+  O << "  \"solver_iterations\": " << CS.getNumIterations() << ",\n";
+  O << "  \"peak_memory_bytes\": " << getPeakMemory() << "\n";
+  O << "}\n";
+}
+
 int main(int argc, const char **argv) {
   sys::PrintStackTraceOnErrorSignal(argv[0]);
 
@@ -605,13 +870,10 @@ int main(int argc, const char **argv) {
   ClangTool Tool(OptionsParser.getCompilations(), args);
   std::set<std::string> inoutPaths;
 
-  for (const auto &S : args) {
-    SmallString<255> abs_path(S);
-    if (std::error_code ec = sys::fs::make_absolute(abs_path))
-      errs() << "could not make absolute\n";
-    else
-      inoutPaths.insert(abs_path.str());
-  }
+  // Use the same absolute form of the paths as the rewriter uses for the
+  // files that it rewrites.
+  for (const auto &S : args)
+    inoutPaths.insert(getAbsolutePath(S));
 
   //if (OutputPostfix == "-" && RewriteHeaders == true) {
   if (OutputPostfix == "-" && inoutPaths.size() > 1) {
@@ -620,22 +882,48 @@ int main(int argc, const char **argv) {
   }
 
   ProgramInfo Info;
+  ConversionProfile Profile;
+
+  // 1. Gather constraints. Files with an up to date entry in the constraint
+  //    cache are loaded from it, and only the rest are parsed and analyzed.
+  Profile.startPhase("gather");
+  std::unique_ptr<ConstraintCache> Cache;
+  tooling::CommandLineArguments analyzePaths = args;
+  if (CacheDir.size() > 0) {
+    Cache.reset(new ConstraintCache(CacheDir, OptionsParser.getCompilations()));
+    Info.setConstraintCache(Cache.get());
+
+    analyzePaths.clear();
+    for (const auto &S : args) {
+      if (Cache->load(getAbsolutePath(S), Info)) {
+        if (Verbose)
+          errs() << "Loaded constraints for " << S << " from cache\n";
+      } else
+        analyzePaths.push_back(S);
+    }
+  }
 
-  // 1. Gather constraints.
   std::unique_ptr<ToolAction> ConstraintTool = newFrontendActionFactoryA<
       GenericAction<ConstraintBuilderConsumer, ProgramInfo>>(Info);
   
-  if (ConstraintTool)
-    Tool.run(ConstraintTool.get());
-  else
+  if (ConstraintTool) {
+    if (analyzePaths.size() > 0) {
+      ClangTool GatherTool(OptionsParser.getCompilations(), analyzePaths);
+      GatherTool.run(ConstraintTool.get());
+    }
+  } else
     llvm_unreachable("No action");
 
+  Info.setConstraintCache(nullptr);
+
+  Profile.startPhase("link");
   if (!Info.link()) {
     errs() << "Linking failed!\n";
     return 1;
   }
 
   // 2. Solve constraints.
+  Profile.startPhase("solve");
   if (Verbose)
     outs() << "Solving constraints\n";
   Constraints &CS = Info.getConstraints();
@@ -648,17 +936,23 @@ int main(int argc, const char **argv) {
   if (DumpIntermediate)
     Info.dump();
 
-  // 3. Re-write based on constraints.
+  // 3. Re-write based on constraints, then write out every rewritten file.
+  Profile.startPhase("rewrite");
+  RewriteOutput Output(inoutPaths);
   std::unique_ptr<ToolAction> RewriteTool =
       newFrontendActionFactoryB
-      <GenericAction2<RewriteConsumer, ProgramInfo, std::set<std::string>>>(
-          Info, inoutPaths);
+      <GenericAction2<RewriteConsumer, ProgramInfo, RewriteOutput>>(
+          Info, Output);
   
   if (RewriteTool)
     Tool.run(RewriteTool.get());
   else
     llvm_unreachable("No action");
 
+  Profile.startPhase("emit");
+  Output.emit();
+  Profile.write(Info, args.size(), args.size() - analyzePaths.size());
+
   if (DumpStats)
     Info.dump_stats(inoutPaths);
 
@@ -8,6 +8,7 @@
 // visitors create constraints based on the AST of the program. 
 //===----------------------------------------------------------------------===//
 #include "ConstraintBuilder.h"
+#include "ConstraintCache.h"
 
 using namespace llvm;
 using namespace clang;
@@ -131,6 +132,41 @@ void constrainEq(std::set<ConstraintVariable*> &RHS,
       constrainEq(I, J, Info);
 }
 
+// Constrain the argument Arg passed for the parameter Param of a direct call
+// when running with -context-sensitive. Rather than unifying the two, which
+// would make every caller of the function share one solution for each of 
+// its parameters, only the summary of the callee flows to the caller: if 
+// the function uses a level of its parameter as WILD or as an array, so is
+// the corresponding level of the argument. An argument that ends up less 
+// checked than its parameter is cast at the call site by the rewriter. 
+// Arguments whose shape doesn't match the parameter fall back to being
+// unified with it.
+static void constrainArgument(std::set<ConstraintVariable*> &Arg,
+  std::set<ConstraintVariable*> &Param, ProgramInfo &Info) {
+  Constraints &CS = Info.getConstraints();
+  for (const auto &I : Arg)
+    for (const auto &J : Param) {
+      PVConstraint *PArg = dyn_cast<PVConstraint>(I);
+      PVConstraint *PParam = dyn_cast<PVConstraint>(J);
+      if (!PArg || !PParam || PArg->getFV() || PParam->getFV() ||
+          PArg->getCvars().size() != PParam->getCvars().size()) {
+        constrainEq(I, J, Info);
+        continue;
+      }
+
+      CVars::const_iterator A = PArg->getCvars().begin();
+      for (const auto &P : PParam->getCvars()) {
+        VarAtom *VP = CS.getOrCreateVar(P);
+        VarAtom *VA = CS.getOrCreateVar(*A);
+        CS.addConstraint(CS.createImplies(CS.createEq(VP, CS.getWild()),
+                                          CS.createEq(VA, CS.getWild())));
+        CS.addConstraint(CS.createImplies(CS.createEq(VP, CS.getArr()),
+                                          CS.createEq(VA, CS.getArr())));
+        ++A;
+      }
+    }
+}
+
 // This class visits functions and adds constraints to the
 // Constraints instance assigned to it.
 // Each VisitXXX method is responsible either for looking inside statements
@@ -314,8 +350,13 @@ public:
           std::set<ConstraintVariable*> ParameterDC =
             Info.getVariable(PVD, Context);
 
-          // Constrain ParameterEC and ParameterDC to be equal.
-          constrainEq(ParameterEC, ParameterDC, Info);
+          // Constrain ParameterEC and ParameterDC to be equal, or, when
+          // the analysis is context sensitive, ParameterEC by the summary
+          // of ParameterDC.
+          if (ContextSensitive)
+            constrainArgument(ParameterEC, ParameterDC, Info);
+          else
+            constrainEq(ParameterEC, ParameterDC, Info);
         } else {
           // Constrain ParameterEC to wild if it is a pointer type.
           Constraints &CS = Info.getConstraints();
@@ -557,6 +598,10 @@ void ConstraintBuilderConsumer::HandleTranslationUnit(ASTContext &C) {
     else
       errs() << "Analyzing\n";
   }
+  ConstraintCache *Cache = Info.getConstraintCache();
+  if (Cache)
+    Info.startRecording();
+
   GlobalVisitor GV = GlobalVisitor(&C, Info);
   TranslationUnitDecl *TUD = C.getTranslationUnitDecl();
   // Generate constraints.
@@ -564,6 +609,11 @@ void ConstraintBuilderConsumer::HandleTranslationUnit(ASTContext &C) {
     GV.TraverseDecl(D);
   }
 
+  if (Cache) {
+    Cache->store(C, Info);
+    Info.stopRecording();
+  }
+
   if (Verbose)
     outs() << "Done analyzing\n";
 
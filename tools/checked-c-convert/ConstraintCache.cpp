@@ -0,0 +1,579 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+// Implementation of the on-disk constraint cache.
+//
+// A cache entry is a sequence of whitespace separated tokens:
+//
+//  checked-c-convert-cache <version>
+//  deps <n> (<file> <content hash>)*
+//  keys <n> <constraint variable>*
+//  var <location> <constraint variable description>
+//  cons <constraint>
+//  sym <name> <has body> <location>
+//  end
+//
+// with any number of var, cons and sym lines. Strings are written as
+// <length>:<bytes> so that they may contain whitespace.
+//===----------------------------------------------------------------------===//
+#include "ConstraintCache.h"
+#include "ConstraintBuilder.h"
+#include "clang/Basic/OnDiskCacheFile.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
+using namespace clang;
+using namespace llvm;
+
+static const char *CacheMagic = "checked-c-convert-cache";
+// Bump this whenever the format of cache entries, or the constraints that
+// are generated for a program, change.
+static const uint32_t CacheVersion = 2;
+
+static std::string hashToString(MD5 &Hash) {
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> S;
+  MD5::stringifyResult(Result, S);
+  return S.str();
+}
+
+static void writeString(raw_ostream &O, StringRef S) {
+  O << S.size() << ":" << S;
+}
+
+// A cursor over the tokens of a cache entry. Malformed input puts the reader
+// in a failed state, after which every read fails.
+class CacheEntryReader {
+public:
+  CacheEntryReader(StringRef B) : Buf(B), Failed(false) {}
+
+  bool failed() const { return Failed; }
+
+  StringRef readToken() {
+    if (Failed)
+      return StringRef();
+
+    Buf = Buf.ltrim();
+    StringRef T = Buf.substr(0, Buf.find_first_of(" \t\r\n"));
+    Buf = Buf.substr(T.size());
+    if (T.empty())
+      Failed = true;
+    return T;
+  }
+
+  bool expect(StringRef T) {
+    if (readToken() != T)
+      Failed = true;
+    return !Failed;
+  }
+
+  bool readInt(uint32_t &V) {
+    StringRef T = readToken();
+    if (!Failed && T.getAsInteger(10, V))
+      Failed = true;
+    return !Failed;
+  }
+
+  bool readString(std::string &S) {
+    if (Failed)
+      return false;
+
+    Buf = Buf.ltrim();
+    size_t Colon = Buf.find(':');
+    uint32_t Len = 0;
+    if (Colon == StringRef::npos ||
+        Buf.substr(0, Colon).getAsInteger(10, Len) ||
+        Buf.size() - Colon - 1 < Len) {
+      Failed = true;
+      return false;
+    }
+
+    S = Buf.substr(Colon + 1, Len);
+    Buf = Buf.substr(Colon + 1 + Len);
+    return true;
+  }
+
+private:
+  StringRef Buf;
+  bool Failed;
+};
+
+std::string ConstraintCache::getEntryPath(StringRef SourceFile) {
+  MD5 Hash;
+  Hash.update(CacheMagic);
+  Hash.update(std::to_string(CacheVersion));
+  // The options that change the constraints generated for a compilation
+  // unit. Entries written with different options must not be shared.
+  Hash.update(ContextSensitive ? "context-sensitive" : "unified-calls");
+  Hash.update(SourceFile);
+  for (const auto &C : Compilations.getCompileCommands(SourceFile)) {
+    Hash.update(C.Directory);
+    for (const auto &A : C.CommandLine) {
+      // Separate the arguments so that "-a b" and "-ab" hash differently.
+      Hash.update(StringRef("\0", 1));
+      Hash.update(A);
+    }
+  }
+
+  SmallString<256> Path(CacheDir);
+  sys::path::append(Path, hashToString(Hash) + ".cache");
+  return Path.str();
+}
+
+std::string ConstraintCache::getContentHash(StringRef Path) {
+  auto I = ContentHashes.find(Path);
+  if (I != ContentHashes.end())
+    return I->second;
+
+  std::string Result;
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buf = MemoryBuffer::getFile(Path);
+  if (Buf) {
+    MD5 Hash;
+    Hash.update((*Buf)->getBuffer());
+    Result = hashToString(Hash);
+  }
+
+  ContentHashes[Path] = Result;
+  return Result;
+}
+
+void ConstraintCache::writePSL(raw_ostream &O, const PersistentSourceLoc &L) {
+  writeString(O, L.getFileName());
+  O << " " << L.getLineNo() << " " << L.getColNo();
+}
+
+bool ConstraintCache::readPSL(CacheEntryReader &R, PersistentSourceLoc &L) {
+  std::string File;
+  uint32_t Line, Col;
+  if (!R.readString(File) || !R.readInt(Line) || !R.readInt(Col))
+    return false;
+
+  L = PersistentSourceLoc(File, Line, Col);
+  return true;
+}
+
+// A PVConstraint is written as
+//  P <base type> <n> <var>* <n> <constrained var>* <n> (<var> <qual>)*
+//    <has FV> <FV>?
+// and an FVConstraint as
+//  F <base type> <name> <has prototype> <n> <return var>*
+//    <n> (<m> <param var>*)*
+void ConstraintCache::writeVar(raw_ostream &O, ConstraintVariable *V,
+                               std::set<uint32_t> &Keys) {
+  if (PVConstraint *PV = dyn_cast<PVConstraint>(V)) {
+    O << "P ";
+    writeString(O, PV->BaseType);
+    O << " " << PV->vars.size();
+    for (const auto &K : PV->vars) {
+      O << " " << K;
+      Keys.insert(K);
+    }
+    O << " " << PV->ConstrainedVars.size();
+    for (const auto &K : PV->ConstrainedVars) {
+      O << " " << K;
+      Keys.insert(K);
+    }
+    O << " " << PV->QualMap.size();
+    for (const auto &Q : PV->QualMap)
+      O << " " << Q.first << " " << Q.second;
+    if (PV->FV) {
+      O << " 1 ";
+      writeVar(O, PV->FV, Keys);
+    } else
+      O << " 0";
+  } else if (FVConstraint *FV = dyn_cast<FVConstraint>(V)) {
+    O << "F ";
+    writeString(O, FV->BaseType);
+    O << " ";
+    writeString(O, FV->name);
+    O << " " << FV->hasproto << " " << FV->returnVars.size();
+    for (const auto &R : FV->returnVars) {
+      O << " ";
+      writeVar(O, R, Keys);
+    }
+    O << " " << FV->paramVars.size();
+    for (const auto &P : FV->paramVars) {
+      O << " " << P.size();
+      for (const auto &C : P) {
+        O << " ";
+        writeVar(O, C, Keys);
+      }
+    }
+  } else
+    llvm_unreachable("unknown constraint variable kind");
+}
+
+// The variables read for an entry are owned by the reader until the whole
+// entry has been read, so that nothing leaks when a later part of it turns out
+// to be malformed.
+std::unique_ptr<ConstraintVariable>
+ConstraintCache::readVar(CacheEntryReader &R, KeyMap &Keys, ProgramInfo &Info) {
+  // Map a cached constraint variable number to the fresh one assigned to it.
+  auto Map = [&](uint32_t &K) {
+    if (!R.readInt(K))
+      return false;
+    KeyMap::iterator I = Keys.find(K);
+    if (I == Keys.end())
+      return false;
+    K = I->second;
+    Info.CS.getOrCreateVar(K);
+    return true;
+  };
+
+  StringRef Kind = R.readToken();
+  std::string BaseType;
+  uint32_t N, K;
+  if (Kind == "P") {
+    if (!R.readString(BaseType) || !R.readInt(N))
+      return nullptr;
+    CVars Vars;
+    for (uint32_t i = 0; i < N; i++) {
+      if (!Map(K))
+        return nullptr;
+      Vars.insert(K);
+    }
+    std::unique_ptr<PVConstraint> PV(new PVConstraint(Vars, BaseType));
+
+    if (!R.readInt(N))
+      return nullptr;
+    for (uint32_t i = 0; i < N; i++) {
+      if (!Map(K))
+        return nullptr;
+      PV->constrainedVariable(K);
+    }
+
+    if (!R.readInt(N))
+      return nullptr;
+    for (uint32_t i = 0; i < N; i++) {
+      uint32_t Q;
+      if (!Map(K) || !R.readInt(Q))
+        return nullptr;
+      PV->QualMap.insert(std::make_pair(K, PVConstraint::Qualification(Q)));
+    }
+
+    uint32_t HasFV;
+    if (!R.readInt(HasFV))
+      return nullptr;
+    if (HasFV) {
+      std::unique_ptr<ConstraintVariable> FV = readVar(R, Keys, Info);
+      if (!FV || !isa<FVConstraint>(FV.get()))
+        return nullptr;
+      PV->FV = cast<FVConstraint>(FV.release());
+    }
+    return std::move(PV);
+  } else if (Kind == "F") {
+    std::unique_ptr<FVConstraint> FV(new FVConstraint());
+    uint32_t HasProto;
+    if (!R.readString(FV->BaseType) || !R.readString(FV->name) ||
+        !R.readInt(HasProto) || !R.readInt(N))
+      return nullptr;
+    FV->hasproto = HasProto;
+
+    std::vector<std::unique_ptr<ConstraintVariable>> Returns;
+    for (uint32_t i = 0; i < N; i++) {
+      Returns.push_back(readVar(R, Keys, Info));
+      if (!Returns.back())
+        return nullptr;
+    }
+
+    if (!R.readInt(N))
+      return nullptr;
+    std::vector<std::vector<std::unique_ptr<ConstraintVariable>>> Params;
+    for (uint32_t i = 0; i < N; i++) {
+      uint32_t M;
+      if (!R.readInt(M))
+        return nullptr;
+      Params.emplace_back();
+      std::vector<std::unique_ptr<ConstraintVariable>> &P = Params.back();
+      for (uint32_t j = 0; j < M; j++) {
+        P.push_back(readVar(R, Keys, Info));
+        if (!P.back())
+          return nullptr;
+      }
+    }
+
+    for (auto &V : Returns)
+      FV->returnVars.insert(V.release());
+    for (auto &P : Params) {
+      std::set<ConstraintVariable*> S;
+      for (auto &V : P)
+        S.insert(V.release());
+      FV->paramVars.push_back(S);
+    }
+    return std::move(FV);
+  }
+
+  return nullptr;
+}
+
+// Constraints are written in prefix form, as one of
+//  eq <atom> <atom>
+//  not <constraint>
+//  imp <constraint> <constraint>
+// where an atom is printed the same way as for -dump-intermediate.
+void ConstraintCache::writeConstraint(raw_ostream &O, Constraint *C,
+                                      std::set<uint32_t> &Keys) {
+  if (Eq *E = dyn_cast<Eq>(C)) {
+    O << "eq ";
+    E->getLHS()->print(O);
+    O << " ";
+    E->getRHS()->print(O);
+    if (VarAtom *V = dyn_cast<VarAtom>(E->getLHS()))
+      Keys.insert(V->getLoc());
+    if (VarAtom *V = dyn_cast<VarAtom>(E->getRHS()))
+      Keys.insert(V->getLoc());
+  } else if (Not *N = dyn_cast<Not>(C)) {
+    O << "not ";
+    writeConstraint(O, N->getBody(), Keys);
+  } else if (Implies *I = dyn_cast<Implies>(C)) {
+    O << "imp ";
+    writeConstraint(O, I->getPremise(), Keys);
+    O << " ";
+    writeConstraint(O, I->getConclusion(), Keys);
+  } else
+    llvm_unreachable("unsupported constraint");
+}
+
+Atom *ConstraintCache::readAtom(CacheEntryReader &R, KeyMap &Keys,
+                                ProgramInfo &Info) {
+  Constraints &CS = Info.CS;
+  StringRef T = R.readToken();
+  if (T == "PTR")
+    return CS.getPtr();
+  if (T == "ARR")
+    return CS.getArr();
+  if (T == "WILD")
+    return CS.getWild();
+
+  uint32_t K;
+  if (!T.startswith("q_") || T.drop_front(2).getAsInteger(10, K))
+    return nullptr;
+  KeyMap::iterator I = Keys.find(K);
+  if (I == Keys.end())
+    return nullptr;
+  return CS.getOrCreateVar(I->second);
+}
+
+Constraint *ConstraintCache::readConstraint(CacheEntryReader &R,
+                                            KeyMap &Keys, ProgramInfo &Info) {
+  Constraints &CS = Info.CS;
+  StringRef Kind = R.readToken();
+  if (Kind == "eq") {
+    Atom *LHS = readAtom(R, Keys, Info);
+    Atom *RHS = readAtom(R, Keys, Info);
+    if (LHS && RHS)
+      return CS.createEq(LHS, RHS);
+  } else if (Kind == "not") {
+    if (Constraint *Body = readConstraint(R, Keys, Info))
+      return CS.createNot(Body);
+  } else if (Kind == "imp") {
+    Constraint *Premise = readConstraint(R, Keys, Info);
+    Constraint *Conclusion = readConstraint(R, Keys, Info);
+    if (Premise && Conclusion)
+      return CS.createImplies(Premise, Conclusion);
+  }
+
+  return nullptr;
+}
+
+bool ConstraintCache::load(StringRef SourceFile, ProgramInfo &Info) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buf =
+    MemoryBuffer::getFile(getEntryPath(SourceFile));
+  if (!Buf)
+    return false;
+
+  CacheEntryReader R((*Buf)->getBuffer());
+  uint32_t Version, N;
+  if (!R.expect(CacheMagic) || !R.readInt(Version) ||
+      Version != CacheVersion)
+    return false;
+
+  // Check that none of the files read by the compilation unit have changed
+  // since the entry was written.
+  if (!R.expect("deps") || !R.readInt(N))
+    return false;
+  for (uint32_t i = 0; i < N; i++) {
+    std::string Path, Hash;
+    if (!R.readString(Path) || !R.readString(Hash))
+      return false;
+    if (getContentHash(Path) != Hash) {
+      if (Verbose)
+        errs() << "Constraint cache entry for " << SourceFile
+               << " is out of date: " << Path << " has changed\n";
+      return false;
+    }
+  }
+
+  // Give each cached constraint variable a fresh number. The numbers are
+  // assigned in the same order as the cached ones, because the order of
+  // the variables in a PVConstraint is the order of the pointer levels.
+  KeyMap Keys;
+  if (!R.expect("keys") || !R.readInt(N))
+    return false;
+  for (uint32_t i = 0; i < N; i++) {
+    uint32_t K;
+    if (!R.readInt(K))
+      return false;
+    Keys[K] = Info.freeKey++;
+  }
+
+  std::vector<std::pair<PersistentSourceLoc,
+                        std::unique_ptr<ConstraintVariable>>> Vars;
+  std::vector<Constraint*> Cons;
+  std::vector<RecordedSymbol> Syms;
+  while (true) {
+    StringRef T = R.readToken();
+    if (T == "end")
+      break;
+
+    if (T == "var") {
+      PersistentSourceLoc L;
+      if (!readPSL(R, L))
+        return false;
+      std::unique_ptr<ConstraintVariable> V = readVar(R, Keys, Info);
+      if (!V)
+        return false;
+      Vars.push_back(std::make_pair(L, std::move(V)));
+    } else if (T == "cons") {
+      Constraint *C = readConstraint(R, Keys, Info);
+      if (!C)
+        return false;
+      Cons.push_back(C);
+    } else if (T == "sym") {
+      RecordedSymbol S;
+      uint32_t HasBody;
+      if (!R.readString(S.Name) || !R.readInt(HasBody) || !readPSL(R, S.PSL))
+        return false;
+      S.HasBody = HasBody;
+      Syms.push_back(S);
+    } else
+      return false;
+  }
+
+  // The whole entry was read successfully, so add it to Info. A cached
+  // variable at a location that already has a variable of the same kind is
+  // made equal to it instead of being added.
+  for (auto &V : Vars) {
+    std::set<ConstraintVariable*> &S = Info.Variables[V.first];
+    ConstraintVariable *Existing = nullptr;
+    for (const auto &C : S)
+      if (C->getKind() == V.second->getKind())
+        Existing = C;
+
+    if (Existing)
+      constrainEq(Existing, V.second.get(), Info);
+    else
+      S.insert(V.second.release());
+  }
+
+  for (const auto &C : Cons)
+    Info.CS.addConstraint(C);
+
+  for (const auto &S : Syms) {
+    VariableMap::iterator I = Info.Variables.find(S.PSL);
+    if (I == Info.Variables.end())
+      continue;
+
+    for (const auto &C : I->second)
+      if (FVConstraint *FV = dyn_cast<FVConstraint>(C)) {
+        Info.GlobalSymbols[S.Name].insert(FV);
+        if (!Info.ExternFunctions[S.Name])
+          Info.ExternFunctions[S.Name] = S.HasBody;
+      }
+  }
+
+  return true;
+}
+
+void ConstraintCache::store(ASTContext &Context, ProgramInfo &Info) {
+  SourceManager &SM = Context.getSourceManager();
+  const FileEntry *Main = SM.getFileEntryForID(SM.getMainFileID());
+  if (!Main)
+    return;
+
+  // Record the hash of the contents of every file that was read while
+  // analyzing this compilation unit.
+  std::string Deps;
+  raw_string_ostream D(Deps);
+  unsigned NumDeps = 0;
+  for (auto I = SM.fileinfo_begin(), E = SM.fileinfo_end(); I != E; ++I) {
+    bool Invalid = false;
+    MemoryBuffer *B = SM.getMemoryBufferForFile(I->first, &Invalid);
+    // If we can't tell what this file contained, we can't tell when the
+    // entry goes out of date, so don't write one.
+    if (Invalid || !B)
+      return;
+
+    MD5 Hash;
+    Hash.update(B->getBuffer());
+    D << " ";
+    writeString(D, tooling::getAbsolutePath(I->first->getName()));
+    D << " ";
+    writeString(D, hashToString(Hash));
+    NumDeps++;
+  }
+  D.flush();
+
+  std::string Body;
+  raw_string_ostream O(Body);
+  std::set<uint32_t> Keys;
+  for (const auto &L : Info.RecordedLocs) {
+    VariableMap::iterator I = Info.Variables.find(L);
+    if (I == Info.Variables.end())
+      continue;
+
+    for (const auto &V : I->second) {
+      O << "var ";
+      writePSL(O, L);
+      O << " ";
+      writeVar(O, V, Keys);
+      O << "\n";
+    }
+  }
+
+  for (const auto &C : Info.RecordedConstraints) {
+    O << "cons ";
+    writeConstraint(O, C, Keys);
+    O << "\n";
+  }
+
+  for (const auto &S : Info.RecordedSymbols) {
+    O << "sym ";
+    writeString(O, S.Name);
+    O << " " << S.HasBody << " ";
+    writePSL(O, S.PSL);
+    O << "\n";
+  }
+  O << "end\n";
+  O.flush();
+
+  if (std::error_code EC = sys::fs::create_directories(CacheDir)) {
+    errs() << "could not create constraint cache directory " << CacheDir
+           << ": " << EC.message() << "\n";
+    return;
+  }
+
+  std::string Entry;
+  raw_string_ostream Out(Entry);
+  Out << CacheMagic << " " << CacheVersion << "\n";
+  Out << "deps " << NumDeps << Deps << "\n";
+  Out << "keys " << Keys.size();
+  for (const auto &K : Keys)
+    Out << " " << K;
+  Out << "\n" << Body;
+  Out.flush();
+
+  // Concurrent or interrupted runs must never see a partially written entry.
+  if (writeFileAtomically(
+          getEntryPath(tooling::getAbsolutePath(Main->getName())), Entry))
+    return;
+  if (Verbose)
+    errs() << "Wrote constraint cache entry for " << Main->getName() << "\n";
+}
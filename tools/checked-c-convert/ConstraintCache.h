@@ -0,0 +1,82 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+// The ConstraintCache stores the constraint variables, constraints and global
+// symbols that each compilation unit contributes to the ProgramInfo in an
+// on-disk cache, so that compilation units that have not changed do not need
+// to be re-analyzed on the next run of the tool.
+//
+// Each compilation unit is cached in its own file, named by a hash of the
+// path of its main file, of the compile commands used to build it and of
+// the options of the tool that change the constraints it generates. The
+// cache entry records a content hash of every file that was read while
+// analyzing the compilation unit, and the entry is only used if none of
+// those files have changed.
+//
+// Constraint variables are numbered per run, so when an entry is loaded every
+// variable in it is given a fresh number. A cached variable whose location
+// already has a variable in the ProgramInfo is constrained to be equal to
+// the existing one, the same way that the declarations of a symbol in
+// different compilation units are linked together.
+//===----------------------------------------------------------------------===//
+#ifndef _CONSTRAINT_CACHE_H
+#define _CONSTRAINT_CACHE_H
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/StringMap.h"
+
+#include "ProgramInfo.h"
+
+class CacheEntryReader;
+
+class ConstraintCache {
+public:
+  ConstraintCache(llvm::StringRef Dir,
+                  const clang::tooling::CompilationDatabase &DB) :
+    CacheDir(Dir), Compilations(DB) {}
+
+  // Load the cached constraints for the compilation unit whose main file is
+  // SourceFile, which must be an absolute path, into Info. Returns false if
+  // there is no usable cache entry for SourceFile.
+  bool load(llvm::StringRef SourceFile, ProgramInfo &Info);
+
+  // Write the variables, constraints and global symbols that Info recorded
+  // for the compilation unit in Context to the cache.
+  void store(clang::ASTContext &Context, ProgramInfo &Info);
+
+private:
+  typedef std::map<uint32_t, uint32_t> KeyMap;
+
+  // Serialization of the parts of a cache entry. The writers add the 
+  // constraint variable numbers they mention to Keys; the readers map 
+  // cached numbers to fresh ones through Keys.
+  void writePSL(llvm::raw_ostream &O, const PersistentSourceLoc &L);
+  void writeVar(llvm::raw_ostream &O, ConstraintVariable *V,
+                std::set<uint32_t> &Keys);
+  void writeConstraint(llvm::raw_ostream &O, Constraint *C,
+                       std::set<uint32_t> &Keys);
+  bool readPSL(CacheEntryReader &R, PersistentSourceLoc &L);
+  std::unique_ptr<ConstraintVariable> readVar(CacheEntryReader &R,
+                                              KeyMap &Keys, ProgramInfo &Info);
+  Constraint *readConstraint(CacheEntryReader &R, KeyMap &Keys,
+                             ProgramInfo &Info);
+  Atom *readAtom(CacheEntryReader &R, KeyMap &Keys, ProgramInfo &Info);
+
+  // Path of the cache entry for the compilation unit with main file
+  // SourceFile, which must be an absolute path.
+  std::string getEntryPath(llvm::StringRef SourceFile);
+
+  // Content hash of the file at Path as it is currently on disk, or the
+  // empty string if it cannot be read.
+  std::string getContentHash(llvm::StringRef Path);
+
+  std::string CacheDir;
+  const clang::tooling::CompilationDatabase &Compilations;
+  // Content hashes computed so far. Most headers are read by many
+  // compilation units, so only hash each of them once per run.
+  llvm::StringMap<std::string> ContentHashes;
+};
+
+#endif
@@ -24,6 +24,9 @@ bool Constraints::addConstraint(Constraint *C) {
   // Validate the constraint to be added.
   assert(check(C));
 
+  if (recorder)
+    recorder->insert(C);
+
   // Check if C is already in the set of constraints. 
   if (constraints.find(C) == constraints.end()) {
     constraints.insert(C);
@@ -225,6 +228,7 @@ bool Constraints::step_solve(EnvironmentMap &env) {
 std::pair<Constraints::ConstraintSet, bool> Constraints::solve(void) {
   bool fixed = false;
   Constraints::ConstraintSet conflicts;
+  iterations = 0;
 
   if (DebugSolver) {
     errs() << "constraints beginning solve\n";
@@ -243,6 +247,7 @@ std::pair<Constraints::ConstraintSet, bool> Constraints::solve(void) {
     }
 
     fixed = step_solve(environment);
+    iterations++;
 
     if (DebugSolver) {
       errs() << "constraints post step\n";
@@ -318,7 +323,7 @@ Implies *Constraints::createImplies(Constraint *premise, Constraint *conclusion)
   return new Implies(premise, conclusion);
 }
 
-Constraints::Constraints() {
+Constraints::Constraints() : recorder(nullptr), iterations(0) {
   prebuiltPtr = new PtrAtom();
   prebuiltArr = new ArrAtom();
   prebuiltWild = new WildAtom();
@@ -427,6 +427,8 @@ public:
   // are returned in the first position.
   // TODO: this functionality is not implemented yet.
   std::pair<ConstraintSet, bool> solve(void);
+  // The number of steps the last call to solve took to reach a fixed point.
+  unsigned getNumIterations() const { return iterations; }
   void dump() const;
   void print(llvm::raw_ostream &) const;
 
@@ -434,6 +436,11 @@ public:
   Not *createNot(Constraint *body);
   Implies *createImplies(Constraint *premise, Constraint *conclusion);
 
+  // While R is non-null, every constraint passed to addConstraint is also
+  // inserted into R, whether or not it was already present. This is used
+  // to collect the constraints contributed by a single compilation unit.
+  void setRecorder(ConstraintSet *R) { recorder = R; }
+
   VarAtom *getOrCreateVar(uint32_t v);
   VarAtom *getVar(uint32_t v) const;
   PtrAtom *getPtr() const;
@@ -443,6 +450,8 @@ public:
 private:
   ConstraintSet constraints;
   EnvironmentMap environment;
+  ConstraintSet *recorder;
+  unsigned iterations;
 
   bool step_solve(EnvironmentMap &);
   bool check(Constraint *C);
@@ -7,10 +7,51 @@
 // Implementation of the PersistentSourceLoc infrastructure.
 //===----------------------------------------------------------------------===//
 #include "PersistentSourceLoc.h"
+#include "llvm/ADT/StringMap.h"
 
 using namespace clang;
 using namespace llvm;
 
+namespace {
+// The table of interned file names. The tool is single threaded, so the 
+// table is not synchronized.
+class FileNameTable {
+public:
+  FileNameTable() { Names.push_back(""); }
+
+  uint32_t getId(StringRef Name) {
+    auto R = Ids.insert(std::make_pair(Name, (uint32_t)Names.size()));
+    if (R.second)
+      Names.push_back(R.first->getKey());
+    return R.first->getValue();
+  }
+
+  StringRef getName(uint32_t Id) const {
+    assert(Id < Names.size());
+    return Names[Id];
+  }
+
+private:
+  StringMap<uint32_t> Ids;
+  // The names, indexed by id. These refer to the keys of Ids, which do not
+  // move once they are inserted.
+  std::vector<StringRef> Names;
+};
+}
+
+static FileNameTable &getFileNameTable() {
+  static FileNameTable Table;
+  return Table;
+}
+
+uint32_t PersistentSourceLoc::getFileId(StringRef FileName) {
+  return getFileNameTable().getId(FileName);
+}
+
+StringRef PersistentSourceLoc::getFileName(uint32_t FileId) {
+  return getFileNameTable().getName(FileId);
+}
+
 // Given a Decl, look up the source location for that Decl and create a 
 // PersistentSourceLoc that represents the location of the Decl. 
 // For Function and Parameter Decls, use the Spelling location, while for
@@ -50,9 +91,7 @@ PersistentSourceLoc::mkPSL(SourceLocation SL, ASTContext &Context) {
   FullSourceLoc FESL = Context.getFullLoc(ESL);
   assert(FESL.isValid());
   
-  std::string fn = PL.getFilename();
-
-  PersistentSourceLoc PSL(fn, 
+  PersistentSourceLoc PSL(PL.getFilename(), 
     FESL.getExpansionLineNumber(), FESL.getExpansionColumnNumber());
 
   return PSL;
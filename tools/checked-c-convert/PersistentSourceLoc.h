@@ -19,37 +19,41 @@
 #include "clang/Tooling/Tooling.h"
 #include "clang/Tooling/CommonOptionsParser.h"
 #include "clang/Rewrite/Core/Rewriter.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/ErrorHandling.h"
 
 class PersistentSourceLoc {
+  friend class ConstraintCache;
 protected:
-  PersistentSourceLoc(std::string f, uint32_t l, uint32_t c) :
-    fileName(f), lineNo(l), colNo(c), isValid(true) {}
+  PersistentSourceLoc(llvm::StringRef f, uint32_t l, uint32_t c) :
+    fileId(getFileId(f)), lineNo(l), colNo(c) {}
   
 public:
-  PersistentSourceLoc() : fileName(""), lineNo(0), colNo(0), isValid(false) {}
-  std::string getFileName() const { return fileName; }
+  PersistentSourceLoc() : fileId(0), lineNo(0), colNo(0) {}
+  llvm::StringRef getFileName() const { return getFileName(fileId); }
+  uint32_t getFileId() const { return fileId; }
   uint32_t getLineNo() const { return lineNo; }
   uint32_t getColNo() const { return colNo; }
-  bool valid() { return isValid; }
+  bool valid() { return fileId != 0; }
 
   bool operator<(const PersistentSourceLoc &o) const {
-    if (fileName == o.fileName)
+    if (fileId == o.fileId)
       if (lineNo == o.lineNo)
-        if (colNo == o.colNo)
-          return false;
-        else
-          return colNo < o.colNo;
+        return colNo < o.colNo;
       else
         return lineNo < o.lineNo;
     else
-      return fileName < o.fileName;
+      return fileId < o.fileId;
+  }
+
+  bool operator==(const PersistentSourceLoc &o) const {
+    return fileId == o.fileId && lineNo == o.lineNo && colNo == o.colNo;
   }
 
   void print(llvm::raw_ostream &O) const {
-    O << fileName << ":" << lineNo << ":" << colNo;
+    O << getFileName() << ":" << lineNo << ":" << colNo;
   }
 
   void dump() const { print(llvm::errs()); }
@@ -63,12 +67,26 @@ public:
 private:
   static
     PersistentSourceLoc mkPSL(clang::SourceLocation SL, clang::ASTContext &Context);
-  std::string fileName;
+
+  // File names are interned in a table shared by all PersistentSourceLocs,
+  // so that a location is just three integers. Id 0 is reserved for 
+  // invalid locations.
+  static uint32_t getFileId(llvm::StringRef FileName);
+  static llvm::StringRef getFileName(uint32_t FileId);
+
+  uint32_t fileId;
   uint32_t lineNo;
   uint32_t colNo;
-  bool isValid;
 };
 
+namespace std {
+template <> struct hash<PersistentSourceLoc> {
+  size_t operator()(const PersistentSourceLoc &L) const {
+    return llvm::hash_combine(L.getFileId(), L.getLineNo(), L.getColNo());
+  }
+};
+}
+
 typedef std::pair<PersistentSourceLoc, PersistentSourceLoc>
 PersistentSourceRange;
 
@@ -9,6 +9,7 @@
 #include "ProgramInfo.h"
 #include "MappingVisitor.h"
 #include "ConstraintBuilder.h"
+#include <algorithm>
 #include <sstream>
 
 using namespace clang;
@@ -376,10 +377,29 @@ void ProgramInfo::print(raw_ostream &O) const {
   CS.print(O);
   O << "\n";
 
+  // Variables is a hash table, so sort its entries to get the same output
+  // on every run. Sort by file name rather than by the interned file id,
+  // which depends on the order in which files were first seen.
+  std::vector<const VariableMap::value_type *> Entries;
+  Entries.reserve(Variables.size());
+  for (const auto &I : Variables)
+    Entries.push_back(&I);
+  std::sort(Entries.begin(), Entries.end(),
+            [](const VariableMap::value_type *A,
+               const VariableMap::value_type *B) {
+    const PersistentSourceLoc &L = A->first, &R = B->first;
+    int Cmp = L.getFileName().compare(R.getFileName());
+    if (Cmp != 0)
+      return Cmp < 0;
+    if (L.getLineNo() != R.getLineNo())
+      return L.getLineNo() < R.getLineNo();
+    return L.getColNo() < R.getColNo();
+  });
+
   O << "Constraint Variables\n";
-  for( const auto &I : Variables ) {
-    PersistentSourceLoc L = I.first;
-    const std::set<ConstraintVariable*> &S = I.second;
+  for (const auto *I : Entries) {
+    PersistentSourceLoc L = I->first;
+    const std::set<ConstraintVariable*> &S = I->second;
     L.print(O);
     O << "=>";
     for(const auto &J : S) {
@@ -590,8 +610,13 @@ void ProgramInfo::seeFunctionDecl(FunctionDecl *F, ASTContext *C) {
 
   // Track if we've seen a body for this function or not.
   std::string fn = F->getNameAsString();
+  bool hasBody = F->isThisDeclarationADefinition() && F->hasBody();
   if (!ExternFunctions[fn])
-    ExternFunctions[fn] = (F->isThisDeclarationADefinition() && F->hasBody());
+    ExternFunctions[fn] = hasBody;
+
+  if (Recording)
+    RecordedSymbols.push_back(
+      RecordedSymbol{fn, PersistentSourceLoc::mkPSL(F, *C), hasBody});
   
   // Add this to the map of global symbols. 
   std::set<FVConstraint*> toAdd;
@@ -693,6 +718,24 @@ void ProgramInfo::exitCompilationUnit() {
   return;
 }
 
+void ProgramInfo::startRecording() {
+  assert(Recording == false);
+  RecordedLocs.clear();
+  RecordedConstraints.clear();
+  RecordedSymbols.clear();
+  CS.setRecorder(&RecordedConstraints);
+  Recording = true;
+}
+
+void ProgramInfo::stopRecording() {
+  assert(Recording == true);
+  CS.setRecorder(nullptr);
+  RecordedLocs.clear();
+  RecordedConstraints.clear();
+  RecordedSymbols.clear();
+  Recording = false;
+}
+
 // For each pointer type in the declaration of D, add a variable to the
 // constraint system for that pointer type.
 bool ProgramInfo::addVariable(DeclaratorDecl *D, DeclStmt *St, ASTContext *C) {
@@ -736,18 +779,32 @@ bool ProgramInfo::addVariable(DeclaratorDecl *D, DeclStmt *St, ASTContext *C) {
     F = new FVConstraint(D, freeKey, CS, *C);
 
   std::set<ConstraintVariable*> &S = Variables[PLoc];
+  if (Recording)
+    RecordedLocs.insert(PLoc);
+
+  // While recording for the constraint cache, a new variable that aliases 
+  // an existing one is explicitly constrained equal to it. Otherwise the 
+  // constraints placed on the new variable would be lost if this 
+  // compilation unit were later loaded from the cache before the one that
+  // created the existing variable.
   bool found = false;
   for (const auto &I : S)
-    if (isa<FVConstraint>(I))
+    if (isa<FVConstraint>(I)) {
       found = true;
+      if (Recording && F != nullptr)
+        constrainEq(I, F, *this);
+    }
 
   if (found == false && F != nullptr)
     Variables[PLoc].insert(F);
   found = false;
 
   for (const auto &I : S)
-    if (isa<PVConstraint>(I))
+    if (isa<PVConstraint>(I)) {
       found = true;
+      if (Recording && P != nullptr)
+        constrainEq(I, P, *this);
+    }
 
   if (found == false && P != nullptr)
     Variables[PLoc].insert(P);
@@ -767,6 +824,8 @@ bool ProgramInfo::addVariable(DeclaratorDecl *D, DeclStmt *St, ASTContext *C) {
       if (S.size()) {
         PersistentSourceLoc PSL = PersistentSourceLoc::mkPSL(PVD, *C);
         Variables[PSL].insert(S.begin(), S.end());
+        if (Recording)
+          RecordedLocs.insert(PSL);
       }
     }
   }
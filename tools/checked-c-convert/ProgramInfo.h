@@ -42,6 +42,7 @@ typedef std::set<uint32_t> CVars;
 // is that FunctionVariableConstraints have constraints on the return value
 // and on each parameter.
 class ConstraintVariable {
+  friend class ConstraintCache;
 public:
   enum ConstraintVariableKind {
     PointerVariable,
@@ -62,6 +63,7 @@ protected:
 public:
   ConstraintVariable(ConstraintVariableKind K, std::string T) : 
     Kind(K),BaseType(T) {}
+  virtual ~ConstraintVariable() {}
 
   // Create a "for-rewriting" representation of this ConstraintVariable.
   virtual std::string mkString(Constraints::EnvironmentMap &E) = 0;
@@ -100,6 +102,7 @@ class FunctionVariableConstraint;
 // This could contain a reference to a FunctionVariableConstraint
 // in the case of a function pointer declaration.
 class PointerVariableConstraint : public ConstraintVariable {
+  friend class ConstraintCache;
 public:
 	enum Qualification {
 		ConstQualification
@@ -123,6 +126,10 @@ public:
   PointerVariableConstraint(const clang::QualType &QT, uint32_t &K,
 	  std::string N, Constraints &CS, const clang::ASTContext &C);
 
+  // The constraint on the function type of a function pointer belongs to
+  // the pointer.
+  ~PointerVariableConstraint() { delete FV; }
+
   const CVars &getCvars() const { return vars; }
 
   static bool classof(const ConstraintVariable *S) {
@@ -144,6 +151,7 @@ typedef PointerVariableConstraint PVConstraint;
 // Constraints on a function type. Also contains a 'name' parameter for 
 // when a re-write of a function pointer is needed.
 class FunctionVariableConstraint : public ConstraintVariable {
+  friend class ConstraintCache;
 private:
   // N constraints on the return value of the function.
   std::set<ConstraintVariable*> returnVars;
@@ -189,9 +197,21 @@ public:
 
 typedef FunctionVariableConstraint FVConstraint;
 
+class ConstraintCache;
+
+// A global function seen while recording a compilation unit for the 
+// constraint cache.
+struct RecordedSymbol {
+  std::string Name;
+  PersistentSourceLoc PSL;
+  bool HasBody;
+};
+
 class ProgramInfo {
+  friend class ConstraintCache;
 public:
-  ProgramInfo() : freeKey(0), persisted(true) {}
+  ProgramInfo() : freeKey(0), persisted(true), Cache(nullptr), 
+    Recording(false) {}
   void print(llvm::raw_ostream &O) const;
   void dump() const { print(llvm::errs()); }
   void dump_stats(std::set<std::string> &F) { print_stats(F, llvm::errs()); }
@@ -260,6 +280,15 @@ public:
 
   VariableMap &getVarMap() { return Variables;  }
 
+  ConstraintCache *getConstraintCache() { return Cache; }
+  void setConstraintCache(ConstraintCache *C) { Cache = C; }
+
+  // Start recording the variables, constraints and global symbols that the
+  // current compilation unit contributes, so that they can be written to 
+  // the constraint cache. 
+  void startRecording();
+  void stopRecording();
+
 private:
   std::list<clang::RecordDecl*> Records;
   // Next available integer to assign to a variable.
@@ -286,6 +315,15 @@ private:
   // seen before.
   std::map<std::string, bool> ExternFunctions;
   std::map<std::string, std::set<FVConstraint*>> GlobalSymbols;
+
+  // The on-disk constraint cache, if one is in use.
+  ConstraintCache *Cache;
+  // State recorded for the current compilation unit, between calls to 
+  // startRecording and stopRecording.
+  bool Recording;
+  std::set<PersistentSourceLoc> RecordedLocs;
+  Constraints::ConstraintSet RecordedConstraints;
+  std::vector<RecordedSymbol> RecordedSymbols;
 };
 
 #endif
@@ -11,10 +11,12 @@
 #include "llvm/Support/CommandLine.h"
 #include "PersistentSourceLoc.h"
 
+#include <unordered_map>
+
 class ConstraintVariable;
 
 // Maps a Decl to the set of constraint variables for that Decl.
-typedef std::map<PersistentSourceLoc, 
+typedef std::unordered_map<PersistentSourceLoc, 
   std::set<ConstraintVariable*>> VariableMap;
 
 // Maps a Decl to the DeclStmt that defines the Decl.
@@ -22,6 +24,7 @@ typedef std::map<clang::Decl*, clang::DeclStmt*> VariableDecltoStmtMap;
 
 extern llvm::cl::opt<bool> Verbose;
 extern llvm::cl::opt<bool> DumpIntermediate;
+extern llvm::cl::opt<bool> ContextSensitive;
 
 const clang::Type *getNextTy(const clang::Type *Ty);
 #endif
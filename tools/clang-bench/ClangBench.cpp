@@ -0,0 +1,324 @@
+//===--- tools/clang-bench/ClangBench.cpp - Front-end benchmark -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This tool repeatedly runs phases of the front end over a set of inputs and
+// reports, for each input and phase, the median and minimum time, the number
+// of tokens and the number of allocations, as JSON. The phases are:
+//
+//   lex         Raw lexing of the main file, without preprocessing.
+//   preprocess  Preprocessing the whole translation unit, as -E would, but
+//               without printing the result.
+//   syntax      Parsing and semantic analysis, as -fsyntax-only would. The
+//               parser and Sema run interleaved and are timed together.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Basic/FileManager.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Frontend/Utils.h"
+#include "clang/Lex/Lexer.h"
+#include "clang/Lex/Preprocessor.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+using namespace clang;
+using namespace llvm;
+
+//===----------------------------------------------------------------------===//
+// Allocation counting
+//===----------------------------------------------------------------------===//
+
+// Every allocation made through operator new in this process is counted, so
+// that the allocations of one run of a phase can be reported. Allocations
+// made directly with malloc, such as those of BumpPtrAllocator slabs, are
+// not counted.
+static uint64_t NumAllocations = 0;
+static uint64_t AllocatedBytes = 0;
+
+static void *countedAlloc(size_t Size) {
+  ++NumAllocations;
+  AllocatedBytes += Size;
+  if (void *P = std::malloc(Size ? Size : 1))
+    return P;
+  report_fatal_error("Allocation failed");
+}
+
+void *operator new(size_t Size) { return countedAlloc(Size); }
+void *operator new[](size_t Size) { return countedAlloc(Size); }
+void operator delete(void *P) noexcept { std::free(P); }
+void operator delete[](void *P) noexcept { std::free(P); }
+void operator delete(void *P, size_t) noexcept { std::free(P); }
+void operator delete[](void *P, size_t) noexcept { std::free(P); }
+
+//===----------------------------------------------------------------------===//
+// Options
+//===----------------------------------------------------------------------===//
+
+static cl::list<std::string> InputFiles(cl::Positional, cl::OneOrMore,
+                                        cl::desc("<input files>"));
+
+static cl::opt<unsigned> Iterations("iterations",
+                                    cl::desc("Number of runs of each phase"),
+                                    cl::init(5));
+
+static cl::list<std::string>
+    Phases("phase", cl::CommaSeparated,
+           cl::desc("Phases to run: lex, preprocess, syntax (default: all)"));
+
+static cl::list<std::string>
+    ExtraArgs("extra-arg",
+              cl::desc("Additional argument to pass to the compiler"));
+
+static cl::opt<std::string> OutputFile("o", cl::desc("Output JSON file"),
+                                       cl::value_desc("file"), cl::init("-"));
+
+//===----------------------------------------------------------------------===//
+// Phases
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+enum class Phase { Lex, Preprocess, Syntax };
+
+StringRef getPhaseName(Phase P) {
+  switch (P) {
+  case Phase::Lex:
+    return "lex";
+  case Phase::Preprocess:
+    return "preprocess";
+  case Phase::Syntax:
+    return "syntax";
+  }
+  llvm_unreachable("Invalid phase");
+}
+
+/// Preprocess the main file, counting the tokens it produces.
+class CountTokensAction : public PreprocessorFrontendAction {
+public:
+  explicit CountTokensAction(uint64_t &NumTokens) : NumTokens(NumTokens) {}
+
+protected:
+  void ExecuteAction() override {
+    Preprocessor &PP = getCompilerInstance().getPreprocessor();
+    PP.IgnorePragmas();
+
+    Token Tok;
+    PP.EnterMainSourceFile();
+    do {
+      PP.Lex(Tok);
+      ++NumTokens;
+    } while (Tok.isNot(tok::eof));
+  }
+
+private:
+  uint64_t &NumTokens;
+};
+
+/// The measurements of one run of a phase.
+struct Sample {
+  double Seconds;
+  uint64_t Tokens;
+  uint64_t Allocations;
+  uint64_t AllocatedBytes;
+};
+
+/// Raw lex the main file of CI's invocation.
+bool runLex(CompilerInstance &CI, uint64_t &NumTokens) {
+  CI.createFileManager();
+  CI.createSourceManager(CI.getFileManager());
+  const FrontendInputFile &Input = CI.getFrontendOpts().Inputs[0];
+  if (!CI.InitializeSourceManager(Input))
+    return false;
+
+  SourceManager &SM = CI.getSourceManager();
+  FileID FID = SM.getMainFileID();
+  Lexer L(FID, SM.getBuffer(FID), SM, CI.getLangOpts());
+  Token Tok;
+  do {
+    L.LexFromRawLexer(Tok);
+    ++NumTokens;
+  } while (Tok.isNot(tok::eof));
+  return true;
+}
+
+/// Run phase P once over Inv, recording the measurements in S. Returns false
+/// if the input could not be processed without errors.
+bool runPhase(Phase P, const CompilerInvocation &Inv, Sample &S) {
+  CompilerInstance CI;
+  CI.setInvocation(new CompilerInvocation(Inv));
+  CI.createDiagnostics(new IgnoringDiagConsumer());
+
+  uint64_t NumTokens = 0;
+  uint64_t StartAllocations = NumAllocations;
+  uint64_t StartBytes = AllocatedBytes;
+  TimeRecord Start = TimeRecord::getCurrentTime(true);
+
+  bool Success;
+  switch (P) {
+  case Phase::Lex:
+    Success = runLex(CI, NumTokens);
+    break;
+  case Phase::Preprocess: {
+    CountTokensAction Action(NumTokens);
+    Success = CI.ExecuteAction(Action);
+    break;
+  }
+  case Phase::Syntax: {
+    SyntaxOnlyAction Action;
+    Success = CI.ExecuteAction(Action);
+    break;
+  }
+  }
+
+  TimeRecord Elapsed = TimeRecord::getCurrentTime(false);
+  Elapsed -= Start;
+  S.Seconds = Elapsed.getWallTime();
+  S.Tokens = NumTokens;
+  S.Allocations = NumAllocations - StartAllocations;
+  S.AllocatedBytes = AllocatedBytes - StartBytes;
+  return Success && !CI.getDiagnostics().hasErrorOccurred();
+}
+
+template <typename T> T median(SmallVectorImpl<T> &Values) {
+  std::sort(Values.begin(), Values.end());
+  return Values[Values.size() / 2];
+}
+
+/// Run phase P Iterations times over Inv and write the results for File to
+/// O as a JSON object.
+void benchmark(Phase P, StringRef File, const CompilerInvocation &Inv,
+               raw_ostream &O) {
+  SmallVector<double, 8> Seconds;
+  SmallVector<uint64_t, 8> Allocations, Bytes;
+  Sample S;
+  bool Success = true;
+  for (unsigned I = 0; I < Iterations && Success; ++I) {
+    Success = runPhase(P, Inv, S);
+    Seconds.push_back(S.Seconds);
+    Allocations.push_back(S.Allocations);
+    Bytes.push_back(S.AllocatedBytes);
+  }
+
+  O << "    { \"file\": \"";
+  O.write_escaped(File);
+  O << "\", \"phase\": \"" << getPhaseName(P) << "\", ";
+  if (!Success) {
+    O << "\"error\": true }";
+    return;
+  }
+
+  double Median = median(Seconds);
+  O << "\"tokens\": " << S.Tokens << ", "
+    << "\"median_seconds\": " << format("%.6f", Median) << ", "
+    << "\"min_seconds\": "
+    << format("%.6f", *std::min_element(Seconds.begin(), Seconds.end()))
+    << ", \"tokens_per_second\": "
+    << format("%.0f", Median > 0 ? S.Tokens / Median : 0.0) << ", "
+    << "\"allocations\": " << median(Allocations) << ", "
+    << "\"allocated_bytes\": " << median(Bytes) << " }";
+}
+
+} // end anonymous namespace
+
+static std::string getExecutablePath(const char *Argv0) {
+  // This just needs to be some symbol in the binary; C++ doesn't
+  // allow taking the address of ::main however.
+  void *P = (void *)(intptr_t)getExecutablePath;
+  return sys::fs::getMainExecutable(Argv0, P);
+}
+
+int main(int argc, const char **argv) {
+  sys::PrintStackTraceOnErrorSignal(argv[0]);
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y;
+  cl::ParseCommandLineOptions(argc, argv, "clang front-end benchmark\n");
+
+  if (Iterations == 0) {
+    errs() << "error: -iterations must be at least 1\n";
+    return 1;
+  }
+
+  SmallVector<Phase, 3> Selected;
+  if (Phases.empty())
+    Selected = {Phase::Lex, Phase::Preprocess, Phase::Syntax};
+  for (const std::string &Name : Phases) {
+    int P = StringSwitch<int>(Name)
+                .Case("lex", (int)Phase::Lex)
+                .Case("preprocess", (int)Phase::Preprocess)
+                .Case("syntax", (int)Phase::Syntax)
+                .Default(-1);
+    if (P < 0) {
+      errs() << "error: unknown phase '" << Name << "'\n";
+      return 1;
+    }
+    Selected.push_back((Phase)P);
+  }
+
+  // The driver finds the resource directory relative to the executable, so
+  // run it as if it were a clang next to this tool.
+  std::string Executable = getExecutablePath(argv[0]);
+
+  std::error_code EC;
+  raw_fd_ostream O(OutputFile, EC, sys::fs::F_Text);
+  if (EC) {
+    errs() << "error: could not open " << OutputFile << ": " << EC.message()
+           << "\n";
+    return 1;
+  }
+
+  O << "{\n  \"iterations\": " << Iterations << ",\n  \"results\": [\n";
+  bool First = true;
+  for (const std::string &File : InputFiles) {
+    SmallVector<const char *, 16> Args;
+    Args.push_back(Executable.c_str());
+    Args.push_back("-fsyntax-only");
+    for (const std::string &A : ExtraArgs)
+      Args.push_back(A.c_str());
+    Args.push_back(File.c_str());
+
+    IntrusiveRefCntPtr<DiagnosticsEngine> Diags =
+        CompilerInstance::createDiagnostics(new DiagnosticOptions);
+    IntrusiveRefCntPtr<CompilerInvocation> Inv(
+        createInvocationFromCommandLine(Args, Diags));
+    if (!Inv) {
+      errs() << "error: could not create a compiler invocation for " << File
+             << "\n";
+      continue;
+    }
+    // Free everything, so that allocation counts are not skewed.
+    Inv->getFrontendOpts().DisableFree = false;
+
+    for (Phase P : Selected) {
+      if (!First)
+        O << ",\n";
+      First = false;
+      benchmark(P, File, *Inv, O);
+    }
+  }
+  O << "\n  ]\n}\n";
+
+  return 0;
+}
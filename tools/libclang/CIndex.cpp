@@ -403,21 +403,31 @@ bool CursorVisitor::visitPreprocessedEntitiesInRegion() {
     SourceLocation E = MappedRange.getEnd();
 
     if (AU->isInPreambleFileID(B)) {
-      if (SM.isLoadedSourceLocation(E))
-        return visitPreprocessedEntitiesInRange(SourceRange(B, E),
-                                                 PPRec, *this);
-
-      // Beginning of range lies in the preamble but it also extends beyond
-      // it into the main file. Split the range into 2 parts, one covering
-      // the preamble and another covering the main file. This allows subsequent
+      // Beginning of range lies in the preamble. If it extends beyond the
+      // preamble layer it starts in, split the range into one part for each
+      // layer it covers, each in the copy of the main file of its layer, and
+      // another covering the main file. This allows subsequent
       // calls to visitPreprocessedEntitiesInRange to accept a source range that
       // lies in the same FileID, allowing it to skip preprocessed entities that
       // do not come from the same FileID.
-      bool breaked =
-        visitPreprocessedEntitiesInRange(
-                                   SourceRange(B, AU->getEndOfPreambleFileID()),
-                                          PPRec, *this);
-      if (breaked) return true;
+      ArrayRef<FileID> Layers = AU->getPreambleFileIDs();
+      unsigned I = 0, N = Layers.size();
+      while (!SM.isInFileID(B, Layers[I]))
+        ++I;
+      for (; I != N; ++I) {
+        if (SM.isInFileID(E, Layers[I]))
+          return visitPreprocessedEntitiesInRange(SourceRange(B, E),
+                                                   PPRec, *this);
+
+        bool breaked =
+          visitPreprocessedEntitiesInRange(
+                             SourceRange(B, SM.getLocForEndOfFile(Layers[I])),
+                                            PPRec, *this);
+        if (breaked) return true;
+        if (I + 1 != N)
+          B = SM.getLocForStartOfFile(Layers[I + 1])
+                  .getLocWithOffset(SM.getFileIDSize(Layers[I]));
+      }
       return visitPreprocessedEntitiesInRange(
                                     SourceRange(AU->getStartOfMainFileID(), E),
                                         PPRec, *this);
@@ -3214,6 +3224,8 @@ clang_parseTranslationUnit_Impl(CXIndex CIdx, const char *source_filename,
     = options & CXTranslationUnit_IncludeBriefCommentsInCodeCompletion;
   bool SkipFunctionBodies = options & CXTranslationUnit_SkipFunctionBodies;
   bool ForSerialization = options & CXTranslationUnit_ForSerialization;
+  bool ChainedPreamble = options & CXTranslationUnit_ChainedPreamble;
+  bool PreambleInMemory = options & CXTranslationUnit_PreambleInMemory;
 
   // Configure the diagnostics.
   IntrusiveRefCntPtr<DiagnosticsEngine>
@@ -3295,7 +3307,8 @@ clang_parseTranslationUnit_Impl(CXIndex CIdx, const char *source_filename,
       /*RemappedFilesKeepOriginalName=*/true, PrecompilePreambleAfterNParses,
       TUKind, CacheCodeCompletionResults, IncludeBriefCommentsInCodeCompletion,
       /*AllowPCHWithCompilerErrors=*/true, SkipFunctionBodies,
-      /*UserFilesAreVolatile=*/true, ForSerialization,
+      /*UserFilesAreVolatile=*/true, ForSerialization, ChainedPreamble,
+      PreambleInMemory,
       CXXIdx->getPCHContainerOperations()->getRawReader().getFormat(),
       &ErrUnit));
 
@@ -0,0 +1,119 @@
+//===- unittests/Basic/CharScanTest.cpp -- Character scan kernel tests ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Basic/CharScan.h"
+#include "clang/Basic/CharInfo.h"
+#include "gtest/gtest.h"
+#include <string>
+
+using namespace llvm;
+using namespace clang;
+using namespace clang::charscan;
+
+namespace {
+
+// Every level that this build and host can run, from narrowest to widest.
+std::vector<ScanLevel> getLevels() {
+  std::vector<ScanLevel> Levels;
+  for (ScanLevel L : {ScanLevel::Scalar, ScanLevel::SSE2, ScanLevel::AVX2})
+    if (L <= getHostScanLevel())
+      Levels.push_back(L);
+  return Levels;
+}
+
+// Build a buffer of Len characters from Fill, with Stop placed at Pos (if it
+// is within the buffer).
+std::string makeBuffer(unsigned Len, char Fill, unsigned Pos, char Stop) {
+  std::string S(Len, Fill);
+  if (Pos < Len)
+    S[Pos] = Stop;
+  return S;
+}
+
+// Run Check on every combination of starting alignment, length and stop
+// position up to a few vector widths, so that both the vector loops and the
+// scalar tails are exercised.
+template <typename Fn>
+void forEachShape(Fn Check) {
+  for (unsigned Offset = 0; Offset < 4; ++Offset)
+    for (unsigned Len = 0; Len < 100; ++Len)
+      for (unsigned Pos = 0; Pos <= Len; ++Pos)
+        Check(Offset, Len, Pos);
+}
+
+TEST(CharScanTest, findNewline) {
+  for (ScanLevel L : getLevels()) {
+    const ScanKernels &K = getScanKernels(L);
+    for (char NL : {'\n', '\r'})
+      forEachShape([&](unsigned Offset, unsigned Len, unsigned Pos) {
+        std::string S = std::string(Offset, 'x') + makeBuffer(Len, 'a', Pos, NL);
+        const char *Begin = S.data() + Offset, *End = S.data() + S.size();
+        EXPECT_EQ(Begin + Pos, K.FindNewline(Begin, End));
+      });
+  }
+}
+
+TEST(CharScanTest, findChar) {
+  for (ScanLevel L : getLevels()) {
+    const ScanKernels &K = getScanKernels(L);
+    forEachShape([&](unsigned Offset, unsigned Len, unsigned Pos) {
+      std::string S = std::string(Offset, '/') + makeBuffer(Len, '*', Pos, '/');
+      const char *Begin = S.data() + Offset, *End = S.data() + S.size();
+      EXPECT_EQ(Begin + Pos, K.FindChar(Begin, End, '/'));
+    });
+  }
+}
+
+TEST(CharScanTest, skipIdentifierBody) {
+  for (ScanLevel L : getLevels()) {
+    const ScanKernels &K = getScanKernels(L);
+    // Every character that can follow an identifier must stop the scan, and
+    // every identifier character must not.
+    for (unsigned C = 0; C < 256; ++C) {
+      std::string S = makeBuffer(40, 'a', 37, (char)C);
+      const char *Begin = S.data(), *End = S.data() + S.size();
+      EXPECT_EQ(isIdentifierBody(C) ? End : Begin + 37,
+                K.SkipIdentifierBody(Begin, End)) << "character " << C;
+    }
+    forEachShape([&](unsigned Offset, unsigned Len, unsigned Pos) {
+      std::string Body;
+      for (unsigned i = 0; i < Len; ++i)
+        Body += "azAZ09_q"[i % 8];
+      if (Pos < Len)
+        Body[Pos] = '(';
+      std::string S = std::string(Offset, ' ') + Body;
+      const char *Begin = S.data() + Offset, *End = S.data() + S.size();
+      EXPECT_EQ(Begin + Pos, K.SkipIdentifierBody(Begin, End));
+    });
+  }
+}
+
+TEST(CharScanTest, skipHorizontalWhitespace) {
+  for (ScanLevel L : getLevels()) {
+    const ScanKernels &K = getScanKernels(L);
+    for (unsigned C = 0; C < 256; ++C) {
+      std::string S = makeBuffer(40, ' ', 37, (char)C);
+      const char *Begin = S.data(), *End = S.data() + S.size();
+      EXPECT_EQ(isHorizontalWhitespace(C) ? End : Begin + 37,
+                K.SkipHorizontalWhitespace(Begin, End)) << "character " << C;
+    }
+    forEachShape([&](unsigned Offset, unsigned Len, unsigned Pos) {
+      std::string WS;
+      for (unsigned i = 0; i < Len; ++i)
+        WS += " \t\f\v"[i % 4];
+      if (Pos < Len)
+        WS[Pos] = '\n';
+      std::string S = std::string(Offset, 'x') + WS;
+      const char *Begin = S.data() + Offset, *End = S.data() + S.size();
+      EXPECT_EQ(Begin + Pos, K.SkipHorizontalWhitespace(Begin, End));
+    });
+  }
+}
+
+} // anonymous namespace
@@ -0,0 +1,215 @@
+//===- unittests/Basic/PersistentStatCacheTest.cpp - Stat cache tests -----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Basic/PersistentStatCache.h"
+#include "clang/Basic/VirtualFileSystem.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using namespace clang;
+
+namespace {
+
+#ifdef LLVM_ON_WIN32
+#define INC "C:/inc"
+#else
+#define INC "/inc"
+#endif
+
+// Counts the lookups that get past the persistent cache.
+class CountingStatCache : public FileSystemStatCache {
+public:
+  unsigned NumStats = 0;
+
+  LookupResult getStat(const char *Path, FileData &Data, bool isFile,
+                       std::unique_ptr<vfs::File> *F,
+                       vfs::FileSystem &FS) override {
+    ++NumStats;
+    return statChained(Path, Data, isFile, F, FS);
+  }
+};
+
+class PersistentStatCacheTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    ASSERT_FALSE(sys::fs::createUniqueDirectory("stat-cache-test", TestDir));
+    CachePath = TestDir;
+    sys::path::append(CachePath, "stat.cache");
+  }
+
+  void TearDown() override {
+    sys::fs::remove(CachePath);
+    sys::fs::remove(TestDir);
+  }
+
+  // Build a file system whose INC directory was last changed at DirModTime
+  // and holds the given files.
+  IntrusiveRefCntPtr<vfs::InMemoryFileSystem>
+  makeFS(time_t DirModTime, std::initializer_list<const char *> Files) {
+    IntrusiveRefCntPtr<vfs::InMemoryFileSystem> FS(
+        new vfs::InMemoryFileSystem);
+    for (const char *File : Files)
+      FS->addFile(File, DirModTime, MemoryBuffer::getMemBuffer(""));
+    return FS;
+  }
+
+  // Look up the file Path through Cache, returning true if it exists.
+  bool lookup(PersistentStatCache &Cache, vfs::FileSystem &FS,
+              const char *Path) {
+    FileData Data;
+    return !FileSystemStatCache::get(Path, Data, /*isFile=*/true, nullptr,
+                                     &Cache, FS);
+  }
+
+  SmallString<128> TestDir;
+  SmallString<128> CachePath;
+};
+
+TEST_F(PersistentStatCacheTest, remembersMisses) {
+  auto FS = makeFS(1000, {INC "/a.h"});
+  {
+    PersistentStatCache Cache(CachePath);
+    EXPECT_TRUE(lookup(Cache, *FS, INC "/a.h"));
+    EXPECT_FALSE(lookup(Cache, *FS, INC "/b.h"));
+    EXPECT_EQ(0u, Cache.getNumHits());
+    EXPECT_FALSE(Cache.save());
+  }
+
+  PersistentStatCache Cache(CachePath);
+  auto *Counter = new CountingStatCache;
+  Cache.setNextStatCache(std::unique_ptr<FileSystemStatCache>(Counter));
+  EXPECT_FALSE(lookup(Cache, *FS, INC "/b.h"));
+  EXPECT_EQ(1u, Cache.getNumHits());
+  EXPECT_EQ(0u, Counter->NumStats);
+
+  // Files that exist are always looked up.
+  EXPECT_TRUE(lookup(Cache, *FS, INC "/a.h"));
+  EXPECT_EQ(1u, Counter->NumStats);
+
+  // File and directory lookups are cached separately.
+  FileData Data;
+  EXPECT_TRUE(FileSystemStatCache::get(INC "/b.h", Data, /*isFile=*/false,
+                                       nullptr, &Cache, *FS));
+  EXPECT_EQ(2u, Counter->NumStats);
+}
+
+TEST_F(PersistentStatCacheTest, changedDirectoryInvalidatesMisses) {
+  {
+    auto FS = makeFS(1000, {INC "/a.h"});
+    PersistentStatCache Cache(CachePath);
+    EXPECT_FALSE(lookup(Cache, *FS, INC "/b.h"));
+  }
+
+  // Adding b.h changed the directory.
+  auto FS = makeFS(2000, {INC "/a.h", INC "/b.h"});
+  {
+    PersistentStatCache Cache(CachePath);
+    EXPECT_TRUE(lookup(Cache, *FS, INC "/b.h"));
+    EXPECT_EQ(0u, Cache.getNumHits());
+  }
+
+  // The stale miss was dropped from the cache file.
+  auto OldFS = makeFS(1000, {INC "/a.h"});
+  PersistentStatCache Cache(CachePath);
+  auto *Counter = new CountingStatCache;
+  Cache.setNextStatCache(std::unique_ptr<FileSystemStatCache>(Counter));
+  EXPECT_FALSE(lookup(Cache, *OldFS, INC "/b.h"));
+  EXPECT_EQ(0u, Cache.getNumHits());
+  EXPECT_EQ(1u, Counter->NumStats);
+}
+
+TEST_F(PersistentStatCacheTest, recentlyChangedDirectoriesAreNotCached) {
+  auto FS = makeFS(time(nullptr), {INC "/a.h"});
+  {
+    PersistentStatCache Cache(CachePath);
+    EXPECT_FALSE(lookup(Cache, *FS, INC "/b.h"));
+  }
+
+  PersistentStatCache Cache(CachePath);
+  EXPECT_FALSE(lookup(Cache, *FS, INC "/b.h"));
+  EXPECT_EQ(0u, Cache.getNumHits());
+}
+
+// A file system in which one of the files listed in a directory cannot be
+// found, as if it were a dangling symbolic link.
+class DanglingLinkFS : public vfs::FileSystem {
+public:
+  DanglingLinkFS(IntrusiveRefCntPtr<vfs::FileSystem> Inner, StringRef Link)
+      : Inner(std::move(Inner)), Link(Link) {}
+
+  ErrorOr<vfs::Status> status(const Twine &Path) override {
+    if (Path.str() == Link)
+      return std::make_error_code(std::errc::no_such_file_or_directory);
+    return Inner->status(Path);
+  }
+  ErrorOr<std::unique_ptr<vfs::File>>
+  openFileForRead(const Twine &Path) override {
+    if (Path.str() == Link)
+      return std::make_error_code(std::errc::no_such_file_or_directory);
+    return Inner->openFileForRead(Path);
+  }
+  vfs::directory_iterator dir_begin(const Twine &Dir,
+                                    std::error_code &EC) override {
+    return Inner->dir_begin(Dir, EC);
+  }
+  std::error_code setCurrentWorkingDirectory(const Twine &Path) override {
+    return Inner->setCurrentWorkingDirectory(Path);
+  }
+  ErrorOr<std::string> getCurrentWorkingDirectory() const override {
+    return Inner->getCurrentWorkingDirectory();
+  }
+
+private:
+  IntrusiveRefCntPtr<vfs::FileSystem> Inner;
+  std::string Link;
+};
+
+TEST_F(PersistentStatCacheTest, danglingLinksAreNotCached) {
+  DanglingLinkFS FS(makeFS(1000, {INC "/a.h", INC "/link.h"}), INC "/link.h");
+  {
+    PersistentStatCache Cache(CachePath);
+    EXPECT_FALSE(lookup(Cache, FS, INC "/link.h"));
+    EXPECT_FALSE(lookup(Cache, FS, INC "/b.h"));
+  }
+
+  // The link's target can appear without INC changing, so its miss must not
+  // be answered from the cache.
+  PersistentStatCache Cache(CachePath);
+  auto *Counter = new CountingStatCache;
+  Cache.setNextStatCache(std::unique_ptr<FileSystemStatCache>(Counter));
+  EXPECT_FALSE(lookup(Cache, FS, INC "/link.h"));
+  EXPECT_EQ(0u, Cache.getNumHits());
+  EXPECT_EQ(1u, Counter->NumStats);
+  EXPECT_FALSE(lookup(Cache, FS, INC "/b.h"));
+  EXPECT_EQ(1u, Cache.getNumHits());
+  EXPECT_EQ(1u, Counter->NumStats);
+}
+
+TEST_F(PersistentStatCacheTest, ignoresInvalidFiles) {
+  {
+    std::error_code EC;
+    raw_fd_ostream Out(CachePath, EC, sys::fs::F_None);
+    ASSERT_FALSE(EC);
+    Out << StringRef("CSTC\x01\0\0\0\xff\xff\xff\xff", 12);
+  }
+
+  auto FS = makeFS(1000, {INC "/a.h"});
+  PersistentStatCache Cache(CachePath);
+  EXPECT_FALSE(lookup(Cache, *FS, INC "/b.h"));
+  EXPECT_EQ(0u, Cache.getNumHits());
+  EXPECT_FALSE(Cache.save());
+}
+
+} // anonymous namespace
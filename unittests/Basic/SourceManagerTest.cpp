@@ -68,6 +68,35 @@ class VoidModuleLoader : public ModuleLoader {
     { return 0; }
 };
 
+TEST_F(SourceManagerTest, lineNumbersAcrossChunks) {
+  const unsigned ChunkSize = SrcMgr::LineOffsetCache::ChunkSize;
+
+  // A "\r\n" that straddles the end of the first chunk, followed by enough
+  // lines to fill two more chunks.
+  std::string Source(ChunkSize - 1, 'a');
+  Source += "\r\nb\n";
+  for (unsigned I = 0; I != ChunkSize; ++I)
+    Source += "c\n";
+  std::unique_ptr<llvm::MemoryBuffer> Buf =
+      llvm::MemoryBuffer::getMemBuffer(Source);
+  FileID FID = SourceMgr.createFileID(std::move(Buf));
+
+  // Look up a line in the second chunk before any line in the first.
+  EXPECT_EQ(3U, SourceMgr.getLineNumber(FID, ChunkSize + 3));
+  EXPECT_EQ(1U, SourceMgr.getLineNumber(FID, 0));
+  EXPECT_EQ(1U, SourceMgr.getLineNumber(FID, ChunkSize));
+  EXPECT_EQ(2U, SourceMgr.getLineNumber(FID, ChunkSize + 1));
+  EXPECT_EQ(2U, SourceMgr.getColumnNumber(FID, ChunkSize + 2));
+
+  // The position just past the end is on the empty last line.
+  EXPECT_EQ(ChunkSize + 3, SourceMgr.getLineNumber(FID, Source.size()));
+
+  EXPECT_EQ(ChunkSize + 1, SourceMgr.getFileOffset(
+                               SourceMgr.translateLineCol(FID, 2, 1)));
+  EXPECT_EQ(ChunkSize + 5, SourceMgr.getFileOffset(
+                               SourceMgr.translateLineCol(FID, 4, 1)));
+}
+
 TEST_F(SourceManagerTest, isBeforeInTranslationUnit) {
   const char *source =
     "#define M(x) [x]\n"
@@ -171,6 +200,61 @@ TEST_F(SourceManagerTest, getColumnNumber) {
   EXPECT_EQ(1U, SourceMgr.getColumnNumber(MainFileID, 0, nullptr));
 }
 
+// Counts the fatal errors and notes that are reported.
+class DiagnosticCounter : public DiagnosticConsumer {
+public:
+  unsigned NumFatals = 0;
+  unsigned NumNotes = 0;
+
+  void HandleDiagnostic(DiagnosticsEngine::Level Level,
+                        const Diagnostic &Info) override {
+    if (Level == DiagnosticsEngine::Fatal)
+      ++NumFatals;
+    else if (Level == DiagnosticsEngine::Note)
+      ++NumNotes;
+  }
+};
+
+// An external source that only reserves source location space.
+class ReservingSLocEntrySource : public ExternalSLocEntrySource {
+  bool ReadSLocEntry(int ID) override { return true; }
+  std::pair<SourceLocation, StringRef> getModuleImportLoc(int ID) override {
+    return std::make_pair(SourceLocation(), StringRef());
+  }
+};
+
+TEST_F(SourceManagerTest, diagnoseSLocSpaceExhausted) {
+  std::unique_ptr<llvm::MemoryBuffer> Buf =
+      llvm::MemoryBuffer::getMemBuffer("int x;\n");
+  FileID MainFileID = SourceMgr.createFileID(std::move(Buf));
+  SourceMgr.setMainFileID(MainFileID);
+  SourceLocation Start = SourceMgr.getLocForStartOfFile(MainFileID);
+
+  // Give all but 8 bytes of the remaining address space to loaded entries.
+  ReservingSLocEntrySource External;
+  SourceMgr.setExternalSLocEntrySource(&External);
+  unsigned Free = (1U << 31) - SourceMgr.getNextLocalOffset();
+  ASSERT_NE(0, SourceMgr.AllocateLoadedSLocEntries(1, Free - 8).first);
+
+  DiagnosticCounter *Counter = new DiagnosticCounter;
+  Diags.setClient(Counter);
+
+  // An expansion of 3 bytes uses 4 of them.
+  EXPECT_TRUE(SourceMgr.createExpansionLoc(Start, Start, Start, 3).isValid());
+  EXPECT_EQ(0U, Counter->NumFatals);
+
+  // A buffer of 7 bytes does not fit in the other 4.
+  Buf = llvm::MemoryBuffer::getMemBuffer("int y;\n");
+  EXPECT_TRUE(SourceMgr.createFileID(std::move(Buf)).isInvalid());
+  EXPECT_EQ(1U, Counter->NumFatals);
+  EXPECT_EQ(1U, Counter->NumNotes);
+
+  // Neither does a longer expansion, which is not reported again.
+  EXPECT_TRUE(
+      SourceMgr.createExpansionLoc(Start, Start, Start, 10).isInvalid());
+  EXPECT_EQ(1U, Counter->NumFatals);
+}
+
 #if defined(LLVM_ON_UNIX)
 
 TEST_F(SourceManagerTest, getMacroArgExpandedLocation) {
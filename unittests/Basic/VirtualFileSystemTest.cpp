@@ -605,6 +605,25 @@ TEST_F(InMemoryFileSystemTest, DuplicatedFile) {
   ASSERT_FALSE(FS.addFile("/a", 0, MemoryBuffer::getMemBuffer("b")));
 }
 
+TEST_F(InMemoryFileSystemTest, RemoveFile) {
+  FS.addFile("/a", 0, MemoryBuffer::getMemBuffer("a"));
+  FS.addFile("/b/c", 0, MemoryBuffer::getMemBuffer("c"));
+  ASSERT_TRUE(FS.removeFile("/b/c"));
+  ASSERT_EQ(FS.status("/b/c").getError(), errc::no_such_file_or_directory);
+  ASSERT_FALSE(FS.status("/b").getError());
+  ASSERT_FALSE(FS.status("/a").getError());
+
+  // Only files can be removed, and only once.
+  ASSERT_FALSE(FS.removeFile("/b/c"));
+  ASSERT_FALSE(FS.removeFile("/b"));
+
+  // The file can be added again, with other contents.
+  ASSERT_TRUE(FS.addFile("/b/c", 0, MemoryBuffer::getMemBuffer("d")));
+  auto File = FS.openFileForRead("/b/c");
+  ASSERT_FALSE(File.getError());
+  ASSERT_EQ("d", (*(*File)->getBuffer("ignored"))->getBuffer());
+}
+
 TEST_F(InMemoryFileSystemTest, DirectoryIteration) {
   FS.addFile("/a", 0, MemoryBuffer::getMemBuffer(""));
   FS.addFile("/b/c", 0, MemoryBuffer::getMemBuffer(""));